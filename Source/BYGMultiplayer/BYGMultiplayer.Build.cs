@@ -1,5 +1,7 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
+using System.IO;
+using System.Linq;
 using UnrealBuildTool;
 
 public class BYGMultiplayer : ModuleRules
@@ -20,12 +22,47 @@ public class BYGMultiplayer : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"Icmp",
+				"Json",
 				"OnlineSubsystem",
 				"OnlineSubsystemUtils",
-				"OnlineSubsystemSteam",
-				"Steamworks",
-				"ImGui"
+				"ReplicationGraph",
+				"Sockets",
 			}
 			);
+
+		// ImGui is only used by the debug UI, which dedicated servers never show.
+		// Both it and Steam are optional in the .uplugin, so only link them when the plugin is actually there.
+		// Without ImGui, WITH_IMGUI is 0 and the debug UI compiles out.
+		bool bWithImGui = Target.Type != TargetType.Server && IsPluginAvailable(Target, "ImGui");
+		if (bWithImGui)
+		{
+			PrivateDependencyModuleNames.Add("ImGui");
+		}
+
+		// On platforms or projects without Steam we only offer NULL
+		bool bWithSteam = (Target.Platform == UnrealTargetPlatform.Win64
+			|| Target.Platform == UnrealTargetPlatform.Linux
+			|| Target.Platform == UnrealTargetPlatform.Mac)
+			&& IsPluginAvailable(Target, "OnlineSubsystemSteam");
+		if (bWithSteam)
+		{
+			PrivateDependencyModuleNames.AddRange(new string[] { "OnlineSubsystemSteam", "Steamworks" });
+		}
+		PublicDefinitions.Add("WITH_BYG_STEAM=" + (bWithSteam ? "1" : "0"));
+	}
+
+	// Looks for the plugin's descriptor in the project and engine plugin folders
+	private static bool IsPluginAvailable(ReadOnlyTargetRules Target, string PluginName)
+	{
+		string DescriptorName = PluginName + ".uplugin";
+		string[] SearchDirs = new string[]
+		{
+			Target.ProjectFile != null ? Path.Combine(Target.ProjectFile.Directory.FullName, "Plugins") : null,
+			Path.Combine(EngineDirectory, "Plugins"),
+		};
+		return SearchDirs
+			.Where(Dir => Dir != null && Directory.Exists(Dir))
+			.Any(Dir => Directory.EnumerateFiles(Dir, DescriptorName, SearchOption.AllDirectories).Any());
 	}
 }
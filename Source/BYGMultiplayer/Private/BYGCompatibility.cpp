@@ -0,0 +1,96 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGCompatibility.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "BYGSessionKeys.h"
+#include "Misc/PackageName.h"
+#include "Misc/ScopeLock.h"
+
+namespace BYGCompatibility
+{
+	// Looking for a package touches the disk, and every search result of a host asks about the same few maps
+	static FCriticalSection MapCacheLock;
+	static TMap<FString, bool> MapCache;
+}
+
+const FString& FBYGCompatibility::GetContentVersion()
+{
+	// Config is loaded into the CDO before anything hosts or searches, and never changes after
+	return GetDefault<UBYGMultiplayerSubsystem>()->ContentVersion;
+}
+
+void FBYGCompatibility::Advertise(FOnlineSessionSettings& Settings, bool bContentVersion)
+{
+	BYGSessionKeys::BuildId.Set(Settings, GetBuildUniqueId());
+	if (bContentVersion && !GetContentVersion().IsEmpty())
+	{
+		BYGSessionKeys::ContentVersion.Set(Settings, GetContentVersion());
+	}
+}
+
+EBYGCompatibility FBYGCompatibility::Check(const FOnlineSessionSearchResult& Result)
+{
+	const FOnlineSessionSettings& Settings = Result.Session.SessionSettings;
+
+	// Not every backend passes the engine's BuildUniqueId along, ours is a plain setting
+	const int32 HostBuildId = BYGSessionKeys::BuildId.IsSet(Settings) ? BYGSessionKeys::BuildId.Get(Settings) : Settings.BuildUniqueId;
+	if (HostBuildId != 0 && HostBuildId != GetBuildUniqueId())
+	{
+		return EBYGCompatibility::BuildMismatch;
+	}
+
+	const FString HostVersion = BYGSessionKeys::ContentVersion.Get(Settings);
+	if (!HostVersion.IsEmpty() && HostVersion != GetContentVersion())
+	{
+		return EBYGCompatibility::ContentMismatch;
+	}
+
+	// Otherwise we'd only find out at ClientTravel
+	if (!HasMap(BYGSessionKeys::LobbyMap.Get(Settings)) || !HasMap(BYGSessionKeys::MatchMap.Get(Settings)))
+	{
+		return EBYGCompatibility::MissingMap;
+	}
+	return EBYGCompatibility::Compatible;
+}
+
+bool FBYGCompatibility::HasMap(const FString& MapName)
+{
+	if (MapName.IsEmpty())
+	{
+		return true;
+	}
+	{
+		FScopeLock Lock(&BYGCompatibility::MapCacheLock);
+		if (const bool* bCached = BYGCompatibility::MapCache.Find(MapName))
+		{
+			return *bCached;
+		}
+	}
+
+	// Session settings usually hold short names like "MP_Lobby", which have to be searched for
+	const FString PackageName = FPackageName::ObjectPathToPackageName(MapName);
+	const bool bExists = FPackageName::IsValidLongPackageName(PackageName)
+		? FPackageName::DoesPackageExist(PackageName)
+		: FPackageName::SearchForPackageOnDisk(PackageName);
+
+	FScopeLock Lock(&BYGCompatibility::MapCacheLock);
+	BYGCompatibility::MapCache.Add(MapName, bExists);
+	return bExists;
+}
+
+const TCHAR* FBYGCompatibility::GetName(EBYGCompatibility Compatibility)
+{
+	switch (Compatibility)
+	{
+	case EBYGCompatibility::Compatible:
+		return TEXT("Compatible");
+	case EBYGCompatibility::BuildMismatch:
+		return TEXT("Different build");
+	case EBYGCompatibility::ContentMismatch:
+		return TEXT("Different content version");
+	case EBYGCompatibility::MissingMap:
+		return TEXT("Missing map");
+	default:
+		return TEXT("Unknown");
+	}
+}
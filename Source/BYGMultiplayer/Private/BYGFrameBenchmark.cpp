@@ -0,0 +1,432 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// What the plugin costs the game thread per frame, so UI and subsystem changes that make it more expensive show up
+// as numbers:
+//
+//   BYG.Benchmark.Run                                       100 frames per case
+//   BYG.Benchmark.Run 300 Saved/BYGMultiplayer/Base.json    300 frames per case, compared with an earlier run
+//
+// The debug UI is drawn into an offscreen ImGui context against synthetic searches of 10 to 10000 results and a
+// session of 1 to 128 registered players, and the accessors UI and game code call every frame are called in tight
+// loops. Each case reports nanoseconds and allocations per frame or call, and the whole run is written to
+// Saved/BYGMultiplayer/Benchmark-<date>.json. Cases more than 20% slower than the baseline, or allocating more, are
+// logged as errors. With -unattended, a regression or a baseline that can't be read also makes the process exit with
+// code 1, so CI can run it with -ExecCmds and fail the build on the exit code.
+//
+// Allocations are read from the allocator's own Malloc and Realloc call counters (FMalloc::TotalMallocCalls), which
+// the binned allocators keep in development builds. They count every thread, so run it with the game otherwise idle;
+// while the game thread is busy benchmarking, little else allocates. Allocators without the counters report 0.
+// ImGui's own allocations only count if the ImGui plugin routes them through FMemory.
+
+#include "BYGMultiplayerSubsystem.h"
+#include "BYGMultiplayerUI.h"
+#include "BYGSearchResults.h"
+#include "BYGSessionKeys.h"
+#include "Dom/JsonObject.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/MemoryBase.h"
+#include "ImGuiCommon.h"
+#include "Math/RandomStream.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "OnlineSessionSettings.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+#if !UE_BUILD_SHIPPING
+
+namespace BYGFrameBenchmark
+{
+	struct FResult
+	{
+		FString Name;
+		int32 Iterations = 0;
+		double NsPerIteration = 0.0;
+		double AllocsPerIteration = 0.0;
+	};
+
+	// Growing a container is an allocation as far as frame cost goes, so reallocs count too
+	static uint64 GetNumAllocationCalls()
+	{
+		return (uint64)FMalloc::TotalMallocCalls + (uint64)FMalloc::TotalReallocCalls;
+	}
+
+	// Keeps the compiler from dropping calls whose results are otherwise unused
+	static volatile int64 Sink = 0;
+
+	template <typename FunctionType>
+	static void Measure(TArray<FResult>& Results, const FString& Name, int32 Iterations, FunctionType&& Function)
+	{
+		// A few untimed runs first, so one-off work like ImGui laying out a new window isn't charged to every frame
+		for (int32 i = 0; i < 3; ++i)
+		{
+			Function();
+		}
+
+		const uint64 StartAllocs = GetNumAllocationCalls();
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for (int32 i = 0; i < Iterations; ++i)
+		{
+			Function();
+		}
+		const double Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+		const uint64 NumAllocs = GetNumAllocationCalls() - StartAllocs;
+
+		FResult& Result = Results.AddDefaulted_GetRef();
+		Result.Name = Name;
+		Result.Iterations = Iterations;
+		Result.NsPerIteration = Seconds * 1000000000.0 / Iterations;
+		Result.AllocsPerIteration = (double)NumAllocs / Iterations;
+		UE_LOG(LogBYGMultiplayer, Display, TEXT("%-40s %12.0fns %8.2f allocs"), *Result.Name, Result.NsPerIteration, Result.AllocsPerIteration);
+	}
+
+#if WITH_IMGUI
+	// A context of our own, so the benchmark neither draws into nor disturbs whatever the ImGui plugin is showing
+	struct FScopedImGuiContext
+	{
+		FScopedImGuiContext()
+		{
+			PreviousContext = ImGui::GetCurrentContext();
+			Context = ImGui::CreateContext();
+			ImGui::SetCurrentContext(Context);
+
+			ImGuiIO& IO = ImGui::GetIO();
+			IO.DisplaySize = ImVec2(1920.0f, 1080.0f);
+			IO.DeltaTime = 1.0f / 60.0f;
+			IO.IniFilename = nullptr;
+			// NewFrame needs the font atlas built, nothing ever uploads it
+			unsigned char* Pixels = nullptr;
+			int Width = 0;
+			int Height = 0;
+			IO.Fonts->GetTexDataAsAlpha8(&Pixels, &Width, &Height);
+		}
+		~FScopedImGuiContext()
+		{
+			ImGui::DestroyContext(Context);
+			ImGui::SetCurrentContext(PreviousContext);
+		}
+
+		ImGuiContext* PreviousContext = nullptr;
+		ImGuiContext* Context = nullptr;
+	};
+#endif
+
+	static FString GetDefaultFilename()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("BYGMultiplayer") / FString::Printf(TEXT("Benchmark-%s.json"), *FDateTime::Now().ToString());
+	}
+
+	static void Save(const TArray<FResult>& Results, const FString& Filename)
+	{
+		FString Json;
+		const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("buildVersion"), FString(FApp::GetBuildVersion()));
+		Writer->WriteValue(TEXT("buildId"), GetBuildUniqueId());
+		Writer->WriteValue(TEXT("timestamp"), FDateTime::UtcNow().ToIso8601());
+		Writer->WriteArrayStart(TEXT("results"));
+		for (const FResult& Result : Results)
+		{
+			Writer->WriteObjectStart();
+			Writer->WriteValue(TEXT("name"), Result.Name);
+			Writer->WriteValue(TEXT("iterations"), Result.Iterations);
+			Writer->WriteValue(TEXT("nsPerIteration"), Result.NsPerIteration);
+			Writer->WriteValue(TEXT("allocsPerIteration"), Result.AllocsPerIteration);
+			Writer->WriteObjectEnd();
+		}
+		Writer->WriteArrayEnd();
+		Writer->WriteObjectEnd();
+		Writer->Close();
+
+		if (FFileHelper::SaveStringToFile(Json, *Filename))
+		{
+			UE_LOG(LogBYGMultiplayer, Display, TEXT("Benchmark results saved to %s"), *Filename);
+		}
+		else
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("Failed to save benchmark results to %s"), *Filename);
+		}
+	}
+
+	// Returns how many cases regressed, or INDEX_NONE if the baseline can't be read. Cases missing from the baseline are
+	// new and never count.
+	static int32 Compare(const TArray<FResult>& Results, const FString& BaselineFilename, double Tolerance)
+	{
+		FString Json;
+		TSharedPtr<FJsonObject> Baseline;
+		const TArray<TSharedPtr<FJsonValue>>* BaselineResults = nullptr;
+		if (!FFileHelper::LoadFileToString(Json, *BaselineFilename)
+			|| !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Baseline)
+			|| !Baseline.IsValid()
+			|| !Baseline->TryGetArrayField(TEXT("results"), BaselineResults))
+		{
+			UE_LOG(LogBYGMultiplayer, Error, TEXT("Couldn't read benchmark baseline %s"), *BaselineFilename);
+			return INDEX_NONE;
+		}
+
+		int32 NumRegressions = 0;
+		for (const FResult& Result : Results)
+		{
+			const TSharedPtr<FJsonObject>* Match = nullptr;
+			for (const TSharedPtr<FJsonValue>& Value : *BaselineResults)
+			{
+				const TSharedPtr<FJsonObject>* Object = nullptr;
+				if (Value->TryGetObject(Object) && (*Object)->GetStringField(TEXT("name")) == Result.Name)
+				{
+					Match = Object;
+					break;
+				}
+			}
+			if (!Match)
+			{
+				continue;
+			}
+
+			const double BaselineNs = (*Match)->GetNumberField(TEXT("nsPerIteration"));
+			const double BaselineAllocs = (*Match)->GetNumberField(TEXT("allocsPerIteration"));
+			// Timings are noisy, allocation counts aren't. The half allocation of slack is for cases that only
+			// allocate every so often, e.g. when a container happens to grow.
+			const bool bSlower = Result.NsPerIteration > BaselineNs * (1.0 + Tolerance);
+			const bool bMoreAllocs = Result.AllocsPerIteration > BaselineAllocs + 0.5;
+			if (bSlower || bMoreAllocs)
+			{
+				UE_LOG(LogBYGMultiplayer, Error, TEXT("Benchmark regression in %s: %.0fns (was %.0fns), %.2f allocs (was %.2f)"),
+					*Result.Name, Result.NsPerIteration, BaselineNs, Result.AllocsPerIteration, BaselineAllocs);
+				++NumRegressions;
+			}
+		}
+		return NumRegressions;
+	}
+}
+
+// Swaps synthetic searches and sessions in for the subsystem's own, and puts the real ones back when destroyed.
+// Nothing is broadcast, so game code listening to the subsystem never sees them. They are published to the
+// _AnyThread buffers though, so worker threads reading those during a run get the synthetic ones.
+class FBYGFrameBenchmark
+{
+public:
+	explicit FBYGFrameBenchmark(UBYGMultiplayerSubsystem* InSubsystem)
+		: Subsystem(InSubsystem)
+		, SavedSearch(InSubsystem->SessionSearch)
+		, SavedSearchSnapshot(InSubsystem->SearchSnapshot)
+		, SavedSessionSnapshot(InSubsystem->SessionSnapshot)
+	{
+	}
+
+	~FBYGFrameBenchmark()
+	{
+		Subsystem->SessionSearch = SavedSearch;
+		Subsystem->SearchSnapshot = SavedSearchSnapshot;
+		Subsystem->SessionSnapshot = SavedSessionSnapshot;
+		// Anything a reader is still holding up gets flushed on the subsystem's next tick
+		Subsystem->SearchSnapshotBuffer.Publish(SavedSearchSnapshot);
+		Subsystem->SessionSnapshotBuffer.Publish(SavedSessionSnapshot);
+	}
+
+	// The _AnyThread cases must read what the others do, so don't leave it pending
+	template<typename T>
+	static void PublishNow(TBYGDoubleBuffer<T>& Buffer, const T& Value)
+	{
+		if (!Buffer.Publish(Value))
+		{
+			while (!Buffer.Flush())
+			{
+				FPlatformProcess::Yield();
+			}
+		}
+	}
+
+	void SetSearchResults(int32 NumResults)
+	{
+		static const TCHAR* MapNames[] = { TEXT("MP_Lobby"), TEXT("MP_Desert"), TEXT("MP_Harbour") };
+
+		// Same seed every run, so runs compare like with like
+		FRandomStream Random(NumResults);
+		const TSharedRef<FOnlineSessionSearch> Search = MakeShared<FOnlineSessionSearch>();
+		Search->SearchState = EOnlineAsyncTaskState::Done;
+		Search->SearchResults.SetNum(NumResults);
+		for (int32 i = 0; i < NumResults; ++i)
+		{
+			FOnlineSessionSearchResult& Result = Search->SearchResults[i];
+			FOnlineSessionSettings& Settings = Result.Session.SessionSettings;
+			Settings.NumPublicConnections = 16;
+			Result.Session.NumOpenPublicConnections = Random.RandRange(0, Settings.NumPublicConnections);
+			Result.Session.OwningUserName = FString::Printf(TEXT("Host %d"), i);
+			Result.PingInMs = Random.RandRange(10, 300);
+			BYGSessionKeys::ServerName.Set(Settings, FString::Printf(TEXT("Benchmark Server %d"), i));
+			BYGSessionKeys::MapName.Set(Settings, MapNames[Random.RandRange(0, UE_ARRAY_COUNT(MapNames) - 1)]);
+			BYGSessionKeys::BuildId.Set(Settings, GetBuildUniqueId());
+		}
+		Subsystem->SessionSearch = Search;
+		// Unfiltered, every result is drawn
+		Subsystem->SearchSnapshot = FBYGSearchSnapshot::Build(Search->SearchResults, Search->SearchState, FBYGSearchFilter());
+		PublishNow(Subsystem->SearchSnapshotBuffer, Subsystem->SearchSnapshot);
+	}
+
+	void SetRegisteredPlayers(int32 NumPlayers)
+	{
+		const TSharedRef<FBYGSessionSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<FBYGSessionSnapshot, ESPMode::ThreadSafe>();
+		Snapshot->NumSessions = 1;
+		Snapshot->bHasSession = true;
+		Snapshot->SessionName = NAME_GameSession;
+		Snapshot->SessionId.Set(TEXT("Benchmark"));
+		Snapshot->bHosting = true;
+		Snapshot->State = EOnlineSessionState::InProgress;
+		Snapshot->StateName.Set(FBYGSessionSnapshot::GetStateName(Snapshot->State));
+		Snapshot->NumOpenPublicConnections = FMath::Max(0, 128 - NumPlayers);
+		Snapshot->LocalOwnerId.Set(TEXT("Player 0"));
+		for (int32 i = 0; i < NumPlayers; ++i)
+		{
+			Snapshot->RegisteredPlayers.Emplace(FString::Printf(TEXT("Player %d"), i));
+		}
+		Snapshot->bLocalPlayerRegistered = true;
+		Subsystem->SessionSnapshot = Snapshot;
+		PublishNow(Subsystem->SessionSnapshotBuffer, Subsystem->SessionSnapshot);
+	}
+
+	void Run(int32 NumFrames, TArray<BYGFrameBenchmark::FResult>& Results)
+	{
+		using namespace BYGFrameBenchmark;
+
+		Subsystem->EnsureInitialized();
+
+#if WITH_IMGUI
+		if (Subsystem->UI)
+		{
+			FScopedImGuiContext Context;
+			// The Join tab shows both the search results and the session's players
+			Subsystem->UI->ForcedTab = "Join";
+			const auto DrawFrame = [this]()
+			{
+				ImGui::NewFrame();
+				// Like a maximized debug window
+				ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+				ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
+				bool bIsOpen = true;
+				Subsystem->DrawDebug(&bIsOpen);
+				ImGui::Render();
+			};
+
+			SetRegisteredPlayers(1);
+			for (const int32 NumResults : { 10, 100, 1000, 10000 })
+			{
+				SetSearchResults(NumResults);
+				Measure(Results, FString::Printf(TEXT("DrawDebug/Results=%d"), NumResults), NumFrames, DrawFrame);
+			}
+			SetSearchResults(100);
+			for (const int32 NumPlayers : { 1, 8, 32, 128 })
+			{
+				SetRegisteredPlayers(NumPlayers);
+				Measure(Results, FString::Printf(TEXT("DrawDebug/Players=%d"), NumPlayers), NumFrames, DrawFrame);
+			}
+			Subsystem->UI->ForcedTab = nullptr;
+		}
+#endif
+
+		SetSearchResults(1000);
+		SetRegisteredPlayers(32);
+		// Cheap enough that a single call is lost in the timer's resolution
+		const int32 NumCalls = NumFrames * 100;
+		int64 Total = 0;
+		Measure(Results, TEXT("GetSession"), NumCalls, [&]()
+		{
+			Total += Subsystem->GetSession().IsValid();
+		});
+		Measure(Results, TEXT("GetPlayerNickname"), NumCalls, [&]()
+		{
+			Total += Subsystem->GetPlayerNickname().Len();
+		});
+		Measure(Results, TEXT("GetSessionSnapshot"), NumCalls, [&]()
+		{
+			Total += Subsystem->GetSessionSnapshot()->RegisteredPlayers.Num();
+		});
+		Measure(Results, TEXT("GetSessionSnapshot_AnyThread"), NumCalls, [&]()
+		{
+			Total += Subsystem->GetSessionSnapshot_AnyThread()->RegisteredPlayers.Num();
+		});
+		Measure(Results, TEXT("GetSearchSnapshot"), NumCalls, [&]()
+		{
+			Total += Subsystem->GetSearchSnapshot()->VisibleRows.Num();
+		});
+		Measure(Results, TEXT("GetSearchSnapshot_AnyThread"), NumCalls, [&]()
+		{
+			Total += Subsystem->GetSearchSnapshot_AnyThread()->VisibleRows.Num();
+		});
+		// Reading every result once, the way a server browser would per frame
+		Measure(Results, TEXT("SearchRows/Results=1000"), NumFrames, [&]()
+		{
+			const FBYGSearchSnapshotRef Search = Subsystem->GetSearchSnapshot();
+			for (const int32 RowIndex : Search->VisibleRows)
+			{
+				Total += Search->Rows[RowIndex].PingInMs;
+			}
+		});
+		Measure(Results, TEXT("SearchResultKeys/Results=1000"), NumFrames, [&]()
+		{
+			for (const FOnlineSessionSearchResult& Result : Subsystem->SessionSearch->SearchResults)
+			{
+				Total += BYGSessionKeys::ServerName.Get(Result).Len();
+			}
+		});
+		Sink = Total;
+	}
+
+	static void RunCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+		UBYGMultiplayerSubsystem* Subsystem = GameInstance ? GameInstance->GetSubsystem<UBYGMultiplayerSubsystem>() : nullptr;
+		if (!Subsystem)
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("The multiplayer subsystem isn't running"));
+			return;
+		}
+		const int32 NumFrames = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100;
+		const FString BaselineFilename = Args.Num() > 1 ? Args[1] : FString();
+		const double Tolerance = Args.Num() > 2 ? FCString::Atod(*Args[2]) : 0.2;
+
+		TArray<BYGFrameBenchmark::FResult> Results;
+		{
+			FBYGFrameBenchmark Benchmark(Subsystem);
+			Benchmark.Run(NumFrames, Results);
+		}
+		BYGFrameBenchmark::Save(Results, BYGFrameBenchmark::GetDefaultFilename());
+
+		if (!BaselineFilename.IsEmpty())
+		{
+			const int32 NumRegressions = BYGFrameBenchmark::Compare(Results, BaselineFilename, Tolerance);
+			if (NumRegressions != INDEX_NONE)
+			{
+				UE_LOG(LogBYGMultiplayer, Display, TEXT("%d of %d benchmark cases regressed against %s"), NumRegressions, Results.Num(), *BaselineFilename);
+			}
+			// Nobody reads the log of an unattended run, so make it fail
+			if (NumRegressions != 0 && FApp::IsUnattended())
+			{
+				UE_LOG(LogBYGMultiplayer, Error, TEXT("Benchmark failed, exiting with code 1"));
+				FPlatformMisc::RequestExitWithStatus(false, 1);
+			}
+		}
+	}
+
+private:
+	UBYGMultiplayerSubsystem* Subsystem;
+	TSharedPtr<FOnlineSessionSearch> SavedSearch;
+	FBYGSearchSnapshotRef SavedSearchSnapshot;
+	FBYGSessionSnapshotRef SavedSessionSnapshot;
+};
+
+namespace BYGFrameBenchmark
+{
+	static FAutoConsoleCommandWithWorldAndArgs RunCommand(
+		TEXT("BYG.Benchmark.Run"),
+		TEXT("Measure the per-frame cost of the debug UI and subsystem accessors. Args: <Frames=100> <Baseline=path to an earlier run's json> <Tolerance=0.2>"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&FBYGFrameBenchmark::RunCommand));
+}
+
+#endif // !UE_BUILD_SHIPPING
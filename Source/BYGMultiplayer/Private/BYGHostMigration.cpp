@@ -0,0 +1,380 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGHostMigration.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/CommandLine.h"
+#include "Net/UnrealNetwork.h"
+
+namespace BYGHostMigration
+{
+	static const TCHAR* TokenOption = TEXT("BYGMigrationToken");
+	static const TCHAR* PortOption = TEXT("BYGMigrationPort");
+	// Joins and leaves are rare, no need to rebuild the list every frame
+	static const double SuccessorRefreshInterval = 1.0;
+	// If the engine doesn't travel us anywhere after a failure, don't wait forever
+	static const double DisconnectTimeout = 5.0;
+}
+
+ABYGSessionReplicatedInfo::ABYGSessionReplicatedInfo()
+{
+	bReplicates = true;
+	bAlwaysRelevant = true;
+#if ENGINE_MAJOR_VERSION > 5 || (ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 5)
+	SetNetUpdateFrequency(1.0f);
+#else
+	NetUpdateFrequency = 1.0f;
+#endif
+}
+
+void ABYGSessionReplicatedInfo::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(ABYGSessionReplicatedInfo, Settings);
+	DOREPLIFETIME(ABYGSessionReplicatedInfo, Successors);
+}
+
+void ABYGSessionReplicatedInfo::OnRep_MigrationState()
+{
+	UGameInstance* GameInstance = GetGameInstance();
+	UBYGMultiplayerSubsystem* Subsystem = GameInstance ? GameInstance->GetSubsystem<UBYGMultiplayerSubsystem>() : nullptr;
+	if (Subsystem)
+	{
+		Subsystem->HostMigration.OnStateReplicated(*this);
+	}
+}
+
+void FBYGHostMigration::Init(UBYGMultiplayerSubsystem* InSubsystem)
+{
+	Subsystem = InSubsystem;
+	RejoinDelay = Subsystem->HostMigrationRejoinDelay;
+	CandidateTimeout = Subsystem->HostMigrationCandidateTimeout;
+}
+
+bool FBYGHostMigration::IsEnabled() const
+{
+	return Subsystem && (Subsystem->bHostMigration || FParse::Param(FCommandLine::Get(), TEXT("BYGHostMigration")));
+}
+
+const TCHAR* FBYGHostMigration::GetPhaseName(EBYGMigrationPhase InPhase)
+{
+	switch (InPhase)
+	{
+	case EBYGMigrationPhase::None:
+		return TEXT("None");
+	case EBYGMigrationPhase::WaitingForDisconnect:
+		return TEXT("Waiting for disconnect");
+	case EBYGMigrationPhase::Rehosting:
+		return TEXT("Re-hosting");
+	case EBYGMigrationPhase::WaitingToRejoin:
+		return TEXT("Waiting to rejoin");
+	case EBYGMigrationPhase::Rejoining:
+		return TEXT("Rejoining");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
+FString FBYGHostMigration::GetJoinOptions() const
+{
+	if (!IsEnabled())
+	{
+		return FString();
+	}
+	// The port we'd listen on if we end up hosting
+	return FString::Printf(TEXT("?%s=%s?%s=%d"), BYGHostMigration::TokenOption, *Token, BYGHostMigration::PortOption, FURL::UrlConfig.DefaultPort);
+}
+
+UWorld* FBYGHostMigration::GetWorld() const
+{
+	return Subsystem && Subsystem->GetGameInstance() ? Subsystem->GetGameInstance()->GetWorld() : nullptr;
+}
+
+void FBYGHostMigration::Tick(float DeltaTime)
+{
+	if (!IsEnabled())
+	{
+		return;
+	}
+
+	UWorld* World = GetWorld();
+	if (World && World->GetNetMode() == NM_ListenServer && Subsystem->bIsHosting)
+	{
+		TickHost(World);
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	switch (Phase)
+	{
+	case EBYGMigrationPhase::WaitingForDisconnect:
+		if (Now - PhaseStartTime > BYGHostMigration::DisconnectTimeout)
+		{
+			TryCurrentCandidate();
+		}
+		break;
+	case EBYGMigrationPhase::WaitingToRejoin:
+		if (World && Now - PhaseStartTime > RejoinDelay)
+		{
+			const FBYGMigrationCandidate& Candidate = CachedSuccessors[CandidateIndex];
+			const FString URL = FString::Printf(TEXT("%s:%d%s"), *Candidate.Address, Candidate.Port, *GetJoinOptions());
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Host migration: connecting to candidate %d at %s"), CandidateIndex, *URL);
+			SetPhase(EBYGMigrationPhase::Rejoining);
+			GEngine->SetClientTravel(World, *URL, TRAVEL_Absolute);
+		}
+		break;
+	case EBYGMigrationPhase::Rehosting:
+	case EBYGMigrationPhase::Rejoining:
+		if (Now - PhaseStartTime > CandidateTimeout)
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("Host migration: candidate %d timed out after %.1f seconds"), CandidateIndex, CandidateTimeout);
+			NextCandidate();
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void FBYGHostMigration::TickHost(UWorld* World)
+{
+	ABYGSessionReplicatedInfo* Info = HostInfo.Get();
+	if (!Info || Info->GetWorld() != World)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.Name = TEXT("BYGSessionReplicatedInfo");
+		SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+		Info = World->SpawnActor<ABYGSessionReplicatedInfo>(SpawnParams);
+		HostInfo = Info;
+		NextSuccessorRefreshTime = 0.0;
+	}
+	if (!Info)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (Now < NextSuccessorRefreshTime)
+	{
+		return;
+	}
+	NextSuccessorRefreshTime = Now + BYGHostMigration::SuccessorRefreshInterval;
+
+	FBYGMigrationSettings Settings;
+	const FBYGOnlineSessionSettings& SessionSettings = Subsystem->OnlineSessionSettings;
+	Settings.ServerName = SessionSettings.ServerName;
+	Settings.PublicMapName = SessionSettings.TargetPublicFacingMapName;
+	Settings.MapPath = UWorld::RemovePIEPrefix(World->GetOutermost()->GetName());
+	Settings.NumPublicConnections = SessionSettings.NumPublicConnections;
+	Settings.bIsLANMatch = SessionSettings.bIsLANMatch;
+	// Only assign on change, so it's only replicated on change
+	if (!(Settings == Info->Settings))
+	{
+		Info->Settings = Settings;
+	}
+	RefreshSuccessors(World, Info);
+}
+
+void FBYGHostMigration::RefreshSuccessors(UWorld* World, ABYGSessionReplicatedInfo* Info) const
+{
+	TArray<FBYGMigrationCandidate> Connected;
+	if (const UNetDriver* NetDriver = World->GetNetDriver())
+	{
+		for (const UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			if (!Connection || Connection->State == USOCK_Closed)
+			{
+				continue;
+			}
+			FBYGMigrationCandidate Candidate;
+			Candidate.Token = UGameplayStatics::ParseOption(Connection->RequestURL, BYGHostMigration::TokenOption);
+			Candidate.Port = FCString::Atoi(*UGameplayStatics::ParseOption(Connection->RequestURL, BYGHostMigration::PortOption));
+			Candidate.Address = Connection->LowLevelGetRemoteAddress(false);
+			// Joined without migration turned on
+			if (!Candidate.Token.IsEmpty() && Candidate.Port > 0)
+			{
+				Connected.Add(Candidate);
+			}
+		}
+	}
+
+	// Keep the existing order so the successor doesn't change every time somebody joins
+	TArray<FBYGMigrationCandidate> Successors;
+	for (const FBYGMigrationCandidate& Existing : Info->Successors)
+	{
+		if (Connected.Contains(Existing))
+		{
+			Successors.Add(Existing);
+		}
+	}
+	for (const FBYGMigrationCandidate& Candidate : Connected)
+	{
+		Successors.AddUnique(Candidate);
+	}
+
+	if (Successors != Info->Successors)
+	{
+		Info->Successors = MoveTemp(Successors);
+	}
+}
+
+void FBYGHostMigration::OnStateReplicated(const ABYGSessionReplicatedInfo& Info)
+{
+	if (Info.HasAuthority())
+	{
+		return;
+	}
+	CachedSettings = Info.Settings;
+	CachedSuccessors = Info.Successors;
+}
+
+bool FBYGHostMigration::OnNetworkFailure(UWorld* World)
+{
+	if (!IsEnabled())
+	{
+		return false;
+	}
+
+	// The candidate we were connecting to is gone too
+	if (Phase == EBYGMigrationPhase::Rejoining)
+	{
+		NextCandidate();
+		return true;
+	}
+
+	if (Phase != EBYGMigrationPhase::None || !World || World->GetNetMode() != NM_Client || CachedSuccessors.Num() == 0)
+	{
+		return false;
+	}
+
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Lost the host, migrating to one of %d successors"), CachedSuccessors.Num());
+	MigrationStartTime = FPlatformTime::Seconds();
+	CandidateIndex = 0;
+	SetPhase(EBYGMigrationPhase::WaitingForDisconnect);
+	return true;
+}
+
+void FBYGHostMigration::OnTravelFailure()
+{
+	if (Phase == EBYGMigrationPhase::Rejoining || Phase == EBYGMigrationPhase::Rehosting)
+	{
+		NextCandidate();
+	}
+}
+
+void FBYGHostMigration::OnPostLoadMap(UWorld* World)
+{
+	if (!World)
+	{
+		return;
+	}
+
+	switch (Phase)
+	{
+	case EBYGMigrationPhase::WaitingForDisconnect:
+		// The engine has dropped us back to the default map, now we can go wherever we like
+		TryCurrentCandidate();
+		break;
+	case EBYGMigrationPhase::Rehosting:
+		if (World->GetNetMode() == NM_ListenServer)
+		{
+			Finish(true);
+		}
+		break;
+	case EBYGMigrationPhase::Rejoining:
+		if (World->GetNetMode() == NM_Client)
+		{
+			Finish(true);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void FBYGHostMigration::TryCurrentCandidate()
+{
+	if (!CachedSuccessors.IsValidIndex(CandidateIndex))
+	{
+		Finish(false);
+		return;
+	}
+
+	if (CachedSuccessors[CandidateIndex].Token != Token)
+	{
+		SetPhase(EBYGMigrationPhase::WaitingToRejoin);
+		return;
+	}
+
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Host migration: we are candidate %d, hosting '%s' on %s"), CandidateIndex, *CachedSettings.ServerName, *CachedSettings.MapPath);
+	SetPhase(EBYGMigrationPhase::Rehosting);
+
+	// The old session is destroyed when the connection fails, but asynchronously on most backends, and creating
+	// NAME_GameSession fails while it's still around. Once it's gone, OnSessionDestroyed() picks this up.
+	IOnlineSessionPtr SessionInterface = Subsystem->GetSession();
+	if (SessionInterface.IsValid() && SessionInterface->GetNamedSession(NAME_GameSession))
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Host migration: waiting for the old session to be destroyed"));
+		bRehostPending = true;
+		return;
+	}
+	Rehost();
+}
+
+void FBYGHostMigration::OnSessionDestroyed()
+{
+	if (Phase == EBYGMigrationPhase::Rehosting && bRehostPending)
+	{
+		bRehostPending = false;
+		Rehost();
+	}
+}
+
+void FBYGHostMigration::Rehost()
+{
+	FBYGOnlineSessionSettings& SessionSettings = Subsystem->OnlineSessionSettings;
+	SessionSettings = FBYGOnlineSessionSettings();
+	SessionSettings.ServerName = CachedSettings.ServerName;
+	SessionSettings.TargetPublicFacingMapName = CachedSettings.PublicMapName;
+	SessionSettings.TargetMapName = FName(*CachedSettings.MapPath);
+	SessionSettings.NumPublicConnections = CachedSettings.NumPublicConnections;
+	SessionSettings.bIsLANMatch = CachedSettings.bIsLANMatch;
+	SessionSettings.MapArguments = { TEXT("listen") };
+	Subsystem->HostGame();
+}
+
+void FBYGHostMigration::NextCandidate()
+{
+	++CandidateIndex;
+	TryCurrentCandidate();
+}
+
+void FBYGHostMigration::SetPhase(EBYGMigrationPhase NewPhase)
+{
+	UE_LOG(LogBYGMultiplayer, Verbose, TEXT("Host migration: %s -> %s"), GetPhaseName(Phase), GetPhaseName(NewPhase));
+	Phase = NewPhase;
+	PhaseStartTime = FPlatformTime::Seconds();
+	bRehostPending = false;
+}
+
+void FBYGHostMigration::Finish(bool bSucceeded)
+{
+	const double Duration = FPlatformTime::Seconds() - MigrationStartTime;
+	if (bSucceeded)
+	{
+		LastMigrationSeconds = Duration;
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Host migration complete as %s in %.0fms"),
+			Phase == EBYGMigrationPhase::Rehosting ? TEXT("host") : TEXT("client"), Duration * 1000.0);
+	}
+	else
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Host migration failed after %.0fms, no candidates left"), Duration * 1000.0);
+	}
+	SetPhase(EBYGMigrationPhase::None);
+	CachedSuccessors.Reset();
+	CandidateIndex = 0;
+}
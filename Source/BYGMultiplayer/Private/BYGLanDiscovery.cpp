@@ -0,0 +1,468 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGLanDiscovery.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "BYGSessionKeys.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/CommandLine.h"
+#include "Serialization/BufferReader.h"
+#include "Serialization/MemoryWriter.h"
+
+const FName FBYGLanDiscovery::SubsystemName(TEXT("BYGLAN"));
+
+namespace BYGLanDiscovery
+{
+	// "BYGL" read as a little-endian uint32
+	static const uint32 Magic = 0x4C475942;
+	static const int32 MaxPacketSize = 512;
+	static const int32 MaxStringBytes = 64;
+	// The rest wait for the next tick
+	static const int32 MaxPacketsPerTick = 64;
+	// Rate limit entries older than this are forgotten
+	static const double ForgetAfterSeconds = 10.0;
+	// Response flags
+	static const uint8 FlagDedicated = 1;
+	static const uint8 FlagNetCoordinate = 2;
+
+	void WriteHeader(FArchive& Ar, uint8 Type, uint32 Nonce)
+	{
+		uint32 PacketMagic = Magic;
+		uint8 Version = FBYGLanDiscovery::Version;
+		Ar << PacketMagic << Version << Type << Nonce;
+	}
+
+	bool ReadHeader(FArchive& Ar, uint8 ExpectedType, uint32& OutNonce)
+	{
+		uint32 PacketMagic = 0;
+		uint8 Version = 0;
+		uint8 Type = 0;
+		Ar << PacketMagic << Version << Type << OutNonce;
+		return !Ar.IsError() && PacketMagic == Magic && Version == FBYGLanDiscovery::Version && Type == ExpectedType;
+	}
+
+	void WriteString(FArchive& Ar, const FString& Value)
+	{
+		FTCHARToUTF8 Utf8(*Value);
+		int32 Length = FMath::Min(Utf8.Length(), MaxStringBytes);
+		// Don't cut a multibyte character in half, back up to the start of the one that doesn't fit. Past the end
+		// this reads the terminator, which is never a continuation byte.
+		const uint8* Bytes = (const uint8*)Utf8.Get();
+		while (Length > 0 && (Bytes[Length] & 0xC0) == 0x80)
+		{
+			--Length;
+		}
+		uint8 LengthByte = (uint8)Length;
+		Ar << LengthByte;
+		Ar.Serialize((void*)Utf8.Get(), Length);
+	}
+
+	FString ReadString(FArchive& Ar)
+	{
+		uint8 Length = 0;
+		Ar << Length;
+		if (Ar.IsError() || Length > MaxStringBytes || Ar.Tell() + Length > Ar.TotalSize())
+		{
+			Ar.SetError();
+			return FString();
+		}
+		ANSICHAR Bytes[MaxStringBytes + 1];
+		Ar.Serialize(Bytes, Length);
+		Bytes[Length] = 0;
+		return FString(UTF8_TO_TCHAR(Bytes));
+	}
+}
+
+void FBYGLanDiscovery::Init(UBYGMultiplayerSubsystem* InSubsystem)
+{
+	Subsystem = InSubsystem;
+	Port = Subsystem->LanDiscoveryPort;
+	PortRange = FMath::Max(1, Subsystem->LanDiscoveryPortRange);
+	Address = Subsystem->LanDiscoveryAddress;
+	FParse::Value(FCommandLine::Get(), TEXT("BYGLanDiscoveryAddress="), Address);
+	BroadcastInterval = Subsystem->LanDiscoveryBroadcastInterval;
+	SearchDuration = Subsystem->LanDiscoverySearchDuration;
+	ResponseInterval = Subsystem->LanDiscoveryResponseInterval;
+	MaxResponsesPerSecond = Subsystem->LanDiscoveryMaxResponsesPerSecond;
+}
+
+void FBYGLanDiscovery::Deinit()
+{
+	StopSearch();
+	StopResponding();
+	Subsystem = nullptr;
+}
+
+bool FBYGLanDiscovery::IsEnabled() const
+{
+	return Subsystem && (Subsystem->bLanDiscovery || FParse::Param(FCommandLine::Get(), TEXT("BYGLanDiscovery")));
+}
+
+UWorld* FBYGLanDiscovery::GetWorld() const
+{
+	return Subsystem && Subsystem->GetGameInstance() ? Subsystem->GetGameInstance()->GetWorld() : nullptr;
+}
+
+FSocket* FBYGLanDiscovery::CreateSocket(int32 BindPort, bool bBroadcast)
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	if (!SocketSubsystem)
+	{
+		return nullptr;
+	}
+	FSocket* Socket = SocketSubsystem->CreateSocket(NAME_DGram, TEXT("BYGLanDiscovery"), FNetworkProtocolTypes::IPv4);
+	if (!Socket)
+	{
+		return nullptr;
+	}
+	TSharedRef<FInternetAddr> BindAddress = SocketSubsystem->CreateInternetAddr(FNetworkProtocolTypes::IPv4);
+	BindAddress->SetAnyAddress();
+	BindAddress->SetPort(BindPort);
+	if (!Socket->SetNonBlocking(true) || (bBroadcast && !Socket->SetBroadcast(true)) || !Socket->Bind(*BindAddress))
+	{
+		SocketSubsystem->DestroySocket(Socket);
+		return nullptr;
+	}
+	return Socket;
+}
+
+void FBYGLanDiscovery::DestroySocket(FSocket*& Socket)
+{
+	if (Socket)
+	{
+		Socket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+}
+
+void FBYGLanDiscovery::Tick()
+{
+	if (ClientSocket)
+	{
+		TickClient();
+	}
+
+	UWorld* World = GetWorld();
+	const bool bShouldRespond = IsEnabled() && Subsystem->bIsHosting && Subsystem->OnlineSessionSettings.bIsLANMatch
+		&& World && (World->GetNetMode() == NM_ListenServer || World->GetNetMode() == NM_DedicatedServer);
+	if (!bShouldRespond)
+	{
+		HostAttemptWorld.Reset();
+		StopResponding();
+	}
+	else if (!HostSocket && World != HostAttemptWorld.Get())
+	{
+		HostAttemptWorld = World;
+		StartResponding();
+	}
+	if (HostSocket)
+	{
+		TickHost();
+	}
+}
+
+void FBYGLanDiscovery::StartResponding()
+{
+	// First free port, so several hosts can share a machine
+	for (int32 i = 0; i < PortRange; ++i)
+	{
+		HostSocket = CreateSocket(Port + i, false);
+		if (HostSocket)
+		{
+			HostPort = Port + i;
+			break;
+		}
+	}
+	if (!HostSocket)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("LAN discovery couldn't listen, ports %d to %d are all taken"), Port, Port + PortRange - 1);
+		return;
+	}
+	HostSessionGuid = FGuid::NewGuid();
+	LastResponseTimes.Reset();
+	ResponsesInWindow = 0;
+	NumQueriesAnswered = 0;
+	NumQueriesDropped = 0;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("LAN discovery answering on port %d"), HostPort);
+}
+
+void FBYGLanDiscovery::StopResponding()
+{
+	if (HostSocket)
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("LAN discovery stopped, answered %d queries and dropped %d"), NumQueriesAnswered, NumQueriesDropped);
+	}
+	DestroySocket(HostSocket);
+	HostPort = 0;
+}
+
+void FBYGLanDiscovery::TickHost()
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> From = SocketSubsystem->CreateInternetAddr(FNetworkProtocolTypes::IPv4);
+	const double Now = FPlatformTime::Seconds();
+	uint8 Buffer[BYGLanDiscovery::MaxPacketSize];
+	TArray<uint8> Response;
+	for (int32 i = 0; i < BYGLanDiscovery::MaxPacketsPerTick; ++i)
+	{
+		int32 BytesRead = 0;
+		if (!HostSocket->RecvFrom(Buffer, sizeof(Buffer), BytesRead, *From) || BytesRead <= 0)
+		{
+			break;
+		}
+		FBufferReader Reader(Buffer, BytesRead, false);
+		uint32 Nonce = 0;
+		if (!BYGLanDiscovery::ReadHeader(Reader, (uint8)EPacketType::Query, Nonce))
+		{
+			continue;
+		}
+		if (!ShouldRespond(From->ToString(true), Now))
+		{
+			++NumQueriesDropped;
+			continue;
+		}
+		WriteResponse(Response, Nonce);
+		int32 BytesSent = 0;
+		HostSocket->SendTo(Response.GetData(), Response.Num(), BytesSent, *From);
+		++NumQueriesAnswered;
+	}
+
+	if (LastResponseTimes.Num() > 256)
+	{
+		for (auto It = LastResponseTimes.CreateIterator(); It; ++It)
+		{
+			if (Now - It.Value() > BYGLanDiscovery::ForgetAfterSeconds)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+}
+
+bool FBYGLanDiscovery::ShouldRespond(const FString& FromAddress, double Now)
+{
+	if (Now - ResponseWindowStart >= 1.0)
+	{
+		ResponseWindowStart = Now;
+		ResponsesInWindow = 0;
+	}
+	if (ResponsesInWindow >= MaxResponsesPerSecond)
+	{
+		return false;
+	}
+	if (const double* LastTime = LastResponseTimes.Find(FromAddress))
+	{
+		if (Now - *LastTime < ResponseInterval)
+		{
+			return false;
+		}
+	}
+	LastResponseTimes.Add(FromAddress, Now);
+	++ResponsesInWindow;
+	return true;
+}
+
+void FBYGLanDiscovery::WriteResponse(TArray<uint8>& OutPacket, uint32 Nonce) const
+{
+	const FBYGOnlineSessionSettings& Settings = Subsystem->OnlineSessionSettings;
+	IOnlineSessionPtr SessionInterface = Subsystem->GetSession();
+	const FNamedOnlineSession* Session = SessionInterface.IsValid() ? SessionInterface->GetNamedSession(NAME_GameSession) : nullptr;
+	const UWorld* World = GetWorld();
+
+	FGuid SessionGuid = HostSessionGuid;
+	uint16 GamePort = World ? (uint16)World->URL.Port : 0;
+	uint16 BeaconPort = Session ? (uint16)BYGSessionKeys::BeaconPort.Get(Session->SessionSettings) : 0;
+	uint16 NumOpen = (uint16)(Session ? Session->NumOpenPublicConnections : Settings.NumPublicConnections);
+	uint16 MaxPlayers = (uint16)(Session ? Session->SessionSettings.NumPublicConnections : Settings.NumPublicConnections);
+	int32 BuildId = Session ? Session->SessionSettings.BuildUniqueId : Settings.BuildUniqueId;
+	// Same as the session advertises, see BYGNetCoordinate.h
+	const FBYGNetCoordinate& NetCoordinate = Subsystem->GetNetCoordinate();
+	int32 PackedCoordinate = NetCoordinate.Pack();
+	float CoordinateError = NetCoordinate.Error;
+	uint8 Flags = (Settings.bIsDedicated ? BYGLanDiscovery::FlagDedicated : 0)
+		| (Subsystem->bEstimatePing ? BYGLanDiscovery::FlagNetCoordinate : 0);
+
+	OutPacket.Reset();
+	FMemoryWriter Writer(OutPacket);
+	BYGLanDiscovery::WriteHeader(Writer, (uint8)EPacketType::Response, Nonce);
+	Writer << SessionGuid << GamePort << BeaconPort << NumOpen << MaxPlayers << BuildId << Flags << PackedCoordinate << CoordinateError;
+	BYGLanDiscovery::WriteString(Writer, Settings.ServerName);
+	BYGLanDiscovery::WriteString(Writer, Settings.TargetPublicFacingMapName);
+	// What FBYGCompatibility::Check looks at, as the session advertises it
+	const FOnlineSessionSettings Advertised = Session ? Session->SessionSettings : Settings.GetSessionSettings();
+	BYGLanDiscovery::WriteString(Writer, BYGSessionKeys::ContentVersion.Get(Advertised));
+	BYGLanDiscovery::WriteString(Writer, BYGSessionKeys::LobbyMap.Get(Advertised));
+	BYGLanDiscovery::WriteString(Writer, BYGSessionKeys::MatchMap.Get(Advertised));
+}
+
+bool FBYGLanDiscovery::StartSearch()
+{
+	StopSearch();
+	ClientSocket = CreateSocket(0, true);
+	if (!ClientSocket)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("LAN discovery couldn't create a socket to search with"));
+		return false;
+	}
+	SearchStartTime = FPlatformTime::Seconds();
+	NonceBase = (uint32)FMath::Rand() ^ ((uint32)FMath::Rand() << 16);
+	QueryTimes.Reset();
+	KnownSessions.Reset();
+	NewResults.Reset();
+	Broadcast(SearchStartTime);
+	return true;
+}
+
+void FBYGLanDiscovery::StopSearch()
+{
+	if (ClientSocket)
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("LAN discovery found %d hosts with %d queries in %.0fms"),
+			KnownSessions.Num(), QueryTimes.Num(), (FPlatformTime::Seconds() - SearchStartTime) * 1000.0);
+	}
+	DestroySocket(ClientSocket);
+	QueryTimes.Reset();
+}
+
+void FBYGLanDiscovery::ConsumeResults(TArray<FOnlineSessionSearchResult>& OutResults)
+{
+	OutResults = MoveTemp(NewResults);
+	NewResults.Reset();
+}
+
+void FBYGLanDiscovery::Broadcast(double Now)
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> To = SocketSubsystem->CreateInternetAddr(FNetworkProtocolTypes::IPv4);
+	bool bIsValid = false;
+	To->SetIp(*Address, bIsValid);
+	if (!bIsValid)
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("LAN discovery address '%s' isn't an IPv4 address"), *Address);
+		StopSearch();
+		return;
+	}
+
+	// Hosts answer whatever build they are, FBYGCompatibility sorts out the results on our side
+	uint32 Nonce = NonceBase + QueryTimes.Num();
+	TArray<uint8> Query;
+	FMemoryWriter Writer(Query);
+	BYGLanDiscovery::WriteHeader(Writer, (uint8)EPacketType::Query, Nonce);
+
+	for (int32 i = 0; i < PortRange; ++i)
+	{
+		To->SetPort(Port + i);
+		int32 BytesSent = 0;
+		ClientSocket->SendTo(Query.GetData(), Query.Num(), BytesSent, *To);
+	}
+	QueryTimes.Add(Nonce, Now);
+	NextBroadcastTime = Now + BroadcastInterval;
+}
+
+void FBYGLanDiscovery::TickClient()
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> From = SocketSubsystem->CreateInternetAddr(FNetworkProtocolTypes::IPv4);
+	const double Now = FPlatformTime::Seconds();
+	uint8 Buffer[BYGLanDiscovery::MaxPacketSize];
+	for (int32 i = 0; i < BYGLanDiscovery::MaxPacketsPerTick; ++i)
+	{
+		int32 BytesRead = 0;
+		if (!ClientSocket->RecvFrom(Buffer, sizeof(Buffer), BytesRead, *From) || BytesRead <= 0)
+		{
+			break;
+		}
+		ReadResponse(Buffer, BytesRead, From->ToString(false), Now);
+	}
+
+	if (Now - SearchStartTime >= SearchDuration)
+	{
+		StopSearch();
+	}
+	else if (Now >= NextBroadcastTime)
+	{
+		Broadcast(Now);
+	}
+}
+
+bool FBYGLanDiscovery::ReadResponse(const uint8* Packet, int32 Size, const FString& FromAddress, double Now)
+{
+	FBufferReader Reader((void*)Packet, Size, false);
+	uint32 Nonce = 0;
+	if (!BYGLanDiscovery::ReadHeader(Reader, (uint8)EPacketType::Response, Nonce))
+	{
+		return false;
+	}
+	const double* SentTime = QueryTimes.Find(Nonce);
+	if (!SentTime)
+	{
+		return false;
+	}
+
+	FGuid SessionGuid;
+	uint16 GamePort = 0;
+	uint16 BeaconPort = 0;
+	uint16 NumOpen = 0;
+	uint16 MaxPlayers = 0;
+	int32 BuildId = 0;
+	uint8 Flags = 0;
+	int32 PackedCoordinate = 0;
+	float CoordinateError = 1.0f;
+	Reader << SessionGuid << GamePort << BeaconPort << NumOpen << MaxPlayers << BuildId << Flags << PackedCoordinate << CoordinateError;
+	const FString ServerName = BYGLanDiscovery::ReadString(Reader);
+	const FString MapName = BYGLanDiscovery::ReadString(Reader);
+	const FString ContentVersion = BYGLanDiscovery::ReadString(Reader);
+	const FString LobbyMap = BYGLanDiscovery::ReadString(Reader);
+	const FString MatchMap = BYGLanDiscovery::ReadString(Reader);
+	if (Reader.IsError() || GamePort == 0)
+	{
+		return false;
+	}
+	// Hosts answer every query, the first answer is the one that counts
+	bool bAlreadyKnown = false;
+	KnownSessions.Add(SessionGuid, &bAlreadyKnown);
+	if (bAlreadyKnown)
+	{
+		return false;
+	}
+
+	FOnlineSessionSearchResult& Result = NewResults.AddDefaulted_GetRef();
+	Result.PingInMs = FMath::Max(0, FMath::RoundToInt((Now - *SentTime) * 1000.0));
+	Result.Session.NumOpenPublicConnections = NumOpen;
+	FOnlineSessionSettings& Settings = Result.Session.SessionSettings;
+	Settings.NumPublicConnections = MaxPlayers;
+	Settings.BuildUniqueId = BuildId;
+	Settings.bIsLANMatch = true;
+	Settings.bIsDedicated = (Flags & BYGLanDiscovery::FlagDedicated) != 0;
+	if (Flags & BYGLanDiscovery::FlagNetCoordinate)
+	{
+		BYGSessionKeys::NetCoordinate.Set(Settings, PackedCoordinate);
+		BYGSessionKeys::NetCoordinateError.Set(Settings, CoordinateError);
+	}
+	BYGSessionKeys::ServerName.Set(Settings, ServerName);
+	BYGSessionKeys::MapName.Set(Settings, MapName);
+	BYGSessionKeys::BeaconPort.Set(Settings, BeaconPort);
+	BYGSessionKeys::BuildId.Set(Settings, BuildId);
+	// Left unset when empty, same as a session that doesn't advertise them
+	if (!ContentVersion.IsEmpty())
+	{
+		BYGSessionKeys::ContentVersion.Set(Settings, ContentVersion);
+	}
+	if (!LobbyMap.IsEmpty())
+	{
+		BYGSessionKeys::LobbyMap.Set(Settings, LobbyMap);
+	}
+	if (!MatchMap.IsEmpty())
+	{
+		BYGSessionKeys::MatchMap.Set(Settings, MatchMap);
+	}
+	BYGSessionKeys::SearchSubsystem.Set(Settings, SubsystemName.ToString());
+	BYGSessionKeys::HostAddress.Set(Settings, FromAddress);
+	BYGSessionKeys::GamePort.Set(Settings, GamePort);
+	return true;
+}
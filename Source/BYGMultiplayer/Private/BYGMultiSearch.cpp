@@ -0,0 +1,312 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGMultiSearch.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "BYGSessionKeys.h"
+#include "BYGLanDiscovery.h"
+#include "OnlineSubsystem.h"
+#include "OnlineSessionSettings.h"
+#include "HAL/PlatformTime.h"
+
+void FBYGMultiSearch::Init(UBYGMultiplayerSubsystem* InSubsystem)
+{
+	Subsystem = InSubsystem;
+}
+
+FName FBYGMultiSearch::GetResultSubsystem(const FOnlineSessionSearchResult& Result)
+{
+	const FString Name = BYGSessionKeys::SearchSubsystem.Get(Result);
+	return Name.IsEmpty() ? NAME_None : FName(*Name);
+}
+
+FString FBYGMultiSearch::GetLabel(const FBYGSearchSource& Source, FName SubsystemName)
+{
+	if (!Source.Label.IsEmpty())
+	{
+		return Source.Label;
+	}
+	return FString::Printf(TEXT("%s %s"), *SubsystemName.ToString(), Source.bLAN ? TEXT("LAN") : Source.bPresence ? TEXT("presence") : TEXT("internet"));
+}
+
+bool FBYGMultiSearch::Start(const TSharedRef<FOnlineSessionSearch>& Results, const TArray<FBYGSearchSource>& Sources)
+{
+	Cancel();
+
+	Merged = Results;
+	Merged->SearchState = EOnlineAsyncTaskState::InProgress;
+	KnownResults.Reset();
+	bAnySucceeded = false;
+	NumDuplicates = 0;
+	NumCapped = 0;
+	StartTime = FPlatformTime::Seconds();
+
+	for (const FBYGSearchSource& Source : Sources)
+	{
+		const FName SubsystemName = Source.Subsystem.IsNone() ? Subsystem->GetCurrentSubsystemName() : Source.Subsystem;
+		FGroup* Group = Groups.FindByPredicate([SubsystemName](const FGroup& Existing) { return Existing.SubsystemName == SubsystemName; });
+		if (!Group && SubsystemName == FBYGLanDiscovery::SubsystemName)
+		{
+			Group = &Groups.AddDefaulted_GetRef();
+			Group->SubsystemName = SubsystemName;
+		}
+		else if (!Group)
+		{
+			// Brings the subsystem up if it isn't already, NULL is always there
+			IOnlineSubsystem* OnlineSubsystem = IOnlineSubsystem::Get(SubsystemName);
+			IOnlineSessionPtr SessionInterface = OnlineSubsystem ? OnlineSubsystem->GetSessionInterface() : IOnlineSessionPtr();
+			if (!SessionInterface.IsValid())
+			{
+				UE_LOG(LogBYGMultiplayer, Warning, TEXT("Skipping the %s search, %s has no session interface"), *GetLabel(Source, SubsystemName), *SubsystemName.ToString());
+				continue;
+			}
+			Group = &Groups.AddDefaulted_GetRef();
+			Group->SubsystemName = SubsystemName;
+			Group->SessionInterface = SessionInterface;
+		}
+		Group->Sources.Add(Source);
+	}
+
+	if (Groups.Num() == 0)
+	{
+		Merged->SearchState = EOnlineAsyncTaskState::Failed;
+		Merged.Reset();
+		return false;
+	}
+
+	bSearching = true;
+	for (int32 i = 0; i < Groups.Num(); ++i)
+	{
+		StartNextSource(i);
+	}
+	return true;
+}
+
+void FBYGMultiSearch::StartNextSource(int32 GroupIndex)
+{
+	FGroup& Group = Groups[GroupIndex];
+	while (++Group.Current < Group.Sources.Num())
+	{
+		const FBYGSearchSource& Source = Group.Sources[Group.Current];
+		Group.Search = Subsystem->SearchPool.Acquire();
+		Group.Search->bIsLanQuery = Source.bLAN;
+		Group.Search->MaxSearchResults = Subsystem->GetMaxSearchResults();
+		Group.Search->TimeoutInSeconds = Subsystem->FindTimeout;
+		Group.Search->QuerySettings.Set(SEARCH_PRESENCE, Source.bPresence, EOnlineComparisonOp::Equals);
+		Group.SourceStartTime = FPlatformTime::Seconds();
+		Group.bSourceComplete = false;
+		Group.bSourceSucceeded = false;
+
+		if (Group.IsLanDiscovery())
+		{
+			if (Subsystem->LanDiscovery.StartSearch())
+			{
+				return;
+			}
+			continue;
+		}
+		Group.CompleteHandle = Group.SessionInterface->AddOnFindSessionsCompleteDelegate_Handle(
+			FOnFindSessionsCompleteDelegate::CreateRaw(this, &FBYGMultiSearch::OnSourceComplete, GroupIndex));
+		// Some subsystems fail, or even complete, before returning. Either way the next tick picks it up.
+		if (Group.SessionInterface->FindSessions(0, Group.Search.ToSharedRef()) || Group.bSourceComplete)
+		{
+			return;
+		}
+		Group.SessionInterface->ClearOnFindSessionsCompleteDelegate_Handle(Group.CompleteHandle);
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Couldn't start the %s search"), *GetLabel(Source, Group.SubsystemName));
+	}
+}
+
+void FBYGMultiSearch::OnSourceComplete(bool bWasSuccessful, int32 GroupIndex)
+{
+	if (Groups.IsValidIndex(GroupIndex))
+	{
+		Groups[GroupIndex].bSourceComplete = true;
+		Groups[GroupIndex].bSourceSucceeded = bWasSuccessful;
+	}
+}
+
+void FBYGMultiSearch::Tick()
+{
+	if (!bSearching)
+	{
+		return;
+	}
+
+	bool bMerged = false;
+	bool bAllFinished = true;
+	for (int32 i = 0; i < Groups.Num(); ++i)
+	{
+		FGroup& Group = Groups[i];
+		if (Group.IsLanDiscovery() && !Group.IsFinished())
+		{
+			bMerged |= TickLanDiscovery(Group);
+		}
+		if (Group.bSourceComplete)
+		{
+			Group.bSourceComplete = false;
+			if (!Group.IsLanDiscovery())
+			{
+				Group.SessionInterface->ClearOnFindSessionsCompleteDelegate_Handle(Group.CompleteHandle);
+			}
+			MergeSource(Group);
+			bMerged = true;
+			StartNextSource(i);
+		}
+		bAllFinished &= Group.IsFinished();
+	}
+
+	if (bMerged)
+	{
+		OnResultsMerged.ExecuteIfBound();
+	}
+	if (bAllFinished)
+	{
+		Finish();
+	}
+}
+
+bool FBYGMultiSearch::TickLanDiscovery(FGroup& Group)
+{
+	// Responders go in as they arrive, there's no waiting for a timeout
+	TArray<FOnlineSessionSearchResult> Results;
+	Subsystem->LanDiscovery.ConsumeResults(Results);
+	int32 NumAdded = 0;
+	MergeResults(Group, Results, NumAdded);
+	if (!Subsystem->LanDiscovery.IsSearching())
+	{
+		Group.bSourceComplete = true;
+		Group.bSourceSucceeded = true;
+	}
+	return Results.Num() > 0;
+}
+
+void FBYGMultiSearch::MergeSource(FGroup& Group)
+{
+	const FString Label = GetLabel(Group.Sources[Group.Current], Group.SubsystemName);
+	const double Seconds = FPlatformTime::Seconds() - Group.SourceStartTime;
+	if (!Group.bSourceSucceeded)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("%s search failed after %.0fms"), *Label, Seconds * 1000.0);
+		return;
+	}
+	bAnySucceeded = true;
+	if (Group.IsLanDiscovery())
+	{
+		// Already merged as they came in
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("%s search finished in %.0fms"), *Label, Seconds * 1000.0);
+		return;
+	}
+
+	int32 NumAdded = 0;
+	const int32 NumResults = Group.Search->SearchResults.Num();
+	MergeResults(Group, Group.Search->SearchResults, NumAdded);
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("%s search found %d results in %.0fms, %d new"), *Label, NumResults, Seconds * 1000.0, NumAdded);
+	Group.Search.Reset();
+}
+
+void FBYGMultiSearch::MergeResults(const FGroup& Group, TArray<FOnlineSessionSearchResult>& Results, int32& OutNumAdded)
+{
+	const FString Label = GetLabel(Group.Sources[Group.Current], Group.SubsystemName);
+	const FString SubsystemName = Group.SubsystemName.ToString();
+	const int32 MaxResults = Subsystem->MaxRetainedSearchResults;
+	for (FOnlineSessionSearchResult& Result : Results)
+	{
+		// LAN discovery results have no session info, only an address
+		const bool bHasAddress = BYGSessionKeys::HostAddress.IsSet(Result.Session.SessionSettings);
+		if (!Result.IsValid() && !bHasAddress)
+		{
+			continue;
+		}
+		FBYGSearchPool::TrimResult(Result, Subsystem->MaxSearchSettingLength);
+
+		// Local only, never advertised. Tagged first, resolving the address below depends on it.
+		BYGSessionKeys::SearchSource.Set(Result.Session.SessionSettings, Label);
+		BYGSessionKeys::SearchSubsystem.Set(Result.Session.SessionSettings, SubsystemName);
+
+		// The same host can turn up through more than one source, or twice in one
+		TArray<FString, TInlineAllocator<2>> Keys;
+		if (Result.IsSessionInfoValid())
+		{
+			Keys.Add(TEXT("Id:") + Result.GetSessionIdStr());
+		}
+		FString Address;
+		if (Subsystem->GetConnectString(Result, NAME_GamePort, Address))
+		{
+			Keys.Add(TEXT("Address:") + Address);
+		}
+		int32 Index = INDEX_NONE;
+		for (const FString& Key : Keys)
+		{
+			if (const int32* Found = KnownResults.Find(Key))
+			{
+				Index = *Found;
+				break;
+			}
+		}
+
+		if (Index == INDEX_NONE && MaxResults > 0 && Merged->SearchResults.Num() >= MaxResults)
+		{
+			// Full. Replacing one would change what a row or a join in progress points at, so earlier sources win.
+			++NumCapped;
+			continue;
+		}
+		if (Index == INDEX_NONE)
+		{
+			Index = Merged->SearchResults.Add(MoveTemp(Result));
+			++OutNumAdded;
+		}
+		else
+		{
+			++NumDuplicates;
+			// Kept in place, indices into the results must stay valid while the search runs
+			if (Subsystem->GetPingEstimate(Result) < Subsystem->GetPingEstimate(Merged->SearchResults[Index]))
+			{
+				Merged->SearchResults[Index] = MoveTemp(Result);
+			}
+		}
+		for (const FString& Key : Keys)
+		{
+			KnownResults.Add(Key, Index);
+		}
+	}
+}
+
+void FBYGMultiSearch::Finish()
+{
+	Merged->SearchState = bAnySucceeded ? EOnlineAsyncTaskState::Done : EOnlineAsyncTaskState::Failed;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Searched %d backends in %.0fms: %d results, %d duplicates and %d over the limit dropped"),
+		Groups.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0, Merged->SearchResults.Num(), NumDuplicates, NumCapped);
+
+	Groups.Reset();
+	Merged.Reset();
+	KnownResults.Reset();
+	bSearching = false;
+	OnComplete.ExecuteIfBound(bAnySucceeded);
+}
+
+void FBYGMultiSearch::Cancel()
+{
+	for (FGroup& Group : Groups)
+	{
+		if (Group.IsLanDiscovery())
+		{
+			Subsystem->LanDiscovery.StopSearch();
+		}
+		else if (!Group.IsFinished())
+		{
+			Group.SessionInterface->ClearOnFindSessionsCompleteDelegate_Handle(Group.CompleteHandle);
+			if (!Group.bSourceComplete)
+			{
+				Group.SessionInterface->CancelFindSessions();
+			}
+		}
+	}
+	if (bSearching && Merged.IsValid())
+	{
+		Merged->SearchState = EOnlineAsyncTaskState::Failed;
+	}
+	Groups.Reset();
+	Merged.Reset();
+	KnownResults.Reset();
+	bSearching = false;
+}
@@ -0,0 +1,20 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+// Use "stat BYGMultiplayer" to see these in game
+DECLARE_STATS_GROUP(TEXT("BYGMultiplayer"), STATGROUP_BYGMultiplayer, STATCAT_Advanced);
+
+// Put at the top of anything that allocates on the plugin's behalf, so -llm can tell our memory apart. Engines
+// without custom LLM tags count it as networking.
+#if ENGINE_MAJOR_VERSION >= 5
+LLM_DECLARE_TAG(BYGMultiplayer);
+#define BYG_LLM_SCOPE() LLM_SCOPE_BYTAG(BYGMultiplayer)
+#else
+#define BYG_LLM_SCOPE() LLM_SCOPE(ELLMTag::Networking)
+#endif
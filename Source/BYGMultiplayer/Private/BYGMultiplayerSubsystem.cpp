@@ -7,15 +7,38 @@
 #include "OnlineSubsystemUtils.h"
 #include "Kismet/GameplayStatics.h"
 #include "GameFramework/PlayerController.h"
-#include "OnlineSubsystemSteam.h"
+#include "GameFramework/PlayerState.h"
+#include "GameFramework/GameModeBase.h"
+#include "OnlineBeaconHost.h"
+#include "GameMapsSettings.h"
+#include "Misc/PackageName.h"
+#include "EngineUtils.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/ReplicationDriver.h"
+#include "BYGReplicationGraph.h"
 #include "BYGMultiplayerUI.h"
+#include "BYGMultiplayerStats.h"
+#include "Misc/CommandLine.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Async/Async.h"
+#include "Algo/StableSort.h"
+#include "Icmp.h"
 
 
 DEFINE_LOG_CATEGORY (LogBYGMultiplayer);
+#if ENGINE_MAJOR_VERSION >= 5
+LLM_DEFINE_TAG(BYGMultiplayer);
+#endif
+
+DECLARE_CYCLE_STAT(TEXT("Initialize"), STAT_BYGMultiplayer_Initialize, STATGROUP_BYGMultiplayer);
+DECLARE_CYCLE_STAT(TEXT("Initialize core"), STAT_BYGMultiplayer_InitializeCore, STATGROUP_BYGMultiplayer);
+DECLARE_CYCLE_STAT(TEXT("Initialize UI"), STAT_BYGMultiplayer_InitializeUI, STATGROUP_BYGMultiplayer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Search results"), STAT_BYGMultiplayer_NumSearchResults, STATGROUP_BYGMultiplayer);
+DECLARE_MEMORY_STAT(TEXT("Search results memory"), STAT_BYGMultiplayer_SearchResultsMemory, STATGROUP_BYGMultiplayer);
 
 void UBYGMultiplayerSubsystem::ResetState()
 {
-	CurrentSubsystemName = NAME_None;
 	OnlineSessionSettings = FBYGOnlineSessionSettings();
 
 	IOnlineSessionPtr SessionInterface = GetSession();
@@ -26,30 +49,56 @@ void UBYGMultiplayerSubsystem::ResetState()
 		SessionInterface->ClearOnJoinSessionCompleteDelegate_Handle(JoinCompleteDelegateHandle);
 		SessionInterface->ClearOnFindSessionsCompleteDelegate_Handle(FindSessionsCompleteDelegateHandle);
 		SessionInterface->ClearOnEndSessionCompleteDelegate_Handle(EndSessionCompleteDelegateHandle);
+		SessionInterface->ClearOnUpdateSessionCompleteDelegate_Handle(UpdateSessionCompleteDelegateHandle);
+		SessionInterface->ClearOnDestroySessionCompleteDelegate_Handle(DestroySessionCompleteDelegateHandle);
+		SessionInterface->ClearOnRegisterPlayersCompleteDelegate_Handle(RegisterPlayersCompleteDelegateHandle);
+		SessionInterface->ClearOnUnregisterPlayersCompleteDelegate_Handle(UnregisterPlayersCompleteDelegateHandle);
 
 		SessionInterface->DestroySession(NAME_GameSession);
 	}
-	IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(CurrentSubsystemName);
-	if (Subsystem)
+	IOnlineIdentityPtr Identity = GetIdentity();
+	if (Identity.IsValid())
 	{
-		IOnlineIdentityPtr Identity = Subsystem->GetIdentityInterface();
-		if (Identity.IsValid())
-		{
-			Identity->ClearOnLoginCompleteDelegate_Handle(0, LoginCompleteDelegateHandle);
-		}
+		Identity->ClearOnLoginCompleteDelegate_Handle(0, LoginCompleteDelegateHandle);
+	}
+
+	// Clear this last, the cleanup above needs to talk to the subsystem we were using
+	CurrentSubsystemName = NAME_None;
+
+	RestoreNetProfile();
+	StopReservationBeacon();
+	MultiSearch.Cancel();
+
+	LoginState = EBYGLoginState::NotLoggedIn;
+	LoginAttempts = 0;
+	CachedPlayerId.Reset();
+	CachedPlayerNickname.Reset();
+	if (PendingLoginActions.Num() > 0)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Dropping %d actions that were waiting for login"), PendingLoginActions.Num());
+		PendingLoginActions.Reset();
 	}
+
+	RefreshSessionSnapshot();
 }
 
-void UBYGMultiplayerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+bool UBYGMultiplayerSubsystem::ShouldCreateSubsystem(UObject* Outer) const
 {
-	Super::Initialize(Collection);
+	if (!bEnabled || FParse::Param(FCommandLine::Get(), TEXT("NoBYGMultiplayer")))
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("BYGMultiplayer subsystem is disabled"));
+		return false;
+	}
+	return Super::ShouldCreateSubsystem(Outer);
+}
 
-#if WITH_IMGUI
-	UI = NewObject<UBYGMultiplayerUI>(this);
-	UI->Init();
-#endif
+void UBYGMultiplayerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	SCOPE_CYCLE_COUNTER(STAT_BYGMultiplayer_Initialize);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UBYGMultiplayerSubsystem::Initialize);
+	BYG_LLM_SCOPE();
 
-	ResetState();
+	Super::Initialize(Collection);
 
 	// Register all of our delegates to call our functions when they are fired
 	CreateCompleteDelegate = FOnCreateSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnCreateSessionComplete);
@@ -59,10 +108,31 @@ void UBYGMultiplayerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 	LoginCompleteDelegate = FOnLoginCompleteDelegate::CreateUObject(this, &ThisClass::OnLoginComplete);
 	EndSessionCompleteDelegate = FOnEndSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnEndSessionComplete);
 
-	if (ensure(GEngine))
+#if ENGINE_MAJOR_VERSION >= 5
+	TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::Tick));
+#else
+	TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::Tick));
+#endif
+
+	HostMigration.Init(this);
+	SeamlessTravel.Init(this);
+	TravelProfiler.Init(this);
+	StreamingLobby.Init(this);
+	MultiSearch.Init(this);
+	LanDiscovery.Init(this);
+	InitNetCoordinate();
+	ServerHistory.Init(this);
+	MultiSearch.OnResultsMerged.BindUObject(this, &ThisClass::RefreshSearchSnapshot);
+	MultiSearch.OnComplete.BindUObject(this, &ThisClass::OnFindSessionsComplete);
+
+	bAutoHostPending = ShouldAutoHost();
+	if (bDeferInitialization && !bAutoHostPending)
 	{
-		GEngine->OnTravelFailure().AddUObject(this, &UBYGMultiplayerSubsystem::HandleTravelFailure);
-		GEngine->OnNetworkFailure().AddUObject(this, &UBYGMultiplayerSubsystem::HandleNetworkFailure);
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Deferring initialization until first use or Warmup()"));
+	}
+	else
+	{
+		EnsureInitialized();
 	}
 }
 
@@ -70,11 +140,302 @@ void UBYGMultiplayerSubsystem::Deinitialize()
 {
 	Super::Deinitialize();
 
+	// They may be reading SessionSearch
+	WaitForSearchProcessing();
+	SessionSearch.Reset();
+	SearchPool.Empty();
+	SeamlessTravel.Deinit();
+	TravelProfiler.Deinit();
+	ServerHistory.Deinit();
+	SaveNetCoordinate(false);
+	MultiSearch.Cancel();
+	LanDiscovery.Deinit();
+
+#if ENGINE_MAJOR_VERSION >= 5
+	FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+#else
+	FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+#endif
+
+	if (Recorder.IsRecording())
+	{
+		StopRecording();
+	}
+
+	if (bCoreInitialized)
+	{
+		if (GEngine)
+		{
+			GEngine->OnTravelFailure().RemoveAll(this);
+			GEngine->OnNetworkFailure().RemoveAll(this);
+		}
+		FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+		FGameModeEvents::GameModePreLoginEvent.Remove(PreLoginHandle);
+		FGameModeEvents::GameModePostLoginEvent.Remove(PostLoginHandle);
+		FGameModeEvents::GameModeLogoutEvent.Remove(LogoutHandle);
+		if (bBoundReplicationDriver)
+		{
+			UReplicationDriver::CreateReplicationDriverDelegate().Unbind();
+			bBoundReplicationDriver = false;
+		}
+		// Also stops scaling spawns
+		ResetState();
+	}
+}
+
+void UBYGMultiplayerSubsystem::Warmup()
+{
+	if (!IsInitialized() && !bIsWarmingUp)
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Warming up"));
+		bIsWarmingUp = true;
+	}
+}
+
+bool UBYGMultiplayerSubsystem::ShouldAutoHost() const
+{
+	if (FParse::Param(FCommandLine::Get(), TEXT("NoBYGAutoHost")))
+	{
+		return false;
+	}
+	return FParse::Param(FCommandLine::Get(), TEXT("BYGAutoHost"))
+		|| (bAutoHostDedicatedServer && IsRunningDedicatedServer());
+}
+
+void UBYGMultiplayerSubsystem::ApplyAutoHostSettings()
+{
+	const TCHAR* CommandLine = FCommandLine::Get();
+
+	FString ServerName = AutoHostServerName;
+	FParse::Value(CommandLine, TEXT("BYGServerName="), ServerName);
+	const int32 MaxPlayers = GetAutoHostMaxPlayers();
+	FString MapName = AutoHostMap;
+	FParse::Value(CommandLine, TEXT("BYGMap="), MapName);
+	FString PublicMapName = AutoHostPublicMapName;
+	FParse::Value(CommandLine, TEXT("BYGPublicMapName="), PublicMapName);
+	if (PublicMapName.IsEmpty())
+	{
+		PublicMapName = MapName.IsEmpty() ? GetWorld()->GetMapName() : MapName;
+	}
+
+	OnlineSessionSettings = FBYGOnlineSessionSettings();
+	OnlineSessionSettings.ServerName = ServerName;
+	OnlineSessionSettings.NumPublicConnections = FMath::Max(MaxPlayers, 1);
+	OnlineSessionSettings.NumPrivateConnections = 0;
+	OnlineSessionSettings.bIsLANMatch = bAutoHostLAN || FParse::Param(CommandLine, TEXT("BYGLAN"));
+	OnlineSessionSettings.bIsDedicated = IsRunningDedicatedServer();
+	// Presence needs a logged in user
+	OnlineSessionSettings.bUsesPresence = !OnlineSessionSettings.bIsDedicated;
+	OnlineSessionSettings.bAllowJoinViaPresence = !OnlineSessionSettings.bIsDedicated;
+	OnlineSessionSettings.TargetMapName = MapName.IsEmpty() ? NAME_None : FName(*MapName);
+	OnlineSessionSettings.TargetPublicFacingMapName = PublicMapName;
+	// Dedicated servers are already listening
+	OnlineSessionSettings.MapArguments.Reset();
+	if (!OnlineSessionSettings.bIsDedicated)
+	{
+		OnlineSessionSettings.MapArguments.Add(TEXT("listen"));
+	}
+}
+
+int32 UBYGMultiplayerSubsystem::GetAutoHostMaxPlayers() const
+{
+	int32 MaxPlayers = AutoHostMaxPlayers;
+	FParse::Value(FCommandLine::Get(), TEXT("BYGMaxPlayers="), MaxPlayers);
+	return MaxPlayers;
+}
+
+void UBYGMultiplayerSubsystem::StartAutoHost()
+{
+	InitializeCore();
+	ApplyAutoHostSettings();
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Auto-hosting '%s' for %d players on %s, %.2fms after boot"),
+		*OnlineSessionSettings.ServerName, OnlineSessionSettings.NumPublicConnections,
+		OnlineSessionSettings.TargetMapName.IsNone() ? TEXT("the current map") : *OnlineSessionSettings.TargetMapName.ToString(),
+		(FPlatformTime::Seconds() - GStartTime) * 1000.0);
+	HostGame();
+}
+
+void UBYGMultiplayerSubsystem::EnsureInitialized()
+{
+	InitializeCore();
+	InitializeUI();
+}
+
+void UBYGMultiplayerSubsystem::TickWarmup()
+{
+	// One stage per frame so we don't hitch the splash screen
+	if (!bCoreInitialized)
+	{
+		InitializeCore();
+	}
+	else if (!bUIInitialized)
+	{
+		InitializeUI();
+	}
+
+	if (IsInitialized())
+	{
+		bIsWarmingUp = false;
+	}
+}
+
+void UBYGMultiplayerSubsystem::InitializeCore()
+{
+	if (bCoreInitialized)
+	{
+		return;
+	}
+	// Set first, Login() below comes back through here
+	bCoreInitialized = true;
+
+	SCOPE_CYCLE_COUNTER(STAT_BYGMultiplayer_InitializeCore);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UBYGMultiplayerSubsystem::InitializeCore);
+	const double StartTime = FPlatformTime::Seconds();
+
 	ResetState();
+	BindSessionNotifications();
+
+	if (ensure(GEngine))
+	{
+		GEngine->OnTravelFailure().AddUObject(this, &UBYGMultiplayerSubsystem::HandleTravelFailure);
+		GEngine->OnNetworkFailure().AddUObject(this, &UBYGMultiplayerSubsystem::HandleNetworkFailure);
+	}
+	PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &ThisClass::OnPostLoadMap);
+	if (!TransitionMap.IsEmpty())
+	{
+		// Seamless travel reads it from here
+		UGameMapsSettings::GetGameMapsSettings()->TransitionMap = FSoftObjectPath(TransitionMap);
+	}
+	PreLoginHandle = FGameModeEvents::GameModePreLoginEvent.AddUObject(this, &ThisClass::OnGameModePreLogin);
+	PostLoginHandle = FGameModeEvents::GameModePostLoginEvent.AddUObject(this, &ThisClass::OnGameModePostLogin);
+	LogoutHandle = FGameModeEvents::GameModeLogoutEvent.AddUObject(this, &ThisClass::OnGameModeLogout);
+
+	if (bUseReplicationGraph)
+	{
+		if (UReplicationDriver::CreateReplicationDriverDelegate().IsBound())
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("Something else already creates replication drivers, not using the replication graph"));
+		}
+		else
+		{
+			UReplicationDriver::CreateReplicationDriverDelegate().BindUObject(this, &ThisClass::CreateReplicationDriver);
+			bBoundReplicationDriver = true;
+		}
+	}
+
+	if (FParse::Param(FCommandLine::Get(), TEXT("BYGRecordSession")))
+	{
+		StartRecording();
+	}
+
+	// Start logging in to the default subsystem straight away so it's usually done by the time someone hosts.
+	// Dedicated servers have nobody to log in, they host as the server itself.
+	if (!IsRunningDedicatedServer())
+	{
+		Login();
+	}
+
+	FString ReplayFilename;
+	if (FParse::Value(FCommandLine::Get(), TEXT("BYGReplaySession="), ReplayFilename))
+	{
+		float ReplaySpeed = 1.0f;
+		FParse::Value(FCommandLine::Get(), TEXT("BYGReplaySpeed="), ReplaySpeed);
+		StartReplay(ReplayFilename, ReplaySpeed);
+	}
+
+	const double Duration = FPlatformTime::Seconds() - StartTime;
+	InitializationSeconds += Duration;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Initialized online subsystem in %.2fms"), Duration * 1000.0);
+}
+
+void UBYGMultiplayerSubsystem::InitializeUI()
+{
+	if (bUIInitialized)
+	{
+		return;
+	}
+	bUIInitialized = true;
+
+#if WITH_IMGUI
+	// Nobody is ever going to look at it
+	if (IsRunningDedicatedServer())
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_BYGMultiplayer_InitializeUI);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UBYGMultiplayerSubsystem::InitializeUI);
+	const double StartTime = FPlatformTime::Seconds();
+
+	UI = NewObject<UBYGMultiplayerUI>(this);
+	UI->Init();
+
+	const double Duration = FPlatformTime::Seconds() - StartTime;
+	InitializationSeconds += Duration;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Initialized debug UI in %.2fms"), Duration * 1000.0);
+#endif
+}
+
+bool UBYGMultiplayerSubsystem::Tick(float DeltaTime)
+{
+	BYG_LLM_SCOPE();
+	if (bIsWarmingUp)
+	{
+		TickWarmup();
+	}
+	if (bAutoHostPending && GetWorld())
+	{
+		bAutoHostPending = false;
+		StartAutoHost();
+	}
+	if (!bCoreInitialized)
+	{
+		return true;
+	}
+
+	TickLogin();
+
+	if (Replayer.IsReplaying())
+	{
+		Replayer.Tick(DeltaTime, [this](const FBYGSessionEvent& Event) { ReplayEvent(Event); });
+	}
+
+	// Anything a worker thread was still reading last time
+	SessionSnapshotBuffer.Flush();
+	SearchSnapshotBuffer.Flush();
+
+	if (bNetStatsEnabled)
+	{
+		NetStats.Tick(GetWorld(), DeltaTime);
+	}
+
+	HostMigration.Tick(DeltaTime);
+	SeamlessTravel.Tick();
+	TravelProfiler.Tick();
+	StreamingLobby.Tick();
+	LanDiscovery.Tick();
+	MultiSearch.Tick();
+	TickNetCoordinate();
+
+	// Covers both travelling to the session's map and dedicated servers hosting on the map they booted into
+	UWorld* World = GetWorld();
+	if (bUseReservations && bIsHosting && World && World != ReservationBeaconWorld.Get()
+		&& (World->GetNetMode() == NM_ListenServer || World->GetNetMode() == NM_DedicatedServer))
+	{
+		IOnlineSessionPtr SessionInterface = GetSession();
+		const EOnlineSessionState::Type State = SessionInterface.IsValid() ? SessionInterface->GetSessionState(NAME_GameSession) : EOnlineSessionState::NoSession;
+		// Not while the session is on its way out
+		if (State == EOnlineSessionState::Pending || State == EOnlineSessionState::Starting || State == EOnlineSessionState::InProgress)
+		{
+			StartReservationBeacon(World);
+		}
+	}
+	return true;
 }
 
 bool UBYGMultiplayerSubsystem::TryChangeOnlineSubsystem(const FName& SubsystemName)
 {
+	InitializeCore();
 	ResetState();
 
 	const bool bWasSuccess = InitializeOnlineSubsystem(SubsystemName);
@@ -100,238 +461,1305 @@ bool UBYGMultiplayerSubsystem::InitializeOnlineSubsystem(const FName& SubsystemN
 		// NOTE: I used to bulk-register a tonne of delegates here, stuff like OnStartSessionCompleteDelegates.AddUObject
 		// But I encountered situations where the delegates were not being fired.
 		// Other examples register just before calling the function, and use the AddOnBlahBlahDelegate_Handle signature.
-
-		if (SubsystemName != "Null")
-		{
-			const int32 LocalUserNum = 0;
-			IOnlineIdentityPtr Identity = Subsystem->GetIdentityInterface();
-			if (Identity.IsValid())
-			{
-				LoginCompleteDelegateHandle = Identity->AddOnLoginCompleteDelegate_Handle(LocalUserNum, LoginCompleteDelegate);
-				if (Identity->AutoLogin(LocalUserNum))
-				{
-					UE_LOG(LogBYGMultiplayer, Log, TEXT("User logged in!"));
-				}
-				else
-				{
-					UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to log user into subsystem"));
-				}
-			}
-			else
-			{
-				UE_LOG(LogBYGMultiplayer, Error, TEXT("Could not get identity interface for login"));
-			}
-		}
+		CurrentSubsystemName = SubsystemName;
+		BindSessionNotifications();
+		Login();
 		return true;
 	}
 	UE_LOG(LogBYGMultiplayer, Error, TEXT("Could not initialize/get subsystem '%s'"), *SubsystemName.ToString());
 	return false;
 }
 
+void UBYGMultiplayerSubsystem::Login()
+{
+	InitializeCore();
+	if (LoginState == EBYGLoginState::LoggedIn || LoginState == EBYGLoginState::LoggingIn)
+	{
+		return;
+	}
+	LoginAttempts = 0;
+	StartLoginAttempt();
+}
+
+void UBYGMultiplayerSubsystem::StartLoginAttempt()
+{
+	const int32 LocalUserNum = 0;
+	IOnlineIdentityPtr Identity = GetIdentity();
+	if (!Identity.IsValid())
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Could not get identity interface for login"));
+		LoginAttempts = LoginMaxAttempts;
+		OnLoginAttemptFailed(TEXT("No identity interface"));
+		return;
+	}
+
+	// NULL doesn't need a login to hand out an ID, and Steam may have already logged us in
+	if (Identity->GetLoginStatus(LocalUserNum) == ELoginStatus::LoggedIn || Identity->GetUniquePlayerId(LocalUserNum).IsValid())
+	{
+		OnLoggedIn();
+		return;
+	}
+
+	++LoginAttempts;
+	LoginState = EBYGLoginState::LoggingIn;
+	LoginAttemptStartTime = FPlatformTime::Seconds();
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Logging in, attempt %d of %d"), LoginAttempts, LoginMaxAttempts);
+
+	Identity->ClearOnLoginCompleteDelegate_Handle(LocalUserNum, LoginCompleteDelegateHandle);
+	LoginCompleteDelegateHandle = Identity->AddOnLoginCompleteDelegate_Handle(LocalUserNum, LoginCompleteDelegate);
+	// This can complete synchronously, so the state above has to be set up first
+	if (!Identity->AutoLogin(LocalUserNum) && LoginState == EBYGLoginState::LoggingIn)
+	{
+		OnLoginAttemptFailed(TEXT("AutoLogin could not be started"));
+	}
+}
+
+void UBYGMultiplayerSubsystem::TickLogin()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (LoginState == EBYGLoginState::LoggingIn && Now - LoginAttemptStartTime > LoginTimeout)
+	{
+		OnLoginAttemptFailed(FString::Printf(TEXT("Timed out after %.1f seconds"), LoginTimeout));
+	}
+	else if (LoginState == EBYGLoginState::WaitingToRetry && Now >= NextLoginAttemptTime)
+	{
+		StartLoginAttempt();
+	}
+}
+
 void UBYGMultiplayerSubsystem::OnLoginComplete(int32 LocalUserNum, bool bWasSuccessful, const FUniqueNetId& UserId, const FString& Error)
 {
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("On login complete: %s %s"), bWasSuccessful ? TEXT("success") : TEXT("failure"), *Error);
+
+	IOnlineIdentityPtr Identity = GetIdentity();
+	if (Identity.IsValid())
+	{
+		Identity->ClearOnLoginCompleteDelegate_Handle(LocalUserNum, LoginCompleteDelegateHandle);
+	}
+
+	// Late callback from an attempt that already timed out
+	if (LoginState != EBYGLoginState::LoggingIn)
+	{
+		return;
+	}
+
 	if (bWasSuccessful)
 	{
-		IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(CurrentSubsystemName);
-		if (Subsystem)
-		{
-			IOnlineIdentityPtr Identity = Subsystem->GetIdentityInterface();
-			if (Identity)
-			{
-				UE_LOG(LogBYGMultiplayer, Log, TEXT("On ping search results complete : %s"), (bWasSuccessful ? TEXT("success") : TEXT("failure")));
-				Identity->ClearOnLoginCompleteDelegate_Handle(0, LoginCompleteDelegateHandle);
-			}
-		}
+		OnLoggedIn();
+	}
+	else
+	{
+		OnLoginAttemptFailed(Error);
 	}
 }
 
-
-void UBYGMultiplayerSubsystem::HostGame()
+void UBYGMultiplayerSubsystem::OnLoginAttemptFailed(const FString& Error)
 {
-	IOnlineSessionPtr SessionInterface = GetSession();
-	if (SessionInterface.IsValid())
+	IOnlineIdentityPtr Identity = GetIdentity();
+	if (Identity.IsValid())
 	{
-		FOnlineSessionSettings SessionSettings = OnlineSessionSettings.GetSessionSettings();
+		Identity->ClearOnLoginCompleteDelegate_Handle(0, LoginCompleteDelegateHandle);
+	}
 
-		// This is how we can set custom variables
-		// SessionSettings.Set(SERVER_NAME_SETTINGS_KEY, DesiredServerName, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
-		IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(CurrentSubsystemName);
-		const IOnlineIdentityPtr IdentityInterface = Subsystem->GetIdentityInterface();
-		if (!IdentityInterface.IsValid())
-		{
-			UE_LOG(LogBYGMultiplayer, Error, TEXT("Could not get identity interface"));
-			return;
-		}
+	if (LoginAttempts < LoginMaxAttempts)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Login attempt %d failed: %s. Retrying in %.1f seconds"), LoginAttempts, *Error, LoginRetryDelay);
+		LoginState = EBYGLoginState::WaitingToRetry;
+		NextLoginAttemptTime = FPlatformTime::Seconds() + LoginRetryDelay;
+		return;
+	}
 
-		TSharedPtr<const FUniqueNetId> PlayerId = IdentityInterface->GetUniquePlayerId(0);
-		if (!PlayerId.IsValid())
-		{
-			UE_LOG(LogBYGMultiplayer, Error, TEXT("Player ID is invalid"));
-			return;
-		}
+	UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to log user into subsystem: %s"), *Error);
+	LoginState = EBYGLoginState::Failed;
+	Recorder.Record(EBYGSessionEventType::LoginComplete, NAME_None, false, 0, Error);
+	if (PendingLoginActions.Num() > 0)
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Dropping %d actions that were waiting for login"), PendingLoginActions.Num());
+		PendingLoginActions.Reset();
+	}
+}
 
-		CreateCompleteDelegateHandle = SessionInterface->AddOnCreateSessionCompleteDelegate_Handle(CreateCompleteDelegate);
+void UBYGMultiplayerSubsystem::OnLoggedIn()
+{
+	IOnlineIdentityPtr Identity = GetIdentity();
+	if (!ensure(Identity.IsValid()))
+	{
+		return;
+	}
+	CachedPlayerId = Identity->GetUniquePlayerId(0);
+	CachedPlayerNickname = Identity->GetPlayerNickname(0);
+	LoginState = EBYGLoginState::LoggedIn;
+	// bLocalPlayerRegistered depends on who we are
+	RefreshSessionSnapshot();
+	Recorder.Record(EBYGSessionEventType::LoginComplete, NAME_None, true, 0, CachedPlayerNickname);
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("User '%s' logged in!"), *CachedPlayerNickname);
 
-		bIsHosting = SessionInterface->CreateSession(*PlayerId, NAME_GameSession, SessionSettings);
-		if (bIsHosting)
-		{
-			UE_LOG(LogBYGMultiplayer, Log, TEXT("HostGame succeeded"));
-		}
-		else
-		{
-			UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to host"));
-		}
+	// Actions may queue more actions (or reset us), so take ownership first
+	TArray<FPendingLoginAction> Actions = MoveTemp(PendingLoginActions);
+	PendingLoginActions.Reset();
+	for (FPendingLoginAction& Pending : Actions)
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Running '%s' now that we are logged in"), *Pending.Name.ToString());
+		Pending.Action();
+	}
+}
+
+bool UBYGMultiplayerSubsystem::RunWhenLoggedIn(FName Name, TFunction<void()> Action)
+{
+	if (IsLoggedIn())
+	{
+		return true;
+	}
+
+	FPendingLoginAction* Existing = PendingLoginActions.FindByPredicate([Name](const FPendingLoginAction& Pending) { return Pending.Name == Name; });
+	if (Existing)
+	{
+		Existing->Action = MoveTemp(Action);
+	}
+	else
+	{
+		PendingLoginActions.Add({ Name, MoveTemp(Action) });
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Not logged in yet, '%s' will run after login"), *Name.ToString());
+
+	if (LoginState == EBYGLoginState::NotLoggedIn || LoginState == EBYGLoginState::Failed)
+	{
+		Login();
+	}
+	return false;
+}
+
+const TCHAR* UBYGMultiplayerSubsystem::GetLoginStateName(EBYGLoginState State)
+{
+	switch (State)
+	{
+	case EBYGLoginState::NotLoggedIn:
+		return TEXT("Not logged in");
+	case EBYGLoginState::LoggingIn:
+		return TEXT("Logging in");
+	case EBYGLoginState::WaitingToRetry:
+		return TEXT("Waiting to retry");
+	case EBYGLoginState::LoggedIn:
+		return TEXT("Logged in");
+	case EBYGLoginState::Failed:
+		return TEXT("Failed");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
+
+void UBYGMultiplayerSubsystem::HostGame()
+{
+	BYG_LLM_SCOPE();
+	InitializeCore();
+	// Dedicated servers host as themselves, not as a user
+	const bool bHostAsServer = IsRunningDedicatedServer();
+	if (!bHostAsServer && !RunWhenLoggedIn("HostGame", [this]() { HostGame(); }))
+	{
+		return;
+	}
+
+	IOnlineSessionPtr SessionInterface = GetSession();
+	if (SessionInterface.IsValid())
+	{
+		FOnlineSessionSettings SessionSettings = OnlineSessionSettings.GetSessionSettings();
+
+		// This is how we can set custom variables
+		// SessionSettings.Set(SERVER_NAME_SETTINGS_KEY, DesiredServerName, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		TSharedPtr<const FUniqueNetId> PlayerId = CachedPlayerId;
+		if (!bHostAsServer && !PlayerId.IsValid())
+		{
+			UE_LOG(LogBYGMultiplayer, Error, TEXT("Player ID is invalid"));
+			return;
+		}
+
+		SelectNetProfile(SessionSettings);
+		// Lets clients estimate their ping to us without pinging, see BYGNetCoordinate.h. Even before it's valid, so
+		// clients can learn from us while we're still learning ourselves.
+		if (bEstimatePing)
+		{
+			NetCoordinate.Advertise(SessionSettings);
+		}
+
+		CreateCompleteDelegateHandle = SessionInterface->AddOnCreateSessionCompleteDelegate_Handle(CreateCompleteDelegate);
+
+		bIsHosting = bHostAsServer
+			? SessionInterface->CreateSession(0, NAME_GameSession, SessionSettings)
+			: SessionInterface->CreateSession(*PlayerId, NAME_GameSession, SessionSettings);
+		Recorder.Record(EBYGSessionEventType::HostGame, NAME_GameSession, bIsHosting);
+		RefreshSessionSnapshot();
+		if (bIsHosting)
+		{
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("HostGame succeeded"));
+		}
+		else
+		{
+			UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to host"));
+		}
+	}
+	else
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to get session interface"));
+	}
+}
+
+void UBYGMultiplayerSubsystem::SelectNetProfile(FOnlineSessionSettings& SessionSettings)
+{
+	ActiveNetProfile.Reset();
+	if (!bApplyNetProfile)
+	{
+		return;
+	}
+
+	const TArray<FBYGNetProfile>& Profiles = NetProfiles.Num() > 0 ? NetProfiles : FBYGNetProfile::GetDefaults();
+	const FBYGNetProfile* Profile = FBYGNetProfile::Select(Profiles, SessionSettings.NumPublicConnections, SessionSettings.bIsDedicated);
+	if (!Profile)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("No net profile matches %d players (%s), leaving net settings alone"),
+			SessionSettings.NumPublicConnections, SessionSettings.bIsDedicated ? TEXT("dedicated") : TEXT("listen"));
+		return;
+	}
+
+	ActiveNetProfile = *Profile;
+	BYGSessionKeys::NetProfile.Set(SessionSettings, Profile->Name);
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Using net profile '%s': client rate %d, tick rate %d, update frequency x%.2f, timeout %.0fs"),
+		*Profile->Name, Profile->MaxClientRate, Profile->NetServerMaxTickRate, Profile->NetUpdateFrequencyScale, Profile->ConnectionTimeout);
+
+	// Dedicated servers usually host on the map they booted into, so there won't be a load to hook
+	ApplyNetProfile(GetWorld());
+}
+
+void UBYGMultiplayerSubsystem::ApplyNetProfile(UWorld* World)
+{
+	if (!ActiveNetProfile.IsSet() || !World || World->GetNetMode() == NM_Client || World->GetNetMode() == NM_Standalone)
+	{
+		return;
+	}
+
+	if (UNetDriver* NetDriver = World->GetNetDriver())
+	{
+		if (NetProfileDriver.Get() != NetDriver)
+		{
+			NetProfileDriver = NetDriver;
+			OriginalNetDriverSettings = FBYGNetProfile::FromNetDriver(NetDriver);
+		}
+		ActiveNetProfile->ApplyToNetDriver(NetDriver);
+	}
+
+	if (NetProfileWorld.Get() != World)
+	{
+		if (UWorld* PreviousWorld = NetProfileWorld.Get())
+		{
+			PreviousWorld->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+		}
+		NetProfileWorld = World;
+		OriginalActorFrequencies.Reset();
+		ActorSpawnedHandle = World->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &ThisClass::OnActorSpawned));
+	}
+	// Every time, the profile may have changed since we last went through them
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		ApplyNetProfileToActor(*It);
+	}
+}
+
+void UBYGMultiplayerSubsystem::ApplyNetProfileToActor(AActor* Actor)
+{
+	if (!Actor->GetIsReplicated())
+	{
+		return;
+	}
+	TPair<float, float>* Original = OriginalActorFrequencies.Find(Actor);
+	if (!Original)
+	{
+		Original = &OriginalActorFrequencies.Add(Actor);
+		FBYGNetProfile::GetActorFrequencies(Actor, Original->Key, Original->Value);
+	}
+	ActiveNetProfile->ApplyToActor(Actor, Original->Key, Original->Value);
+}
+
+void UBYGMultiplayerSubsystem::RestoreNetProfile()
+{
+	if (UNetDriver* NetDriver = NetProfileDriver.Get())
+	{
+		OriginalNetDriverSettings->ApplyToNetDriver(NetDriver);
+	}
+	for (const TPair<TWeakObjectPtr<AActor>, TPair<float, float>>& Pair : OriginalActorFrequencies)
+	{
+		if (AActor* Actor = Pair.Key.Get())
+		{
+			FBYGNetProfile::SetActorFrequencies(Actor, Pair.Value.Key, Pair.Value.Value);
+		}
+	}
+	if (UWorld* World = NetProfileWorld.Get())
+	{
+		World->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	}
+	if (ActiveNetProfile.IsSet())
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Restored net settings from before net profile '%s'"), *ActiveNetProfile->Name);
+	}
+	ActiveNetProfile.Reset();
+	NetProfileWorld.Reset();
+	NetProfileDriver.Reset();
+	OriginalNetDriverSettings.Reset();
+	OriginalActorFrequencies.Reset();
+}
+
+void UBYGMultiplayerSubsystem::OnPostLoadMap(UWorld* World)
+{
+	// The listen server's net driver only exists once we've travelled
+	if (World && World == GetWorld())
+	{
+		ApplyNetProfile(World);
+		HostMigration.OnPostLoadMap(World);
+		SeamlessTravel.OnPostLoadMap(World);
+		PreloadNextSessionMap(World);
+	}
+}
+
+bool UBYGMultiplayerSubsystem::TravelToLobby()
+{
+	if (StreamingLobby.IsEnabled())
+	{
+		return StreamingLobby.StreamTo(false);
+	}
+	return TravelToSessionMap(OnlineSessionSettings.LobbyMapName);
+}
+
+bool UBYGMultiplayerSubsystem::TravelToMatch()
+{
+	if (StreamingLobby.IsEnabled())
+	{
+		return StreamingLobby.StreamTo(true);
+	}
+	return TravelToSessionMap(OnlineSessionSettings.TargetMapName);
+}
+
+bool UBYGMultiplayerSubsystem::TravelToSessionMap(FName MapName)
+{
+	if (MapName.IsNone())
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("No map to travel to"));
+		return false;
+	}
+	const FString Options = FString::Join(OnlineSessionSettings.MapArguments, TEXT("?"));
+	return SeamlessTravel.Travel(GetWorld(), MapName.ToString(), Options, OnlineSessionSettings.bTravelAbsolute);
+}
+
+void UBYGMultiplayerSubsystem::PreloadNextSessionMap(UWorld* World)
+{
+	// PIE maps are duplicated under a different name, a preloaded copy would never be used
+	if (!bPreloadTravelMaps || bStreamingLobby || World->IsPlayInEditor() || World->GetNetMode() == NM_Standalone)
+	{
+		return;
+	}
+
+	FString LobbyMap;
+	FString MatchMap;
+	IOnlineSessionPtr SessionInterface = GetSession();
+	const FNamedOnlineSession* Session = SessionInterface.IsValid() ? SessionInterface->GetNamedSession(NAME_GameSession) : nullptr;
+	if (bIsHosting)
+	{
+		LobbyMap = OnlineSessionSettings.LobbyMapName.ToString();
+		MatchMap = OnlineSessionSettings.TargetMapName.ToString();
+	}
+	else if (Session)
+	{
+		LobbyMap = BYGSessionKeys::LobbyMap.Get(Session->SessionSettings);
+		MatchMap = BYGSessionKeys::MatchMap.Get(Session->SessionSettings);
+	}
+	if (LobbyMap.IsEmpty() || MatchMap.IsEmpty() || LobbyMap == MatchMap)
+	{
+		return;
+	}
+
+	const FString CurrentMap = FPackageName::GetShortName(UWorld::RemovePIEPrefix(World->GetOutermost()->GetName()));
+	if (CurrentMap == FPackageName::GetShortName(MatchMap))
+	{
+		SeamlessTravel.Preload(LobbyMap);
+	}
+	else if (CurrentMap == FPackageName::GetShortName(LobbyMap))
+	{
+		SeamlessTravel.Preload(MatchMap);
+	}
+}
+
+void UBYGMultiplayerSubsystem::OnActorSpawned(AActor* Actor)
+{
+	if (ActiveNetProfile.IsSet() && Actor)
+	{
+		ApplyNetProfileToActor(Actor);
+	}
+}
+
+void UBYGMultiplayerSubsystem::StartReservationBeacon(UWorld* World)
+{
+	StopReservationBeacon();
+	ReservationBeaconWorld = World;
+
+	// Listens on [/Script/OnlineSubsystemUtils.OnlineBeaconHost] ListenPort, or -BeaconPort=
+	AOnlineBeaconHost* BeaconHost = World->SpawnActor<AOnlineBeaconHost>();
+	if (!BeaconHost || !BeaconHost->InitHost())
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Could not start the reservation beacon, clients will join without reserving"));
+		if (BeaconHost)
+		{
+			BeaconHost->DestroyBeacon();
+		}
+		return;
+	}
+	ABYGReservationBeaconHostObject* HostObject = World->SpawnActor<ABYGReservationBeaconHostObject>();
+	BeaconHost->RegisterHost(HostObject);
+	BeaconHost->PauseBeaconRequests(false);
+	ReservationBeaconHost = BeaconHost;
+	ReservationHost = HostObject;
+
+	// The session was created before we had a port to advertise
+	IOnlineSessionPtr SessionInterface = GetSession();
+	FNamedOnlineSession* Session = SessionInterface.IsValid() ? SessionInterface->GetNamedSession(NAME_GameSession) : nullptr;
+	if (Session)
+	{
+		FOnlineSessionSettings UpdatedSettings = Session->SessionSettings;
+		HostObject->MaxPublicSlots = UpdatedSettings.NumPublicConnections;
+		HostObject->MaxPrivateSlots = UpdatedSettings.NumPrivateConnections;
+		BYGSessionKeys::BeaconPort.Set(UpdatedSettings, BeaconHost->GetListenPort());
+		SessionInterface->UpdateSession(NAME_GameSession, UpdatedSettings, true);
+	}
+	else
+	{
+		HostObject->MaxPublicSlots = OnlineSessionSettings.NumPublicConnections;
+		HostObject->MaxPrivateSlots = OnlineSessionSettings.NumPrivateConnections;
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Reservation beacon listening on port %d for %d public and %d private slots"),
+		BeaconHost->GetListenPort(), HostObject->MaxPublicSlots, HostObject->MaxPrivateSlots);
+}
+
+void UBYGMultiplayerSubsystem::StopReservationBeacon()
+{
+	if (AOnlineBeaconHost* BeaconHost = ReservationBeaconHost.Get())
+	{
+		BeaconHost->DestroyBeacon();
+	}
+	if (ABYGReservationBeaconHostObject* HostObject = ReservationHost.Get())
+	{
+		HostObject->Destroy();
+	}
+	ReservationBeaconHost.Reset();
+	ReservationHost.Reset();
+	ReservationBeaconWorld.Reset();
+}
+
+void UBYGMultiplayerSubsystem::OnGameModePreLogin(AGameModeBase* GameMode, const FUniqueNetIdRepl& NewPlayer, FString& ErrorMessage)
+{
+	ABYGReservationBeaconHostObject* HostObject = ReservationHost.Get();
+	if (HostObject && ErrorMessage.IsEmpty() && GameMode && GameMode->GetWorld() == HostObject->GetWorld()
+		&& !HostObject->CanLogin(NewPlayer))
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Refusing %s, every free slot is reserved"), *NewPlayer.ToString());
+		ErrorMessage = TEXT("Server full");
+	}
+}
+
+void UBYGMultiplayerSubsystem::OnGameModePostLogin(AGameModeBase* GameMode, APlayerController* NewPlayer)
+{
+	ABYGReservationBeaconHostObject* HostObject = ReservationHost.Get();
+	if (HostObject && NewPlayer && NewPlayer->PlayerState)
+	{
+		HostObject->ConsumeReservation(NewPlayer->PlayerState->GetUniqueId());
+	}
+}
+
+void UBYGMultiplayerSubsystem::OnGameModeLogout(AGameModeBase* GameMode, AController* Exiting)
+{
+	ABYGReservationBeaconHostObject* HostObject = ReservationHost.Get();
+	if (HostObject && Exiting && Exiting->PlayerState)
+	{
+		HostObject->OnPlayerLeft(Exiting->PlayerState->GetUniqueId());
+	}
+}
+
+UReplicationDriver* UBYGMultiplayerSubsystem::CreateReplicationDriver(UNetDriver* NetDriver, const FURL& URL, UWorld* World)
+{
+	// Beacons, demos and other game instances (PIE) keep the default
+	if (!NetDriver || NetDriver->NetDriverName != NAME_GameNetDriver || (World && World->GetGameInstance() != GetGameInstance()))
+	{
+		return nullptr;
+	}
+
+	const int32 SessionSize = GetExpectedSessionSize();
+	if (SessionSize < ReplicationGraphMinPlayers)
+	{
+		return nullptr;
+	}
+
+	UClass* GraphClass = ReplicationGraphClass.IsNull() ? UBYGReplicationGraph::StaticClass() : ReplicationGraphClass.LoadSynchronous();
+	if (!GraphClass)
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Could not load replication graph class '%s'"), *ReplicationGraphClass.ToString());
+		return nullptr;
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Using %s for a %d player session"), *GraphClass->GetName(), SessionSize);
+	return NewObject<UReplicationDriver>(GetTransientPackage(), GraphClass);
+}
+
+int32 UBYGMultiplayerSubsystem::GetExpectedSessionSize() const
+{
+	if (bIsHosting)
+	{
+		return OnlineSessionSettings.NumPublicConnections;
+	}
+	// Dedicated servers start listening before the auto-host kicks in
+	if (ShouldAutoHost())
+	{
+		return GetAutoHostMaxPlayers();
+	}
+	return 0;
+}
+
+void UBYGMultiplayerSubsystem::CancelHostingGame()
+{
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Start cancel hosting"));
+	InitializeCore();
+	IOnlineSessionPtr SessionInterface = GetSession();
+	if (SessionInterface)
+	{
+		Recorder.Record(EBYGSessionEventType::CancelHosting, NAME_GameSession);
+		bIsEndingHosting = true;
+		DoEndSession(NAME_GameSession);
+	}
+}
+
+void UBYGMultiplayerSubsystem::OnCreateSessionComplete(FName SessionName, bool bWasSuccessful)
+{
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("On create session '%s' complete: %s"), *SessionName.ToString(), bWasSuccessful ? TEXT("success") : TEXT("failure"));
+	Recorder.Record(EBYGSessionEventType::CreateSessionComplete, SessionName, bWasSuccessful);
+	IOnlineSessionPtr SessionInterface = GetSession();
+	if (SessionInterface.IsValid())
+	{
+		SessionInterface->ClearOnCreateSessionCompleteDelegate_Handle(CreateCompleteDelegateHandle);
+		if (bWasSuccessful)
+		{
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Automatically starting session"));
+			StartCompleteDelegateHandle = SessionInterface->AddOnStartSessionCompleteDelegate_Handle(StartCompleteDelegate);
+			SessionInterface->StartSession(SessionName);
+		}
+	}
+	RefreshSessionSnapshot();
+}
+
+void UBYGMultiplayerSubsystem::StartSession()
+{
+	IOnlineSessionPtr SessionInterface = GetSession();
+	if (SessionInterface.IsValid())
+	{
+		StartCompleteDelegateHandle = SessionInterface->AddOnStartSessionCompleteDelegate_Handle(StartCompleteDelegate);
+		SessionInterface->StartSession(NAME_GameSession);
+		RefreshSessionSnapshot();
+	}
+}
+
+void UBYGMultiplayerSubsystem::OnStartSessionComplete(FName SessionName, bool bWasSuccessful)
+{
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("On start session '%s' complete: %s"), *SessionName.ToString(), bWasSuccessful ? TEXT("success") : TEXT("failure"));
+	Recorder.Record(EBYGSessionEventType::StartSessionComplete, SessionName, bWasSuccessful);
+	RefreshSessionSnapshot();
+	if (bWasSuccessful)
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Travelling to target map: '%s'"), *OnlineSessionSettings.TargetMapName.ToString());
+
+		IOnlineSessionPtr SessionInterface = GetSession();
+		if (SessionInterface.IsValid())
+		{
+			SessionInterface->ClearOnStartSessionCompleteDelegate_Handle(StartCompleteDelegateHandle);
+		}
+		if (IsReplaying())
+		{
+			return;
+		}
+		if (OnlineSessionSettings.TargetMapName.IsNone())
+		{
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Session started %.2fms after boot, staying on the current map"), (FPlatformTime::Seconds() - GStartTime) * 1000.0);
+			return;
+		}
+		const FString Arguments = FString::Join(OnlineSessionSettings.MapArguments, TEXT("?"));
+		TravelProfiler.Begin(TEXT("Host"), OnlineSessionSettings.TargetMapName.ToString());
+		UGameplayStatics::OpenLevel(GetWorld(), OnlineSessionSettings.TargetMapName, OnlineSessionSettings.bTravelAbsolute, Arguments);
+	}
+}
+
+void UBYGMultiplayerSubsystem::FindSessions()
+{
+	BYG_LLM_SCOPE();
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Finding sessions"));
+	InitializeCore();
+	MultiSearch.Cancel();
+	TArray<FBYGSearchSource> Sources = SearchSources;
+	if (Sources.Num() == 0 && bFindLAN && LanDiscovery.IsEnabled())
+	{
+		FBYGSearchSource& Source = Sources.AddDefaulted_GetRef();
+		Source.Subsystem = FBYGLanDiscovery::SubsystemName;
+		Source.bLAN = true;
+	}
+	IOnlineSessionPtr SessionInterface = GetSession();
+	if (SessionInterface.IsValid() && Sources.Num() > 0)
+	{
+		SessionInterface->ClearOnFindSessionsCompleteDelegate_Handle(FindSessionsCompleteDelegateHandle);
+		SessionSearch = SearchPool.Acquire();
+		const bool bStarted = MultiSearch.Start(SessionSearch.ToSharedRef(), Sources);
+		if (!bStarted)
+		{
+			UE_LOG(LogBYGMultiplayer, Error, TEXT("None of the %d search sources could be started"), Sources.Num());
+		}
+		Recorder.Record(EBYGSessionEventType::FindSessions, NAME_None, bStarted, 0);
+		RefreshSearchSnapshot();
+	}
+	else if (SessionInterface.IsValid())
+	{
+		SessionSearch = SearchPool.Acquire();
+		if (SessionSearch.IsValid())
+		{
+			SessionSearch->bIsLanQuery = bFindLAN;
+			SessionSearch->MaxSearchResults = GetMaxSearchResults();
+			SessionSearch->TimeoutInSeconds = FindTimeout;
+			// NOTE: THIS IS INCREDIBLY IMPORTANT
+			SessionSearch->QuerySettings.Set(SEARCH_PRESENCE, bFindViaPresence, EOnlineComparisonOp::Equals);
+			// NOTE ^
+			FindSessionsCompleteDelegateHandle = SessionInterface->AddOnFindSessionsCompleteDelegate_Handle(FindSessionsCompleteDelegate);
+			const bool bStarted = SessionInterface->FindSessions(0, SessionSearch.ToSharedRef());
+			Recorder.Record(EBYGSessionEventType::FindSessions, NAME_None, bStarted, bFindLAN ? 1 : 0);
+			RefreshSearchSnapshot();
+		}
+		else
+		{
+			UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to create new session search interface"));
+		}
+	}
+	else
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to get session interface"));
+	}
+}
+
+void UBYGMultiplayerSubsystem::OnFindSessionsComplete(bool bWasSuccessful)
+{
+	BYG_LLM_SCOPE();
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("On find session complete: %s"), bWasSuccessful ? TEXT("success") : TEXT("failure"));
+
+	IOnlineSessionPtr SessionInterface = GetSession();
+	if (SessionInterface.IsValid())
+	{
+		SessionInterface->ClearOnFindSessionsCompleteDelegate_Handle(FindSessionsCompleteDelegateHandle);
+	}
+
+	// Not every subsystem sticks to MaxSearchResults. Multi-searches are already trimmed as they merge, so they
+	// never get reordered here, and trimming their settings twice does nothing.
+	if (SessionSearch.IsValid())
+	{
+		TArray<FOnlineSessionSearchResult>& Results = SessionSearch->SearchResults;
+		// Every real ping tells us a little more about where we are, which helps estimate the ones we don't have
+		if (bLearnNetCoordinate && !IsReplaying())
+		{
+			for (const FOnlineSessionSearchResult& Result : Results)
+			{
+				if (FBYGNetCoordinate::HasMeasuredPing(Result))
+				{
+					ObserveLatency(Result.Session.SessionSettings.Settings, Result.PingInMs);
+				}
+			}
+		}
+		if (MaxRetainedSearchResults > 0 && Results.Num() > MaxRetainedSearchResults)
+		{
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Keeping the %d results with the lowest ping out of %d"), MaxRetainedSearchResults, Results.Num());
+			const FBYGNetCoordinate Local = GetEstimationCoordinate();
+			Algo::StableSortBy(Results, [&Local](const FOnlineSessionSearchResult& Result) { return FBYGNetCoordinate::GetPing(Result, Local); });
+			Results.SetNum(MaxRetainedSearchResults);
+		}
+		for (FOnlineSessionSearchResult& Result : Results)
+		{
+			FBYGSearchPool::TrimResult(Result, MaxSearchSettingLength);
+		}
+	}
+
+	RefreshSearchSnapshot();
+
+	if (SessionSearch.IsValid())
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Found %d results"), SessionSearch->SearchResults.Num());
+
+		if (FBYGSessionEvent* Event = Recorder.Record(EBYGSessionEventType::FindSessionsComplete, NAME_None, bWasSuccessful))
+		{
+			Event->SearchResults.Reserve(SessionSearch->SearchResults.Num());
+			for (const FOnlineSessionSearchResult& Result : SessionSearch->SearchResults)
+			{
+				Event->SearchResults.Add(FBYGRecordedSearchResult::FromSearchResult(Result));
+			}
+		}
+		ProbeSearchResults();
+	}
+}
+
+void UBYGMultiplayerSubsystem::OnJoinSessionComplete(FName SessionName, EOnJoinSessionCompleteResult::Type Result)
+{
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("On join session '%s' complete with result: %s"), *SessionName.ToString(), LexToString(Result));
+	Recorder.Record(EBYGSessionEventType::JoinSessionComplete, SessionName, Result == EOnJoinSessionCompleteResult::Success, (int32)Result);
+	RefreshSessionSnapshot();
+	IOnlineSessionPtr SessionInterface = GetSession();
+	if (SessionInterface.IsValid())
+	{
+		SessionInterface->ClearOnJoinSessionCompleteDelegate_Handle(JoinCompleteDelegateHandle);
+	}
+	const bool bSkipTravel = bSkipJoinTravel;
+	bSkipJoinTravel = false;
+
+	if (Result == EOnJoinSessionCompleteResult::Success)
+	{
+		bIsJoinedSession = true;
+		FString ConnectInfo;
+		if (!SessionInterface.IsValid())
+		{
+			// Replaying, or the subsystem went away under us. Either way there's nowhere to travel to.
+		}
+		else if (bSkipTravel)
+		{
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Already connecting to the session's host, not travelling again"));
+		}
+		else if (SessionInterface->GetResolvedConnectString(SessionName, ConnectInfo))
+		{
+			// Only kept once the host has let us in
+			if (const FNamedOnlineSession* Session = SessionInterface->GetNamedSession(SessionName))
+			{
+				ServerHistory.Remember(FBYGServerHistory::GetSessionId(*Session), ConnectInfo, CurrentSubsystemName, Session->SessionSettings);
+			}
+			ConnectInfo += HostMigration.GetJoinOptions();
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Connect string: %s"), *ConnectInfo);
+			APlayerController* PC = GetGameInstance()->GetFirstLocalPlayerController(GetWorld());
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Travelling client"));
+			TravelProfiler.Begin(TEXT("Join"), FString());
+			PC->ClientTravel(ConnectInfo, ETravelType::TRAVEL_Absolute);
+		}
+		else
+		{
+			UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to get connect string"));
+		}
+	}
+	else
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Join session complete returned non-success! %s"), LexToString(Result));
+		bIsJoinedSession = false;
+	}
+}
+
+void UBYGMultiplayerSubsystem::JoinSession(uint32 Index)
+{
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Join session index '%d'"), Index);
+	InitializeCore();
+
+	if (!SessionSearch.IsValid())
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Called join session but session search instance is invalid"));
+		return;
+	}
+	if (!SessionSearch->SearchResults.IsValidIndex(Index))
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Called join session with index %d but session search results only have %d entries. Invalid index."), Index, SessionSearch->SearchResults.Num());
+		return;
+	}
+	if (!CanJoinResult(Index))
+	{
+		return;
+	}
+
+	// By the time login completes another search may have replaced this one, so hold on to the result itself
+	const TSharedPtr<FOnlineSessionSearch> Search = SessionSearch;
+	const FOnlineSessionSearchResult Result = SessionSearch->SearchResults[Index];
+	if (!RunWhenLoggedIn("JoinSession", [this, Search, Index, Result]()
+	{
+		if (SessionSearch == Search)
+		{
+			JoinSession(Index);
+		}
+		else
+		{
+			JoinSearchResult(Result);
+		}
+	}))
+	{
+		return;
+	}
+
+	ReservationAttempts.Reset();
+	ReservationMembers = { FUniqueNetIdRepl(CachedPlayerId) };
+	bReservationPrivateSlots = false;
+	bPartyReservation = false;
+	if (!RequestReservation(Index))
+	{
+		DoJoinSession(Index);
+	}
+}
+
+void UBYGMultiplayerSubsystem::ReservePartySlots(uint32 Index, const TArray<FUniqueNetIdRepl>& Members, bool bPrivateSlots)
+{
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Reserve %d %s slots at index '%d'"), Members.Num(), bPrivateSlots ? TEXT("private") : TEXT("public"), Index);
+	InitializeCore();
+
+	if (!SessionSearch.IsValid() || !SessionSearch->SearchResults.IsValidIndex(Index))
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Called reserve party slots with index %d but there is no such search result"), Index);
+		return;
+	}
+	if (Members.Num() == 0)
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Called reserve party slots without any members"));
+		return;
+	}
+	if (!CanJoinResult(Index))
+	{
+		return;
+	}
+
+	// Not "JoinSession", a plain join asked for before login is a separate request and shouldn't be replaced by this
+	const TSharedPtr<FOnlineSessionSearch> Search = SessionSearch;
+	const FOnlineSessionSearchResult Result = SessionSearch->SearchResults[Index];
+	if (!RunWhenLoggedIn("ReservePartySlots", [this, Search, Index, Result, Members, bPrivateSlots]()
+	{
+		// Same as JoinSession, the search may have been replaced
+		if (SessionSearch == Search)
+		{
+			ReservePartySlots(Index, Members, bPrivateSlots);
+		}
+		else
+		{
+			SetSearchResult(Result);
+			ReservePartySlots(0, Members, bPrivateSlots);
+		}
+	}))
+	{
+		return;
+	}
+
+	ReservationAttempts.Reset();
+	ReservationMembers = Members;
+	bReservationPrivateSlots = bPrivateSlots;
+	bPartyReservation = true;
+	// Without a beacon there's no way to hold slots for the others, so look for a host that has one
+	if (!RequestReservation(Index) && !TryNextReservation())
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("No session can take a party of %d"), Members.Num());
+		OnPartyReservationComplete.Broadcast(EBYGReservationResult::Full, FString());
+	}
+}
+
+bool UBYGMultiplayerSubsystem::JoinDirect(const FString& ConnectInfo)
+{
+	InitializeCore();
+	APlayerController* PC = GetGameInstance()->GetFirstLocalPlayerController(GetWorld());
+	if (!PC)
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("No local player controller to travel with"));
+		return false;
+	}
+	const FString URL = ConnectInfo + HostMigration.GetJoinOptions();
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Joining %s directly"), *URL);
+	TravelProfiler.Begin(TEXT("Join"), FString());
+	PC->ClientTravel(URL, ETravelType::TRAVEL_Absolute);
+	return true;
+}
+
+void UBYGMultiplayerSubsystem::JoinSearchResult(const FOnlineSessionSearchResult& Result, bool bAlreadyConnecting)
+{
+	BYG_LLM_SCOPE();
+	InitializeCore();
+	// Through the usual path, so compatibility checks, reservations and the UI all see it
+	SetSearchResult(Result);
+	if (bAlreadyConnecting)
+	{
+		// No reservation either, we're already taking the slot
+		bSkipJoinTravel = true;
+		DoJoinSession(0);
+		return;
+	}
+	JoinSession(0);
+}
+
+void UBYGMultiplayerSubsystem::SetSearchResult(const FOnlineSessionSearchResult& Result)
+{
+	MultiSearch.Cancel();
+	TSharedRef<FOnlineSessionSearch> Search = SearchPool.Acquire();
+	Search->SearchResults.Add(Result);
+	Search->SearchState = EOnlineAsyncTaskState::Done;
+	SessionSearch = Search;
+	RefreshSearchSnapshot();
+}
+
+bool UBYGMultiplayerSubsystem::RejoinServer(const FString& Key)
+{
+	InitializeCore();
+	return ServerHistory.Rejoin(Key);
+}
+
+bool UBYGMultiplayerSubsystem::RequestReservation(int32 Index)
+{
+	if (!bUseReservations || Replayer.IsReplaying())
+	{
+		return false;
+	}
+
+	const FOnlineSessionSearchResult& SearchResult = SessionSearch->SearchResults[Index];
+	FString ConnectInfo;
+	// Hosts from before reservations, or whose beacon couldn't start
+	if (BYGSessionKeys::BeaconPort.Get(SearchResult) <= 0 || !GetConnectString(SearchResult, NAME_BeaconPort, ConnectInfo))
+	{
+		return false;
+	}
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return false;
+	}
+
+	if (ABYGReservationBeaconClient* Previous = ReservationClient.Get())
+	{
+		Previous->OnResponse.Unbind();
+		Previous->DestroyBeacon();
+	}
+	ReservationClient.Reset();
+	ReservationAttempts.Add(Index);
+
+	ABYGReservationBeaconClient* Client = World->SpawnActor<ABYGReservationBeaconClient>();
+	if (!Client)
+	{
+		return false;
+	}
+	if (!Client->RequestReservation(ConnectInfo, ReservationMembers, bReservationPrivateSlots))
+	{
+		Client->DestroyBeacon();
+		return false;
+	}
+	// Bound afterwards, a synchronous failure above has already been handled by the caller
+	Client->OnResponse.BindUObject(this, &ThisClass::OnReservationResponse, Index);
+	ReservationClient = Client;
+	return true;
+}
+
+void UBYGMultiplayerSubsystem::OnReservationResponse(EBYGReservationResult Result, int32 Index)
+{
+	ReservationClient.Reset();
+	if (!SessionSearch.IsValid() || !SessionSearch->SearchResults.IsValidIndex(Index))
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Search results changed while reserving, not joining"));
+		return;
+	}
+
+	if (Result == EBYGReservationResult::Granted)
+	{
+		if (IsPartyReservation())
+		{
+			FString ConnectInfo;
+			GetConnectString(SessionSearch->SearchResults[Index], NAME_GamePort, ConnectInfo);
+			OnPartyReservationComplete.Broadcast(Result, ConnectInfo);
+		}
+		DoJoinSession(Index);
+		return;
+	}
+	// A firewalled beacon port says nothing about the game port, so a single player joins anyway, same as a host
+	// without a beacon. Parties can't, the others would have no slots.
+	if (Result == EBYGReservationResult::ConnectionFailed && !IsPartyReservation())
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Couldn't reach the reservation beacon for result %d, joining it without a reservation"), Index);
+		DoJoinSession(Index);
+		return;
+	}
+
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Reservation for result %d: %s, trying the next one"), Index, ABYGReservationBeaconClient::GetResultName(Result));
+	if (!TryNextReservation())
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("No sessions left to join after %d reservation attempts"), ReservationAttempts.Num());
+		if (IsPartyReservation())
+		{
+			OnPartyReservationComplete.Broadcast(Result, FString());
+		}
+	}
+}
+
+bool UBYGMultiplayerSubsystem::TryNextReservation()
+{
+	const bool bIsParty = IsPartyReservation();
+	const int32 NumSlots = ReservationMembers.Num();
+	// Next in display order that we haven't asked yet and that had room when we searched
+	const FBYGSearchSnapshotRef Snapshot = SearchSnapshot;
+	for (const int32 RowIndex : Snapshot->VisibleRows)
+	{
+		const FBYGSearchResultRow& Row = Snapshot->Rows[RowIndex];
+		if (ReservationAttempts.Contains(Row.SearchIndex) || !SessionSearch->SearchResults.IsValidIndex(Row.SearchIndex))
+		{
+			continue;
+		}
+		// Private slots aren't in the row, the host will tell us
+		if (!bReservationPrivateSlots && Row.NumOpenPublicConnections < NumSlots)
+		{
+			continue;
+		}
+		if (bRefuseIncompatibleSessions && Row.Compatibility != EBYGCompatibility::Compatible)
+		{
+			continue;
+		}
+		if (RequestReservation(Row.SearchIndex))
+		{
+			return true;
+		}
+		// A single player can still try their luck with a host that has no beacon
+		if (!bIsParty)
+		{
+			DoJoinSession(Row.SearchIndex);
+			return true;
+		}
+		ReservationAttempts.AddUnique(Row.SearchIndex);
+	}
+	return false;
+}
+
+bool UBYGMultiplayerSubsystem::CanJoinResult(int32 Index) const
+{
+	if (!bRefuseIncompatibleSessions)
+	{
+		return true;
+	}
+	const EBYGCompatibility Compatibility = FBYGCompatibility::Check(SessionSearch->SearchResults[Index]);
+	if (Compatibility != EBYGCompatibility::Compatible)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Not joining session index %d: %s"), Index, FBYGCompatibility::GetName(Compatibility));
+		return false;
+	}
+	return true;
+}
+
+void UBYGMultiplayerSubsystem::InitNetCoordinate()
+{
+	FString Region = NetRegion;
+	FParse::Value(FCommandLine::Get(), TEXT("BYGNetRegion="), Region);
+	NetCoordinate = FBYGNetCoordinate();
+	bNetCoordinateChanged = false;
+	if (!Region.IsEmpty())
+	{
+		const FBYGNetRegion* Found = NetRegions.FindByPredicate([&Region](const FBYGNetRegion& Candidate) { return Candidate.Name == Region; });
+		if (Found)
+		{
+			NetCoordinate = FBYGNetCoordinate::FromRegion(*Found);
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Starting out at net region '%s' (%.0f, %.0f)"), *Region, NetCoordinate.X, NetCoordinate.Y);
+		}
+		else
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("Net region '%s' isn't one of the %d NetRegions"), *Region, NetRegions.Num());
+		}
+	}
+
+	// What we learned last time, unless the region is a better guess
+	if (!bLearnNetCoordinate || NetCoordinateSlot.IsEmpty() || !UGameplayStatics::DoesSaveGameExist(NetCoordinateSlot, 0))
+	{
+		return;
+	}
+	const UBYGNetCoordinateSave* SaveGame = Cast<UBYGNetCoordinateSave>(UGameplayStatics::LoadGameFromSlot(NetCoordinateSlot, 0));
+	if (!SaveGame)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Couldn't read the net coordinate in save slot '%s'"), *NetCoordinateSlot);
+		return;
+	}
+	if (SaveGame->Error < NetCoordinate.Error)
+	{
+		NetCoordinate.X = SaveGame->X;
+		NetCoordinate.Y = SaveGame->Y;
+		NetCoordinate.Height = SaveGame->Height;
+		NetCoordinate.Error = SaveGame->Error;
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Starting out at the saved net coordinate (%.0f, %.0f) +%.0fms, error %.2f"), NetCoordinate.X, NetCoordinate.Y, NetCoordinate.Height, NetCoordinate.Error);
+	}
+}
+
+void UBYGMultiplayerSubsystem::SaveNetCoordinate(bool bAsync)
+{
+	// Not worth keeping until it's good enough to estimate from
+	if (!bNetCoordinateChanged || NetCoordinateSlot.IsEmpty() || !NetCoordinate.IsValid())
+	{
+		return;
+	}
+	bNetCoordinateChanged = false;
+	LastNetCoordinateSaveTime = FPlatformTime::Seconds();
+
+	UBYGNetCoordinateSave* SaveGame = NewObject<UBYGNetCoordinateSave>();
+	SaveGame->X = NetCoordinate.X;
+	SaveGame->Y = NetCoordinate.Y;
+	SaveGame->Height = NetCoordinate.Height;
+	SaveGame->Error = NetCoordinate.Error;
+	if (bAsync)
+	{
+		UGameplayStatics::AsyncSaveGameToSlot(SaveGame, NetCoordinateSlot, 0);
 	}
 	else
 	{
-		UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to get session interface"));
+		UGameplayStatics::SaveGameToSlot(SaveGame, NetCoordinateSlot, 0);
 	}
 }
 
-void UBYGMultiplayerSubsystem::CancelHostingGame()
+int32 UBYGMultiplayerSubsystem::GetPingEstimate(const FOnlineSessionSearchResult& Result) const
 {
-	UE_LOG(LogBYGMultiplayer, Log, TEXT("Start cancel hosting"));
-	IOnlineSessionPtr SessionInterface = GetSession();
-	if (SessionInterface)
-	{
-		bIsEndingHosting = true;
-		DoEndSession(NAME_GameSession);
-	}
+	return FBYGNetCoordinate::GetPing(Result, GetEstimationCoordinate());
 }
 
-void UBYGMultiplayerSubsystem::OnCreateSessionComplete(FName SessionName, bool bWasSuccessful)
+void UBYGMultiplayerSubsystem::ObserveLatency(const FSessionSettings& HostSettings, float RttMs)
 {
-	UE_LOG(LogBYGMultiplayer, Log, TEXT("On create session '%s' complete: %s"), *SessionName.ToString(), bWasSuccessful ? TEXT("success") : TEXT("failure"));
-	IOnlineSessionPtr SessionInterface = GetSession();
-	if (SessionInterface.IsValid())
+	if (!BYGSessionKeys::NetCoordinate.IsSet(HostSettings))
 	{
-		SessionInterface->ClearOnCreateSessionCompleteDelegate_Handle(CreateCompleteDelegateHandle);
-		if (bWasSuccessful)
-		{
-			UE_LOG(LogBYGMultiplayer, Log, TEXT("Automatically starting session"));
-			StartCompleteDelegateHandle = SessionInterface->AddOnStartSessionCompleteDelegate_Handle(StartCompleteDelegate);
-			SessionInterface->StartSession(SessionName);
-		}
+		return;
 	}
-}
-
-void UBYGMultiplayerSubsystem::OnStartSessionComplete(FName SessionName, bool bWasSuccessful)
-{
-	UE_LOG(LogBYGMultiplayer, Log, TEXT("On start session '%s' complete: %s"), *SessionName.ToString(), bWasSuccessful ? TEXT("success") : TEXT("failure"));
-	if (bWasSuccessful)
+	const bool bWasValid = NetCoordinate.IsValid();
+	NetCoordinate.Observe(FBYGNetCoordinate::FromSettings(HostSettings), RttMs);
+	bNetCoordinateChanged = true;
+	if (!bWasValid && NetCoordinate.IsValid())
 	{
-		UE_LOG(LogBYGMultiplayer, Log, TEXT("Travelling to target map: '%s'"), *OnlineSessionSettings.TargetMapName.ToString());
-
-		IOnlineSessionPtr SessionInterface = GetSession();
-		if (ensure(SessionInterface.IsValid()))
-		{
-			SessionInterface->ClearOnStartSessionCompleteDelegate_Handle(StartCompleteDelegateHandle);
-		}
-		const FString Arguments = FString::Join(OnlineSessionSettings.MapArguments, TEXT("?"));
-		UGameplayStatics::OpenLevel(GetWorld(), OnlineSessionSettings.TargetMapName, OnlineSessionSettings.bTravelAbsolute, Arguments);
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Net coordinate settled at (%.0f, %.0f) +%.0fms, estimating pings from now on"), NetCoordinate.X, NetCoordinate.Y, NetCoordinate.Height);
+		SaveNetCoordinate(true);
+	}
+	// Searches observe many results at once, so only once a minute rather than every sample
+	else if (FPlatformTime::Seconds() - LastNetCoordinateSaveTime > 60.0)
+	{
+		SaveNetCoordinate(true);
 	}
 }
 
-void UBYGMultiplayerSubsystem::FindSessions()
+void UBYGMultiplayerSubsystem::TickNetCoordinate()
 {
-	UE_LOG(LogBYGMultiplayer, Log, TEXT("Finding sessions"));
-	IOnlineSessionPtr SessionInterface = GetSession();
-	if (SessionInterface.IsValid())
+	// A sample every few seconds is plenty, the connection's RTT is already an average
+	const double Now = FPlatformTime::Seconds();
+	if (!bLearnNetCoordinate || IsReplaying() || Now - LastNetCoordinateSampleTime < 10.0)
 	{
-		SessionSearch = MakeShareable<FOnlineSessionSearch>(new FOnlineSessionSearch());
-		if (SessionSearch.IsValid())
-		{
-			SessionSearch->bIsLanQuery = bFindLAN;
-			SessionSearch->MaxSearchResults = FindMaxResults;
-			SessionSearch->TimeoutInSeconds = FindTimeout;
-			// NOTE: THIS IS INCREDIBLY IMPORTANT
-			SessionSearch->QuerySettings.Set(SEARCH_PRESENCE, bFindViaPresence, EOnlineComparisonOp::Equals);
-			// NOTE ^
-			FindSessionsCompleteDelegateHandle = SessionInterface->AddOnFindSessionsCompleteDelegate_Handle(FindSessionsCompleteDelegate);
-			SessionInterface->FindSessions(0, SessionSearch.ToSharedRef());
-		}
-		else
-		{
-			UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to create new session search interface"));
-		}
+		return;
 	}
-	else
+	LastNetCoordinateSampleTime = Now;
+
+	UWorld* World = GetWorld();
+	const UNetDriver* NetDriver = World ? World->GetNetDriver() : nullptr;
+	const UNetConnection* Connection = NetDriver ? NetDriver->ServerConnection : nullptr;
+	const FBYGSessionSnapshotRef Snapshot = SessionSnapshot;
+	if (Connection && Connection->AvgLag > 0.0f && Snapshot->bHasSession && !Snapshot->bHosting)
 	{
-		UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to get session interface"));
+		ObserveLatency(Snapshot->Settings, Connection->AvgLag * 1000.0f);
 	}
 }
 
-void UBYGMultiplayerSubsystem::OnFindSessionsComplete(bool bWasSuccessful)
+void UBYGMultiplayerSubsystem::ProbeSearchResults()
 {
-	UE_LOG(LogBYGMultiplayer, Log, TEXT("On find session complete: %s"), bWasSuccessful ? TEXT("success") : TEXT("failure"));
-
-	IOnlineSessionPtr SessionInterface = GetSession();
-	if (SessionInterface.IsValid())
+	if (NetProbeCount <= 0 || IsReplaying() || !SessionSearch.IsValid())
 	{
-		if (SessionSearch.IsValid())
+		return;
+	}
+	const TArray<FOnlineSessionSearchResult>& Results = SessionSearch->SearchResults;
+	const FBYGNetCoordinate Local = GetEstimationCoordinate();
+	TArray<TPair<int32, int32>> Candidates;
+	for (int32 Index = 0; Index < Results.Num(); ++Index)
+	{
+		if (!FBYGNetCoordinate::HasMeasuredPing(Results[Index]))
 		{
-			UE_LOG(LogBYGMultiplayer, Log, TEXT("Found %d results"), SessionSearch->SearchResults.Num());
+			// Results we can't estimate yet go after the ones we can, in the order they came in
+			bool bEstimated = false;
+			const int32 Ping = FBYGNetCoordinate::GetPing(Results[Index], Local, &bEstimated);
+			Candidates.Emplace(Index, bEstimated ? Ping : MAX_int32);
 		}
 	}
-}
-
-void UBYGMultiplayerSubsystem::OnJoinSessionComplete(FName SessionName, EOnJoinSessionCompleteResult::Type Result)
-{
-	UE_LOG(LogBYGMultiplayer, Log, TEXT("On join session '%s' complete with result: %s"), *SessionName.ToString(), LexToString(Result));
-	IOnlineSessionPtr SessionInterface = GetSession();
-	SessionInterface->ClearOnJoinSessionCompleteDelegate_Handle(JoinCompleteDelegateHandle);
+	Algo::StableSortBy(Candidates, [](const TPair<int32, int32>& Candidate) { return Candidate.Value; });
 
-	if (Result == EOnJoinSessionCompleteResult::Success)
+	int32 NumProbed = 0;
+	for (const TPair<int32, int32>& Candidate : Candidates)
 	{
-		bIsJoinedSession = true;
-		FString ConnectInfo;
-		if (SessionInterface->GetResolvedConnectString(SessionName, ConnectInfo))
+		if (NumProbed >= NetProbeCount)
 		{
-			UE_LOG(LogBYGMultiplayer, Log, TEXT("Connect string: %s"), *ConnectInfo);
-			APlayerController* PC = GetGameInstance()->GetFirstLocalPlayerController(GetWorld());
-			UE_LOG(LogBYGMultiplayer, Log, TEXT("Travelling client"));
-			PC->ClientTravel(ConnectInfo, ETravelType::TRAVEL_Absolute);
+			break;
 		}
-		else
+		FString ConnectInfo;
+		FString Host;
+		if (!GetConnectString(Results[Candidate.Key], NAME_GamePort, ConnectInfo) || !ConnectInfo.Split(TEXT(":"), &Host, nullptr, ESearchCase::IgnoreCase, ESearchDir::FromEnd))
 		{
-			UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to get connect string"));
+			continue;
 		}
+		++NumProbed;
+		// Replies arrive on the game thread, possibly after we're gone or the search has been replaced
+		TWeakObjectPtr<UBYGMultiplayerSubsystem> WeakThis(this);
+		TWeakPtr<FOnlineSessionSearch> WeakSearch = SessionSearch;
+		const int32 Index = Candidate.Key;
+		FIcmp::IcmpEcho(Host, NetProbeTimeout, [WeakThis, WeakSearch, Index](FIcmpEchoResult Echo)
+		{
+			if (WeakThis.IsValid() && Echo.Status == EIcmpResponseStatus::Success)
+			{
+				WeakThis->OnProbeComplete(WeakSearch.Pin(), Index, Echo.Time * 1000.0f);
+			}
+		});
 	}
-	else
+	if (NumProbed > 0)
 	{
-		UE_LOG(LogBYGMultiplayer, Error, TEXT("Join session complete returned non-success! %s"), LexToString(Result));
-		bIsJoinedSession = false;
+		UE_LOG(LogBYGMultiplayer, Verbose, TEXT("Probing %d of %d results the backend didn't ping"), NumProbed, Candidates.Num());
 	}
 }
 
-void UBYGMultiplayerSubsystem::JoinSession(uint32 Index)
+void UBYGMultiplayerSubsystem::OnProbeComplete(const TSharedPtr<FOnlineSessionSearch>& Search, int32 Index, float RttMs)
 {
-	UE_LOG(LogBYGMultiplayer, Log, TEXT("Join session index '%d'"), Index);
-
-	if (!SessionSearch.IsValid())
+	if (!Search.IsValid() || Search != SessionSearch || !Search->SearchResults.IsValidIndex(Index) || RttMs <= 0.0f)
 	{
-		UE_LOG(LogBYGMultiplayer, Error, TEXT("Called join session but session search instance is invalid"));
 		return;
 	}
-	if (!SessionSearch->SearchResults.IsValidIndex(Index))
+	// Background processing may still be reading the results
+	WaitForSearchProcessing();
+	FOnlineSessionSearchResult& Result = Search->SearchResults[Index];
+	Result.PingInMs = FMath::Clamp(FMath::RoundToInt(RttMs), 1, MAX_QUERY_PING - 1);
+	if (bLearnNetCoordinate)
 	{
-		UE_LOG(LogBYGMultiplayer, Error, TEXT("Called join session with index %d but session search results only have %d entries. Invalid index."), Index, SessionSearch->SearchResults.Num());
+		ObserveLatency(Result.Session.SessionSettings.Settings, RttMs);
+	}
+	RefreshSearchSnapshot();
+}
+
+void UBYGMultiplayerSubsystem::DoJoinSession(int32 Index)
+{
+	// Only for the join that's about to start, not one that fails to
+	const bool bSkipTravel = bSkipJoinTravel;
+	bSkipJoinTravel = false;
+	TSharedPtr<const FUniqueNetId> PlayerId = CachedPlayerId;
+	if (!PlayerId.IsValid())
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Player ID is invalid"));
 		return;
 	}
 
-	IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(CurrentSubsystemName);
-	IOnlineIdentityPtr IdentityInterface = Subsystem->GetIdentityInterface();
-	TSharedPtr<const FUniqueNetId> PlayerId;
-	if (IdentityInterface.IsValid())
+	// Found by a multi-search on another backend, e.g. a LAN game while we're on Steam, or by LAN discovery. There's no
+	// session we can join for those, so connect straight to the host.
+	const FOnlineSessionSearchResult& SearchResult = SessionSearch->SearchResults[Index];
+	const FName ResultSubsystem = FBYGMultiSearch::GetResultSubsystem(SearchResult);
+	if (!ResultSubsystem.IsNone() && ResultSubsystem != CurrentSubsystemName && !IsReplaying())
 	{
-		PlayerId = IdentityInterface->GetUniquePlayerId(0);
+		FString ConnectInfo;
+		if (GetConnectString(SearchResult, NAME_GamePort, ConnectInfo))
+		{
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Result %d was found on %s, joining it directly"), Index, *ResultSubsystem.ToString());
+			if (JoinDirect(ConnectInfo))
+			{
+				ServerHistory.Remember(FBYGServerHistory::GetSessionId(SearchResult.Session), ConnectInfo, ResultSubsystem, SearchResult.Session.SessionSettings);
+			}
+		}
+		else
+		{
+			UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to get connect string for result %d from %s"), Index, *ResultSubsystem.ToString());
+		}
+		return;
 	}
+
 	IOnlineSessionPtr SessionInterface = GetSession();
 	if (SessionInterface.IsValid())
 	{
 		JoinCompleteDelegateHandle = SessionInterface->AddOnJoinSessionCompleteDelegate_Handle(JoinCompleteDelegate);
-		if (SessionInterface->JoinSession(*PlayerId, NAME_GameSession, SessionSearch->SearchResults[Index]))
+		const bool bStarted = SessionInterface->JoinSession(*PlayerId, NAME_GameSession, SearchResult);
+		Recorder.Record(EBYGSessionEventType::JoinSession, NAME_GameSession, bStarted, Index);
+		if (bStarted)
 		{
+			bSkipJoinTravel = bSkipTravel;
 			UE_LOG(LogBYGMultiplayer, Log, TEXT("Join session started"));
 		}
 		else
@@ -347,6 +1775,9 @@ void UBYGMultiplayerSubsystem::JoinSession(uint32 Index)
 
 IOnlineSessionPtr UBYGMultiplayerSubsystem::GetSession()
 {
+	// Replays must not leak into the real online subsystem
+	if (IsReplaying())
+		return IOnlineSessionPtr();
 	IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(CurrentSubsystemName);
 	if (Subsystem)
 		return Subsystem->GetSessionInterface();
@@ -359,22 +1790,189 @@ IOnlineSessionPtr UBYGMultiplayerSubsystem::GetSession()
 	*/
 }
 
+IOnlineSessionPtr UBYGMultiplayerSubsystem::GetSessionForResult(const FOnlineSessionSearchResult& Result)
+{
+	const FName ResultSubsystem = FBYGMultiSearch::GetResultSubsystem(Result);
+	if (ResultSubsystem.IsNone() || ResultSubsystem == CurrentSubsystemName || IsReplaying())
+	{
+		return GetSession();
+	}
+	// Not a real online subsystem
+	if (ResultSubsystem == FBYGLanDiscovery::SubsystemName)
+	{
+		return IOnlineSessionPtr();
+	}
+	IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(ResultSubsystem);
+	if (Subsystem)
+		return Subsystem->GetSessionInterface();
+	return IOnlineSessionPtr();
+}
+
+bool UBYGMultiplayerSubsystem::GetConnectString(const FOnlineSessionSearchResult& Result, FName PortType, FString& OutConnectInfo)
+{
+	// LAN discovery results carry the address they answered from
+	const FString HostAddress = BYGSessionKeys::HostAddress.Get(Result);
+	if (!HostAddress.IsEmpty())
+	{
+		const int32 Port = PortType == NAME_BeaconPort ? BYGSessionKeys::BeaconPort.Get(Result) : BYGSessionKeys::GamePort.Get(Result);
+		if (Port <= 0)
+		{
+			return false;
+		}
+		OutConnectInfo = FString::Printf(TEXT("%s:%d"), *HostAddress, Port);
+		return true;
+	}
+	IOnlineSessionPtr SessionInterface = GetSessionForResult(Result);
+	return SessionInterface.IsValid() && SessionInterface->GetResolvedConnectString(Result, PortType, OutConnectInfo);
+}
+
+IOnlineIdentityPtr UBYGMultiplayerSubsystem::GetIdentity() const
+{
+	if (IsReplaying())
+		return IOnlineIdentityPtr();
+	IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(CurrentSubsystemName);
+	if (Subsystem)
+		return Subsystem->GetIdentityInterface();
+	return IOnlineIdentityPtr();
+}
+
 UWorld* UBYGMultiplayerSubsystem::GetWorld() const
 {
 	return GetGameInstance()->GetWorld();
 }
 
 void UBYGMultiplayerSubsystem::HandleNetworkFailure(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString) {
+	Recorder.Record(EBYGSessionEventType::NetworkFailure, NAME_GameSession, false, (int32)FailureType, ErrorString);
+	TravelProfiler.Abort();
+	// Clean up the old session either way, the successor creates a new one
 	DoEndSession(NAME_GameSession);
+	if ((FailureType == ENetworkFailure::ConnectionLost || FailureType == ENetworkFailure::ConnectionTimeout) && HostMigration.OnNetworkFailure(World))
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Network failure '%s' handled by host migration"), *ErrorString);
+	}
 }
 
 void UBYGMultiplayerSubsystem::HandleTravelFailure(UWorld* InWorld, ETravelFailure::Type FailureType, const FString& ErrorString) {
+	Recorder.Record(EBYGSessionEventType::TravelFailure, NAME_GameSession, false, (int32)FailureType, ErrorString);
+	TravelProfiler.Abort();
 	DoEndSession(NAME_GameSession);
+	HostMigration.OnTravelFailure();
+}
+
+void UBYGMultiplayerSubsystem::StartRecording()
+{
+	if (IsReplaying())
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Can't record while replaying"));
+		return;
+	}
+	Recorder.Start();
+}
+
+FString UBYGMultiplayerSubsystem::StopRecording(const FString& Filename)
+{
+	Recorder.Stop();
+	const FString OutFilename = Filename.IsEmpty() ? FBYGSessionRecorder::GetDefaultFilename() : Filename;
+	return Recorder.SaveToFile(OutFilename) ? OutFilename : FString();
+}
+
+bool UBYGMultiplayerSubsystem::StartReplay(const FString& Filename, float Speed)
+{
+	TArray<FBYGSessionEvent> Events;
+	if (!FBYGSessionRecorder::LoadFromFile(Filename, Events))
+	{
+		return false;
+	}
+
+	Recorder.Stop();
+	ResetState();
+	Replayer.Start(MoveTemp(Events), Speed);
+	return true;
+}
+
+void UBYGMultiplayerSubsystem::StopReplay()
+{
+	if (Replayer.IsReplaying())
+	{
+		Replayer.Stop();
+		ResetState();
+	}
+}
+
+void UBYGMultiplayerSubsystem::ReplayEvent(const FBYGSessionEvent& Event)
+{
+	UE_LOG(LogBYGMultiplayer, Verbose, TEXT("Replaying %s at %.3f"), FBYGSessionEvent::GetTypeName(Event.Type), Event.Time);
+
+	// Calls only replay the state they changed, callbacks go through the real handlers
+	switch (Event.Type)
+	{
+	case EBYGSessionEventType::HostGame:
+		bIsHosting = Event.bWasSuccessful;
+		break;
+	case EBYGSessionEventType::CancelHosting:
+		bIsEndingHosting = true;
+		break;
+	case EBYGSessionEventType::FindSessions:
+		SessionSearch = SearchPool.Acquire();
+		SessionSearch->bIsLanQuery = Event.Value != 0;
+		SessionSearch->SearchState = Event.bWasSuccessful ? EOnlineAsyncTaskState::InProgress : EOnlineAsyncTaskState::Failed;
+		break;
+	case EBYGSessionEventType::JoinSession:
+		break;
+	case EBYGSessionEventType::LoginComplete:
+		LoginState = Event.bWasSuccessful ? EBYGLoginState::LoggedIn : EBYGLoginState::Failed;
+		CachedPlayerNickname = Event.bWasSuccessful ? Event.Message : FString();
+		// The recorded ID belongs to the real online subsystem, so stand one in for GetPlayerId()
+		CachedPlayerId.Reset();
+		if (Event.bWasSuccessful)
+		{
+			CachedPlayerId = FBYGSessionReplayer::MakeUniqueNetId(TEXT("Replay:") + Event.Message);
+		}
+		break;
+	case EBYGSessionEventType::CreateSessionComplete:
+		OnCreateSessionComplete(Event.SessionName, Event.bWasSuccessful);
+		break;
+	case EBYGSessionEventType::StartSessionComplete:
+		OnStartSessionComplete(Event.SessionName, Event.bWasSuccessful);
+		break;
+	case EBYGSessionEventType::FindSessionsComplete:
+	{
+		// Replace rather than refill, a background task may still be reading the previous results
+		TSharedPtr<FOnlineSessionSearch> PreviousSearch = SessionSearch;
+		SessionSearch = SearchPool.Acquire();
+		SessionSearch->bIsLanQuery = PreviousSearch.IsValid() && PreviousSearch->bIsLanQuery;
+		SessionSearch->SearchResults.Reserve(Event.SearchResults.Num());
+		for (const FBYGRecordedSearchResult& Result : Event.SearchResults)
+		{
+			SessionSearch->SearchResults.Add(Result.ToSearchResult());
+		}
+		SessionSearch->SearchState = Event.bWasSuccessful ? EOnlineAsyncTaskState::Done : EOnlineAsyncTaskState::Failed;
+		OnFindSessionsComplete(Event.bWasSuccessful);
+		break;
+	}
+	case EBYGSessionEventType::JoinSessionComplete:
+		OnJoinSessionComplete(Event.SessionName, (EOnJoinSessionCompleteResult::Type)Event.Value);
+		break;
+	case EBYGSessionEventType::EndSessionComplete:
+		OnEndSessionComplete(Event.SessionName, Event.bWasSuccessful);
+		break;
+	case EBYGSessionEventType::NetworkFailure:
+		HandleNetworkFailure(GetWorld(), nullptr, (ENetworkFailure::Type)Event.Value, Event.Message);
+		break;
+	case EBYGSessionEventType::TravelFailure:
+		HandleTravelFailure(GetWorld(), (ETravelFailure::Type)Event.Value, Event.Message);
+		break;
+	default:
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Unknown event type %d in replay"), (int32)Event.Type);
+		break;
+	}
 }
 
 #if WITH_IMGUI
 void UBYGMultiplayerSubsystem::DrawDebug(bool* bIsOpen)
 {
+	BYG_LLM_SCOPE();
+	EnsureInitialized();
 	if (UI)
 	{
 		UI->DrawDebug(bIsOpen);
@@ -383,32 +1981,34 @@ void UBYGMultiplayerSubsystem::DrawDebug(bool* bIsOpen)
 #endif
 
 
-#if 0
 void UBYGMultiplayerSubsystem::OnRegisterPlayersComplete(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& PlayerIDs, bool bWasSuccessful)
 {
 	UE_LOG(LogBYGMultiplayer, Log, TEXT("On register players complete: %d"), bWasSuccessful);
+	RefreshSessionSnapshot();
 }
 
 void UBYGMultiplayerSubsystem::OnUnregisterPlayersComplete(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& PlayerIDs, bool bWasSuccessful)
 {
 	UE_LOG(LogBYGMultiplayer, Log, TEXT("On unregister player complete"));
+	RefreshSessionSnapshot();
 }
-#endif
 
-#if 0
-// later
 void UBYGMultiplayerSubsystem::OnUpdateSessionComplete(FName SessionName, bool bWasSuccessful)
 {
 	UE_LOG(LogBYGMultiplayer, Log, TEXT("On update session complete"));
+	RefreshSessionSnapshot();
 }
-#endif
 
 void UBYGMultiplayerSubsystem::DoEndSession(FName SessionName) {
+	if (SessionName == NAME_GameSession)
+	{
+		StopReservationBeacon();
+	}
 	IOnlineSessionPtr SessionInterface = GetSession();
 	if (SessionInterface) {
 		EOnlineSessionState::Type state = SessionInterface->GetSessionState(SessionName);
 		if (state == EOnlineSessionState::InProgress) {
-			EndSessionCompleteDelegateHandle = SessionInterface->AddOnCreateSessionCompleteDelegate_Handle(EndSessionCompleteDelegate);
+			EndSessionCompleteDelegateHandle = SessionInterface->AddOnEndSessionCompleteDelegate_Handle(EndSessionCompleteDelegate);
 			SessionInterface->EndSession(SessionName);
 		} else {
 			SessionInterface->DestroySession(SessionName);
@@ -419,6 +2019,7 @@ void UBYGMultiplayerSubsystem::DoEndSession(FName SessionName) {
 void UBYGMultiplayerSubsystem::OnEndSessionComplete(FName SessionName, bool bWasSuccessful)
 {
 	UE_LOG(LogBYGMultiplayer, Log, TEXT("On end session complete"));
+	Recorder.Record(EBYGSessionEventType::EndSessionComplete, SessionName, bWasSuccessful);
 	bIsEndingHosting = false;
 	bIsHosting = false;
 
@@ -427,14 +2028,203 @@ void UBYGMultiplayerSubsystem::OnEndSessionComplete(FName SessionName, bool bWas
 		SessionInterface->ClearOnEndSessionCompleteDelegate_Handle(EndSessionCompleteDelegateHandle);
 		SessionInterface->DestroySession(SessionName);
 	}
+	RefreshSessionSnapshot();
 }
 
-#if 0
 void UBYGMultiplayerSubsystem::OnDestroySessionComplete(FName SessionName, bool bWasSuccessful)
 {
 	UE_LOG(LogBYGMultiplayer, Log, TEXT("On destroy session complete"));
+	// Sessions that never started are destroyed without going through OnEndSessionComplete
+	if (SessionName == NAME_GameSession && bIsEndingHosting)
+	{
+		bIsEndingHosting = false;
+		bIsHosting = false;
+	}
+	if (SessionName == NAME_GameSession)
+	{
+		RestoreNetProfile();
+	}
+	RefreshSessionSnapshot();
+	if (SessionName == NAME_GameSession)
+	{
+		HostMigration.OnSessionDestroyed();
+	}
+}
+
+void UBYGMultiplayerSubsystem::BindSessionNotifications()
+{
+	IOnlineSessionPtr SessionInterface = GetSession();
+	if (SessionInterface.IsValid())
+	{
+		SessionInterface->ClearOnUpdateSessionCompleteDelegate_Handle(UpdateSessionCompleteDelegateHandle);
+		SessionInterface->ClearOnDestroySessionCompleteDelegate_Handle(DestroySessionCompleteDelegateHandle);
+		SessionInterface->ClearOnRegisterPlayersCompleteDelegate_Handle(RegisterPlayersCompleteDelegateHandle);
+		SessionInterface->ClearOnUnregisterPlayersCompleteDelegate_Handle(UnregisterPlayersCompleteDelegateHandle);
+
+		UpdateSessionCompleteDelegateHandle = SessionInterface->AddOnUpdateSessionCompleteDelegate_Handle(FOnUpdateSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnUpdateSessionComplete));
+		DestroySessionCompleteDelegateHandle = SessionInterface->AddOnDestroySessionCompleteDelegate_Handle(FOnDestroySessionCompleteDelegate::CreateUObject(this, &ThisClass::OnDestroySessionComplete));
+		RegisterPlayersCompleteDelegateHandle = SessionInterface->AddOnRegisterPlayersCompleteDelegate_Handle(FOnRegisterPlayersCompleteDelegate::CreateUObject(this, &ThisClass::OnRegisterPlayersComplete));
+		UnregisterPlayersCompleteDelegateHandle = SessionInterface->AddOnUnregisterPlayersCompleteDelegate_Handle(FOnUnregisterPlayersCompleteDelegate::CreateUObject(this, &ThisClass::OnUnregisterPlayersComplete));
+	}
+	RefreshSessionSnapshot();
+}
+
+void UBYGMultiplayerSubsystem::RefreshSessionSnapshot()
+{
+	TSharedRef<FBYGSessionSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<FBYGSessionSnapshot, ESPMode::ThreadSafe>();
+	Snapshot->Version = SessionSnapshot->Version + 1;
+	Snapshot->SessionName = NAME_GameSession;
+
+	IOnlineSessionPtr SessionInterface = GetSession();
+	FNamedOnlineSession* Session = SessionInterface.IsValid() ? SessionInterface->GetNamedSession(NAME_GameSession) : nullptr;
+	if (SessionInterface.IsValid())
+	{
+		Snapshot->NumSessions = SessionInterface->GetNumSessions();
+	}
+	if (Session)
+	{
+		Snapshot->bHasSession = true;
+		Snapshot->SessionId.Set(Session->GetSessionIdStr());
+		Snapshot->bHosting = Session->bHosting;
+		Snapshot->State = Session->SessionState;
+		Snapshot->NumOpenPublicConnections = Session->NumOpenPublicConnections;
+		Snapshot->NumOpenPrivateConnections = Session->NumOpenPrivateConnections;
+		Snapshot->HostingPlayerNum = Session->HostingPlayerNum;
+		Snapshot->LocalOwnerId.Set(Session->LocalOwnerId.IsValid() ? Session->LocalOwnerId->ToString() : FString("null"));
+		Snapshot->NumPublicConnections = Session->SessionSettings.NumPublicConnections;
+		Snapshot->NumPrivateConnections = Session->SessionSettings.NumPrivateConnections;
+		Snapshot->bIsLANMatch = Session->SessionSettings.bIsLANMatch;
+		Snapshot->bIsDedicated = Session->SessionSettings.bIsDedicated;
+		Snapshot->Settings = Session->SessionSettings.Settings;
+		Snapshot->RegisteredPlayers.Reserve(Session->RegisteredPlayers.Num());
+		for (const TSharedRef<const FUniqueNetId>& RegisteredPlayer : Session->RegisteredPlayers)
+		{
+			Snapshot->RegisteredPlayers.Emplace(RegisteredPlayer->ToString());
+			if (CachedPlayerId.IsValid() && *RegisteredPlayer == *CachedPlayerId)
+			{
+				Snapshot->bLocalPlayerRegistered = true;
+			}
+		}
+	}
+	Snapshot->StateName.Set(FBYGSessionSnapshot::GetStateName(Snapshot->State));
+
+	SessionSnapshot = Snapshot;
+	SessionSnapshotBuffer.Publish(SessionSnapshot);
+	OnSessionSnapshotChanged.Broadcast(SessionSnapshot);
+}
+
+void UBYGMultiplayerSubsystem::RefreshSearchSnapshot()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UBYGMultiplayerSubsystem::RefreshSearchSnapshot);
+	BYG_LLM_SCOPE();
+
+	const uint32 Serial = ++SearchProcessingSerial;
+	const int32 NumResults = SessionSearch.IsValid() ? SessionSearch->SearchResults.Num() : 0;
+	const EOnlineAsyncTaskState::Type State = SessionSearch.IsValid() ? SessionSearch->SearchState : EOnlineAsyncTaskState::NotStarted;
+
+	// Results are still being written while a search is in progress, and small sets aren't worth the extra frame
+	if (NumResults < AsyncSearchProcessingThreshold || State == EOnlineAsyncTaskState::InProgress)
+	{
+		static const TArray<FOnlineSessionSearchResult> NoResults;
+		PublishSearchSnapshot(FBYGSearchSnapshot::Build(SessionSearch.IsValid() ? SessionSearch->SearchResults : NoResults, State, SearchFilter, GetEstimationCoordinate()), Serial);
+		return;
+	}
+
+	const TArray<FOnlineSessionSearchResult>* Results = &SessionSearch->SearchResults;
+	const FBYGSearchFilter Filter = SearchFilter;
+	const FBYGNetCoordinate Local = GetEstimationCoordinate();
+	TWeakObjectPtr<UBYGMultiplayerSubsystem> WeakThis(this);
+
+	FSearchProcessingTask& Processing = SearchProcessingTasks.AddDefaulted_GetRef();
+	Processing.Search = SessionSearch;
+	Processing.Task = FFunctionGraphTask::CreateAndDispatchWhenReady([Results, State, Filter, Local, WeakThis, Serial]()
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(BYGMultiplayer::ProcessSearchResults);
+		BYG_LLM_SCOPE();
+		TSharedRef<FBYGSearchSnapshot, ESPMode::ThreadSafe> Snapshot = FBYGSearchSnapshot::Build(*Results, State, Filter, Local);
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Snapshot, Serial]()
+		{
+			if (UBYGMultiplayerSubsystem* This = WeakThis.Get())
+			{
+				This->PublishSearchSnapshot(Snapshot, Serial);
+			}
+		});
+	}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void UBYGMultiplayerSubsystem::SetSearchFilter(const FBYGSearchFilter& InFilter)
+{
+	BYG_LLM_SCOPE();
+	SearchFilter = InFilter;
+
+	// Rows are already decoded, so re-filtering only has to copy them. Cheap enough to do inline for small sets.
+	const uint32 Serial = ++SearchProcessingSerial;
+	FBYGSearchSnapshotRef Current = SearchSnapshot;
+	if (Current->Rows.Num() < AsyncSearchProcessingThreshold)
+	{
+		TSharedRef<FBYGSearchSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<FBYGSearchSnapshot, ESPMode::ThreadSafe>(*Current);
+		Snapshot->ApplyFilter(SearchFilter);
+		PublishSearchSnapshot(Snapshot, Serial);
+		return;
+	}
+
+	const FBYGSearchFilter Filter = SearchFilter;
+	TWeakObjectPtr<UBYGMultiplayerSubsystem> WeakThis(this);
+	FSearchProcessingTask& Processing = SearchProcessingTasks.AddDefaulted_GetRef();
+	Processing.Task = FFunctionGraphTask::CreateAndDispatchWhenReady([Current, Filter, WeakThis, Serial]()
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(BYGMultiplayer::FilterSearchResults);
+		BYG_LLM_SCOPE();
+		TSharedRef<FBYGSearchSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<FBYGSearchSnapshot, ESPMode::ThreadSafe>(*Current);
+		Snapshot->ApplyFilter(Filter);
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Snapshot, Serial]()
+		{
+			if (UBYGMultiplayerSubsystem* This = WeakThis.Get())
+			{
+				This->PublishSearchSnapshot(Snapshot, Serial);
+			}
+		});
+	}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void UBYGMultiplayerSubsystem::PublishSearchSnapshot(const TSharedRef<FBYGSearchSnapshot, ESPMode::ThreadSafe>& Snapshot, uint32 Serial)
+{
+	check(IsInGameThread());
+	SearchProcessingTasks.RemoveAll([](const FSearchProcessingTask& Processing)
+	{
+		return Processing.Task->IsComplete();
+	});
+
+	if (Serial != SearchProcessingSerial)
+	{
+		UE_LOG(LogBYGMultiplayer, Verbose, TEXT("Dropping search results %u, superseded by %u"), Serial, SearchProcessingSerial);
+		return;
+	}
+
+	Snapshot->Version = SearchSnapshot->Version + 1;
+	SearchSnapshot = Snapshot;
+	SearchSnapshotBuffer.Publish(SearchSnapshot);
+
+	// The snapshot only changes when the results do, so this is as often as they need recounting
+	SearchMemoryBytes = Snapshot->GetAllocatedSize() + (SessionSearch.IsValid() ? FBYGSearchPool::GetAllocatedSize(*SessionSearch) : 0);
+	SET_DWORD_STAT(STAT_BYGMultiplayer_NumSearchResults, Snapshot->Rows.Num());
+	SET_MEMORY_STAT(STAT_BYGMultiplayer_SearchResultsMemory, SearchMemoryBytes);
+	if (Snapshot->State != EOnlineAsyncTaskState::InProgress && Snapshot->State != EOnlineAsyncTaskState::NotStarted)
+	{
+		OnSearchResultsReady.Broadcast(SearchSnapshot);
+	}
+}
+
+void UBYGMultiplayerSubsystem::WaitForSearchProcessing()
+{
+	for (const FSearchProcessingTask& Processing : SearchProcessingTasks)
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(Processing.Task);
+	}
+	SearchProcessingTasks.Reset();
+	// Anything they queued for the game thread is stale now
+	++SearchProcessingSerial;
 }
-#endif
 
 #if 0
 void UBYGMultiplayerSubsystem::OnPingSearchResultsComplete(bool bWasSuccessful)
@@ -460,14 +2250,9 @@ void UBYGMultiplayerSubsystem::OnCancelFindSessionsComplete(bool bWasSuccessful)
 
 FString UBYGMultiplayerSubsystem::GetPlayerNickname() const
 {
-	IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(CurrentSubsystemName);
-	if (Subsystem)
+	if (IsLoggedIn())
 	{
-		IOnlineIdentityPtr Identity = Subsystem->GetIdentityInterface();
-		if (Identity.IsValid())
-		{
-			return Identity->GetPlayerNickname(0);
-		}
+		return CachedPlayerNickname;
 	}
 	return "(Unknown)";
 }
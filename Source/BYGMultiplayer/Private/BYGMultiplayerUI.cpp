@@ -1,11 +1,18 @@
 ﻿// Copyright Brace Yourself Games. All Rights Reserved.
 
 #include "BYGMultiplayerUI.h"
-#include "imgui_helpers.h"
 #include "BYGMultiplayerSubsystem.h"
 #include "ImGuiCommon.h"
 #include "OnlineSubsystem.h"
+#include "Misc/PackageName.h"
+#if WITH_IMGUI
+#include "imgui_helpers.h"
+#endif
+#if WITH_BYG_STEAM
+#include "OnlineSubsystemSteam.h"
+#endif
 
+#if WITH_IMGUI
 void UBYGMultiplayerUI::Init()
 {
 	if (ensure(GEngine))
@@ -15,30 +22,13 @@ void UBYGMultiplayerUI::Init()
 	}
 }
 
-#if WITH_IMGUI
 void UBYGMultiplayerUI::ShowRegisterButton()
 {
-	IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(OnlineSubsystems[OnlineSubsystemIndex]);
-	if (!Subsystem)
-		return;
-	IOnlineIdentityPtr IdentityInterface = Subsystem->GetIdentityInterface();
-	if (IdentityInterface.IsValid())
-	{
-		TSharedPtr<const FUniqueNetId> PlayerId = IdentityInterface->GetUniquePlayerId(0);
-		IOnlineSessionPtr SessionInterface = GetMultiplayerSubsystem()->GetSession();
-		FNamedOnlineSession* FoundSession = SessionInterface->GetNamedSession(NAME_GameSession);
-		bool bIsRegistered = false;
-		if (FoundSession)
-		{
-			for (const TSharedRef<const FUniqueNetId>& RegisteredPlayer : FoundSession->RegisteredPlayers)
-			{
-				if (RegisteredPlayer->GetHexEncodedString() == PlayerId->GetHexEncodedString())
-				{
-					bIsRegistered = true;
-					break;
-				}
-			}
-		}
+	TSharedPtr<const FUniqueNetId> PlayerId = GetMultiplayerSubsystem()->GetPlayerId();
+	IOnlineSessionPtr SessionInterface = GetMultiplayerSubsystem()->GetSession();
+	if (PlayerId.IsValid() && SessionInterface.IsValid())
+	{
+		const bool bIsRegistered = GetMultiplayerSubsystem()->GetSessionSnapshot()->bLocalPlayerRegistered;
 
 		if (bIsRegistered)
 			ImGui::PushDisabled();
@@ -58,86 +48,396 @@ void UBYGMultiplayerUI::ShowRegisterButton()
 	}
 }
 
-void UBYGMultiplayerUI::ShowSessionInfo(FName SessionName)
+void UBYGMultiplayerUI::ShowSearchFilter()
 {
-	IOnlineSessionPtr SessionInterface = GetMultiplayerSubsystem()->GetSession();
-	if (SessionInterface.IsValid())
+	if (!ImGui::CollapsingHeader("Filter and Sort"))
 	{
-		FNamedOnlineSession* FoundSession = SessionInterface->GetNamedSession(SessionName);
-		if (FoundSession)
-		{
-			ImGui::PushDisabled();
-			FString SessionIdStr = FoundSession->GetSessionIdStr();
-			ImGui::InputText("Session ID", &SessionIdStr);
-			ImGui::Checkbox("Is host", &FoundSession->bHosting);
-			FString State;
-			switch (FoundSession->SessionState)
-			{
-			case EOnlineSessionState::NoSession:
-				State = "No session";
-				break;
-			case EOnlineSessionState::Creating:
-				State = "Creating";
-				break;
-			case EOnlineSessionState::Pending:
-				State = "Pending";
-				break;
-			case EOnlineSessionState::Starting:
-				State = "Starting";
-				break;
-			case EOnlineSessionState::InProgress:
-				State = "In progress";
-				break;
-			case EOnlineSessionState::Ending:
-				State = "Ending";
-				break;
-			case EOnlineSessionState::Ended:
-				State = "Ended";
-				break;
-			case EOnlineSessionState::Destroying:
-				State = "Destroying";
-				break;
-			}
-			ImGui::InputText("Session state", &State);
-			FString SessionNameStr = FoundSession->SessionName.ToString();
-			ImGui::InputText("Session name", &SessionNameStr);
-			ImGui::InputInt("Open public connections", &FoundSession->NumOpenPublicConnections);
-			ImGui::InputInt("Open private connections", &FoundSession->NumOpenPrivateConnections);
-			ImGui::InputInt("Hosting player num", &FoundSession->HostingPlayerNum);
-			FString LocalOwnerId = "null";
-			if (FoundSession->LocalOwnerId.IsValid())
-			{
-				LocalOwnerId = FoundSession->LocalOwnerId->ToString();
-			}
-			ImGui::InputText("Local owner ID", &LocalOwnerId);
+		return;
+	}
 
-			ImGui::PopDisabled();
+	FBYGSearchFilter Filter = GetMultiplayerSubsystem()->GetSearchFilter();
+	bool bChanged = false;
+	bChanged |= ImGui::Checkbox("Hide full", &Filter.bHideFull);
+	ImGui::SameLine();
+	bChanged |= ImGui::Checkbox("Hide empty", &Filter.bHideEmpty);
+	bChanged |= ImGui::InputInt("Max ping", &Filter.MaxPing);
+	ImGui::SameLine();
+	ImGui::HelpMarker("In milliseconds, 0 for no limit.");
+	if (ImGui::InputText("Server name", FilterServerName, IM_ARRAYSIZE(FilterServerName)))
+	{
+		Filter.ServerNameContains = ANSI_TO_TCHAR(FilterServerName);
+		bChanged = true;
+	}
+	ImGui::SameLine();
+	bChanged |= ImGui::Checkbox("Exact", &Filter.bExactServerName);
+	if (ImGui::InputText("Map", FilterMapName, IM_ARRAYSIZE(FilterMapName)))
+	{
+		Filter.MapName = ANSI_TO_TCHAR(FilterMapName);
+		bChanged = true;
+	}
+	bChanged |= ImGui::InputInt("Build ID", &Filter.BuildUniqueId);
+	ImGui::SameLine();
+	ImGui::HelpMarker("0 for any build.");
+	bChanged |= ImGui::Checkbox("Hide incompatible", &Filter.bHideIncompatible);
+	ImGui::SameLine();
+	ImGui::HelpMarker("Hosts on a different build, or with maps that don't match ours.");
+	const char* SortKeys[] = { "None", "Ping", "Players", "Server name", "Score" };
+	if (ImGui::Combo("Sort by", &FilterSortKey, SortKeys, IM_ARRAYSIZE(SortKeys)))
+	{
+		Filter.SortKey = (EBYGSearchSortKey)FilterSortKey;
+		bChanged = true;
+	}
+	ImGui::SameLine();
+	bChanged |= ImGui::Checkbox("Descending", &Filter.bSortDescending);
 
-			ImGui::PushStyleVar(ImGuiStyleVar_IndentSpacing, 0.0f);
-			ImGui::Columns(2, "HostColumns");
-			ImGui::Separator();
-			ImGui::Text("Index");
+	if (Filter.SortKey == EBYGSearchSortKey::Score)
+	{
+		bChanged |= ImGui::DragFloat("Ping weight", &Filter.PingWeight, 0.1f);
+		bChanged |= ImGui::DragFloat("Fill weight", &Filter.FillWeight, 1.0f);
+	}
+
+	if (bChanged)
+	{
+		GetMultiplayerSubsystem()->SetSearchFilter(Filter);
+	}
+
+	const FBYGSearchSnapshotRef Search = GetMultiplayerSubsystem()->GetSearchSnapshot();
+	ImGui::Text("Showing %d of %d results, filtered in %.1fus", Search->VisibleRows.Num(), Search->Rows.Num(), Search->FilterSeconds * 1000000.0);
+	ImGui::Text("Holding %.1fKB of results", GetMultiplayerSubsystem()->GetSearchMemoryBytes() / 1024.0);
+	const FBYGNetCoordinate& Coordinate = GetMultiplayerSubsystem()->GetNetCoordinate();
+	ImGui::Text("Net coordinate (%.0f, %.0f) +%.0fms, %.0f%% error%s", Coordinate.X, Coordinate.Y, Coordinate.Height, Coordinate.Error * 100.0f,
+		Coordinate.IsValid() ? "" : ", not estimating pings yet");
+}
+
+void UBYGMultiplayerUI::ShowSearchResultTooltip(const FBYGSearchResultRow& Row)
+{
+	// Only read the full result while someone is actually looking at it
+	UBYGMultiplayerSubsystem* Subsystem = GetMultiplayerSubsystem();
+	if (!Subsystem->SessionSearch.IsValid() || !Subsystem->SessionSearch->SearchResults.IsValidIndex(Row.SearchIndex))
+	{
+		return;
+	}
+	const FOnlineSessionSearchResult& Result = Subsystem->SessionSearch->SearchResults[Row.SearchIndex];
+	const FOnlineSessionSettings& Settings = Result.Session.SessionSettings;
+
+	ImGui::BeginTooltip();
+	ImGui::Text("Session Details");
+	ImGui::PushDisabled();
+	ImGui::Text("Open public connections: %d", Result.Session.NumOpenPublicConnections);
+	ImGui::Text("Open private connections: %d", Result.Session.NumOpenPrivateConnections);
+	ImGui::Text("Num public connections: %d", Settings.NumPublicConnections);
+	ImGui::Text("Num private connections: %d", Settings.NumPrivateConnections);
+	ImGui::Text("Is LAN match: %s", Settings.bIsLANMatch ? "true" : "false");
+	ImGui::Text("Is dedicated: %s", Settings.bIsDedicated ? "true" : "false");
+	ImGui::Text("Allow invites: %s", Settings.bAllowInvites ? "true" : "false");
+	ImGui::Text("Uses presence: %s", Settings.bUsesPresence ? "true" : "false");
+	ImGui::Text("Uses stats: %s", Settings.bUsesStats ? "true" : "false");
+	ImGui::Text("Anti cheat protected: %s", Settings.bAntiCheatProtected ? "true" : "false");
+	ImGui::Text("Allow join in progress: %s", Settings.bAllowJoinInProgress ? "true" : "false");
+	ImGui::Text("Allow join via presence: %s", Settings.bAllowJoinViaPresence ? "true" : "false");
+	ImGui::Text("Allow join via presence friends only: %s", Settings.bAllowJoinViaPresenceFriendsOnly ? "true" : "false");
+	ImGui::Text("Build unique ID: %d", Settings.BuildUniqueId);
+	ImGui::Text("Compatibility: %s", TCHAR_TO_ANSI(FBYGCompatibility::GetName(Row.Compatibility)));
+	ImGui::PopDisabled();
+	ImGui::Columns(2, "session custom settings");
+	ImGui::Separator();
+	ImGui::Text("Key");
+	ImGui::NextColumn();
+	ImGui::Text("Value");
+	ImGui::Separator();
+	ImGui::NextColumn();
+	for (const auto& Pair : Settings.Settings)
+	{
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(*Pair.Key.ToString()));
+		ImGui::NextColumn();
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(*Pair.Value.Data.ToString()));
+		ImGui::NextColumn();
+	}
+	ImGui::EndTooltip();
+}
+
+void UBYGMultiplayerUI::ShowSessionInfo(FName SessionName)
+{
+	const FBYGSessionSnapshotRef Snapshot = GetMultiplayerSubsystem()->GetSessionSnapshot();
+	if (Snapshot->bHasSession && Snapshot->SessionName == SessionName)
+	{
+		ImGui::LabelText("Session ID", "%s", Snapshot->SessionId.GetAnsi());
+		ImGui::LabelText("Is host", "%s", Snapshot->bHosting ? "true" : "false");
+		ImGui::LabelText("Session state", "%s", Snapshot->StateName.GetAnsi());
+		ImGui::LabelText("Session name", "%s", TCHAR_TO_ANSI(*SessionName.ToString()));
+		ImGui::LabelText("Open public connections", "%d", Snapshot->NumOpenPublicConnections);
+		ImGui::LabelText("Open private connections", "%d", Snapshot->NumOpenPrivateConnections);
+		ImGui::LabelText("Hosting player num", "%d", Snapshot->HostingPlayerNum);
+		ImGui::LabelText("Local owner ID", "%s", Snapshot->LocalOwnerId.GetAnsi());
+
+		ImGui::PushStyleVar(ImGuiStyleVar_IndentSpacing, 0.0f);
+		ImGui::Columns(2, "HostColumns");
+		ImGui::Separator();
+		ImGui::Text("Index");
+		ImGui::NextColumn();
+		ImGui::Text("User");
+		ImGui::NextColumn();
+		ImGui::Separator();
+		for (int32 j = 0; j < Snapshot->RegisteredPlayers.Num(); ++j)
+		{
+			ImGui::Text("%d", j);
 			ImGui::NextColumn();
-			ImGui::Text("User");
+			ImGui::TextUnformatted(Snapshot->RegisteredPlayers[j].GetAnsi());
 			ImGui::NextColumn();
-			ImGui::Separator();
-			for (int32 j = 0; j < FoundSession->RegisteredPlayers.Num(); ++j)
+		}
+		ImGui::Columns(1);
+		ImGui::PopStyleVar();
+	}
+	else
+	{
+		ImGui::PushDisabled();
+		ImGui::Text("No local session exists with ID '%s'. Try hosting or joining a game.", TCHAR_TO_ANSI(*SessionName.ToString()));
+		ImGui::PopDisabled();
+	}
+}
+
+void UBYGMultiplayerUI::ShowNetStats()
+{
+	UBYGMultiplayerSubsystem* Sys = GetMultiplayerSubsystem();
+	FBYGNetStatsSampler& NetStats = Sys->NetStats;
+
+	ImGui::Checkbox("Sample connections", &Sys->bNetStatsEnabled);
+	ImGui::SameLine();
+	ImGui::HelpMarker("Reads every connection of the current world's net driver. Clients have one connection (to the server), servers have one per client.");
+	ImGui::SliderFloat("Sample rate", &NetStats.SampleRate, 1.0f, 60.0f, "%.0f Hz");
+	if (ImGui::Button("Clear"))
+	{
+		NetStats.Reset();
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Export CSV"))
+	{
+		const FString Filename = NetStats.GetDefaultExportFilename();
+		LastNetStatsExport = NetStats.ExportCSV(Filename) ? Filename : FString("(Export failed)");
+	}
+	if (!LastNetStatsExport.IsEmpty())
+	{
+		ImGui::SameLine();
+		ImGui::TextDisabled(TCHAR_TO_ANSI(*LastNetStatsExport));
+	}
+
+	const TArray<FBYGConnectionNetStats>& Connections = NetStats.GetConnections();
+	if (Connections.Num() == 0)
+	{
+		ImGui::PushDisabled();
+		ImGui::TextCentered(Sys->bNetStatsEnabled ? "No connections" : "Sampling disabled");
+		ImGui::PopDisabled();
+		return;
+	}
+
+	for (int32 i = 0; i < Connections.Num(); ++i)
+	{
+		const FBYGConnectionNetStats& Stats = Connections[i];
+		ImGui::PushID(i);
+		const FString Header = FString::Printf(TEXT("%s %s%s###Connection"),
+			Stats.bIsServerConnection ? TEXT("Server") : TEXT("Client"),
+			*Stats.RemoteAddress,
+			Stats.bIsConnected ? TEXT("") : TEXT(" (disconnected)"));
+		if (ImGui::CollapsingHeader(TCHAR_TO_ANSI(*Header), ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			for (int32 Stat = 0; Stat < (int32)EBYGNetStat::Num; ++Stat)
 			{
-				ImGui::Text("%d", j);
-				ImGui::NextColumn();
-				ImGui::Text(TCHAR_TO_ANSI(*FoundSession->RegisteredPlayers[j]->ToString()));
-				ImGui::NextColumn();
+				const TBYGRingBuffer<float, FBYGConnectionNetStats::HistorySize>& Values = Stats.Stats[Stat];
+				const FString Overlay = FString::Printf(TEXT("%.1f (max %.1f)"), Values.GetLatest(), Values.GetMax());
+				ImGui::PlotLines(TCHAR_TO_ANSI(FBYGNetStatsSampler::GetStatName((EBYGNetStat)Stat)),
+					Values.GetData(), Values.Num(), Values.GetOffset(), TCHAR_TO_ANSI(*Overlay),
+					0.0f, FLT_MAX, ImVec2(0, 40.0f));
 			}
 		}
-		else
+		ImGui::PopID();
+	}
+}
+
+void UBYGMultiplayerUI::ShowRecording()
+{
+	UBYGMultiplayerSubsystem* Sys = GetMultiplayerSubsystem();
+
+	if (Sys->IsRecording())
+	{
+		if (ImGui::Button("Stop recording"))
 		{
+			LastRecordingFilename = Sys->StopRecording();
+			FCStringAnsi::Strncpy(ReplayFilename, TCHAR_TO_ANSI(*LastRecordingFilename), IM_ARRAYSIZE(ReplayFilename));
+		}
+	}
+	else
+	{
+		if (Sys->IsReplaying())
 			ImGui::PushDisabled();
-			ImGui::Text("No local session exists with ID '%s'. Try hosting or joining a game.", TCHAR_TO_ANSI(*FName(NAME_GameSession).ToString()));
+		if (ImGui::Button("Start recording"))
+		{
+			Sys->StartRecording();
+		}
+		if (Sys->IsReplaying())
 			ImGui::PopDisabled();
+	}
+	ImGui::SameLine();
+	ImGui::HelpMarker("Records subsystem calls and online subsystem callbacks, with their timing and search results. Saved to Saved/BYGMultiplayer.");
+	if (!LastRecordingFilename.IsEmpty())
+	{
+		ImGui::TextDisabled(TCHAR_TO_ANSI(*LastRecordingFilename));
+	}
+
+	ImGui::Separator();
+	ImGui::InputText("Recording", ReplayFilename, IM_ARRAYSIZE(ReplayFilename));
+	ImGui::SliderFloat("Replay speed", &ReplaySpeed, 0.0f, 16.0f, "%.1fx");
+	ImGui::SameLine();
+	ImGui::HelpMarker("0 replays every event as fast as possible");
+	if (Sys->IsReplaying())
+	{
+		const FBYGSessionReplayer& Replayer = Sys->GetReplayer();
+		ImGui::Text("Replaying event %d of %d", Replayer.GetNextEventIndex(), Replayer.GetNumEvents());
+		if (ImGui::Button("Stop replay"))
+		{
+			Sys->StopReplay();
+		}
+	}
+	else
+	{
+		if (ImGui::Button("Replay"))
+		{
+			Sys->StartReplay(ANSI_TO_TCHAR(ReplayFilename), ReplaySpeed);
+		}
+		if (Sys->GetReplayer().GetLastReplayDuration() > 0.0)
+		{
+			ImGui::SameLine();
+			ImGui::Text("Last replay took %.3fs", Sys->GetReplayer().GetLastReplayDuration());
 		}
 	}
 }
 
+void UBYGMultiplayerUI::ShowTravelProfiles()
+{
+	const FBYGTravelProfiler& Profiler = GetMultiplayerSubsystem()->TravelProfiler;
+	if (Profiler.IsProfiling())
+	{
+		ImGui::Text("Travelling: %s", TCHAR_TO_ANSI(FBYGTravelProfiler::GetPhaseName(Profiler.GetPhase())));
+	}
+	ImGui::TextDisabled(TCHAR_TO_ANSI(*FBYGTravelProfiler::GetHistoryFilename()));
+	ImGui::SameLine();
+	ImGui::HelpMarker("Milliseconds per phase, with the longest hitch in each in brackets.");
+
+	const int32 NumColumns = 3 + (int32)EBYGTravelPhase::Num;
+	ImGui::Columns(NumColumns, "travel profiles");
+	ImGui::Separator();
+	ImGui::Text("Map");
+	ImGui::NextColumn();
+	ImGui::Text("Reason");
+	ImGui::NextColumn();
+	ImGui::Text("Total");
+	ImGui::NextColumn();
+	for (int32 Phase = 0; Phase < (int32)EBYGTravelPhase::Num; ++Phase)
+	{
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(FBYGTravelProfiler::GetPhaseName((EBYGTravelPhase)Phase)));
+		ImGui::NextColumn();
+	}
+	ImGui::Separator();
+	// Newest first
+	const TArray<FBYGTravelProfile>& History = Profiler.GetHistory();
+	for (int32 i = History.Num() - 1; i >= 0; --i)
+	{
+		const FBYGTravelProfile& Profile = History[i];
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(*FPackageName::GetShortName(Profile.MapName)));
+		ImGui::NextColumn();
+		ImGui::Text("%s%s", TCHAR_TO_ANSI(*Profile.Reason), Profile.bCompleted ? "" : " (failed)");
+		ImGui::NextColumn();
+		ImGui::Text("%.0f", Profile.TotalSeconds * 1000.0);
+		ImGui::NextColumn();
+		for (int32 Phase = 0; Phase < (int32)EBYGTravelPhase::Num; ++Phase)
+		{
+			ImGui::Text("%.0f (%.0f)", Profile.PhaseSeconds[Phase] * 1000.0, Profile.PhaseHitchSeconds[Phase] * 1000.0);
+			ImGui::NextColumn();
+		}
+	}
+	ImGui::Columns(1);
+	ImGui::Separator();
+}
+
+void UBYGMultiplayerUI::ShowServerHistory()
+{
+	FBYGServerHistory& History = GetMultiplayerSubsystem()->ServerHistory;
+	if (History.IsRejoining())
+	{
+		ImGui::Text("Rejoining...");
+		ImGui::SameLine();
+		if (ImGui::Button("Cancel"))
+		{
+			History.CancelRejoin();
+		}
+	}
+
+	ImGui::Columns(4, "server history");
+	ImGui::Separator();
+	ImGui::Text("Server Name");
+	ImGui::NextColumn();
+	ImGui::Text("Map");
+	ImGui::NextColumn();
+	ImGui::Text("Last Joined");
+	ImGui::NextColumn();
+	ImGui::NextColumn();
+	ImGui::Separator();
+	// Acted on after the loop, all of them change the list
+	FString RejoinKey;
+	FString ForgetKey;
+	FString FavoriteKey;
+	bool bFavorite = false;
+	const TArray<FBYGKnownServer>& Servers = History.GetServers();
+	for (int32 i = 0; i < Servers.Num(); ++i)
+	{
+		const FBYGKnownServer& Server = Servers[i];
+		ImGui::PushID(i);
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(*(Server.ServerName.IsEmpty() ? Server.ConnectInfo : Server.ServerName)));
+		ImGui::NextColumn();
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(*Server.MapName));
+		ImGui::NextColumn();
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(*Server.LastJoined.ToString()));
+		ImGui::NextColumn();
+		bool bIsFavorite = Server.bFavorite;
+		if (ImGui::Checkbox("Favorite", &bIsFavorite))
+		{
+			FavoriteKey = Server.GetKey();
+			bFavorite = bIsFavorite;
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Rejoin"))
+		{
+			RejoinKey = Server.GetKey();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Forget"))
+		{
+			ForgetKey = Server.GetKey();
+		}
+		ImGui::NextColumn();
+		ImGui::PopID();
+	}
+	ImGui::Columns(1);
+	ImGui::Separator();
+
+	if (!FavoriteKey.IsEmpty())
+	{
+		History.SetFavorite(FavoriteKey, bFavorite);
+	}
+	if (!ForgetKey.IsEmpty())
+	{
+		History.Forget(ForgetKey);
+	}
+	if (!RejoinKey.IsEmpty())
+	{
+		GetMultiplayerSubsystem()->RejoinServer(RejoinKey);
+	}
+}
+
+int UBYGMultiplayerUI::GetTabFlags(const char* Label) const
+{
+	return ForcedTab && FCStringAnsi::Strcmp(ForcedTab, Label) == 0 ? ImGuiTabItemFlags_SetSelected : ImGuiTabItemFlags_None;
+}
+
 void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 {
 	
@@ -147,26 +447,34 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 		const bool bWasSuccess = GetMultiplayerSubsystem()->TryChangeOnlineSubsystem(FName(OnlineSubsystems[OnlineSubsystemIndex]));
 	}
 
-	{
-		IOnlineSessionPtr SessionInterface = GetMultiplayerSubsystem()->GetSession();
-		ImGui::Text("Current sessions: %d", SessionInterface->GetNumSessions());
-	}
+	ImGui::Text("Current sessions: %d", GetMultiplayerSubsystem()->GetSessionSnapshot()->NumSessions);
 
 	if (ImGui::BeginTabBar("MultiplayerTabBar"))
 	{
-		if (ImGui::BeginTabItem("Info"))
+		if (ImGui::BeginTabItem("Info", nullptr, GetTabFlags("Info")))
 		{
+			UBYGMultiplayerSubsystem* Sys = GetMultiplayerSubsystem();
+			ImGui::Text("Login: %s", TCHAR_TO_ANSI(UBYGMultiplayerSubsystem::GetLoginStateName(Sys->GetLoginState())));
+			if (Sys->GetLoginState() == EBYGLoginState::Failed)
+			{
+				ImGui::SameLine();
+				if (ImGui::Button("Retry login"))
+				{
+					Sys->Login();
+				}
+			}
+			ImGui::Text("ID:");
+			ImGui::SameLine();
+			// Names and ids come from the online service, so never use them as a format string
+			ImGui::TextUnformatted(Sys->GetPlayerId().IsValid() ? TCHAR_TO_ANSI(*Sys->GetPlayerId()->ToString()) : "(None)");
+			ImGui::Text("Display Name:");
+			ImGui::SameLine();
+			ImGui::TextUnformatted(TCHAR_TO_ANSI(*Sys->GetPlayerNickname()));
+
+#if WITH_BYG_STEAM
 			if (OnlineSubsystemIndex == STEAM_INDEX)
 			{
 				ImGui::Text("Steam information");
-				ImGui::PushDisabled();
-				ImGui::Checkbox("Is logged in?", &bIsLoggedIn);
-				ImGui::PopDisabled();
-				ImGui::Text("ID:");
-				ImGui::SameLine();
-				ImGui::Text("Display Name:");
-				ImGui::SameLine();
-				ImGui::Text(TCHAR_TO_ANSI(*PlayerNickname));
 
 				FOnlineSubsystemSteam* SubsystemSteam = (FOnlineSubsystemSteam*)IOnlineSubsystem::Get(OnlineSubsystems[OnlineSubsystemIndex]);
 				if (SubsystemSteam)
@@ -202,14 +510,25 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 				}
 			}
 			else
+#endif
 			{
 				ImGui::Text("Default LAN-only subsystem");
 			}
 
+			if (ImGui::CollapsingHeader("Record and Replay"))
+			{
+				ShowRecording();
+			}
+
+			if (ImGui::CollapsingHeader("Travel Profiles"))
+			{
+				ShowTravelProfiles();
+			}
+
 			ImGui::EndTabItem();
 		}
 
-		if (ImGui::BeginTabItem("Host"))
+		if (ImGui::BeginTabItem("Host", nullptr, GetTabFlags("Host")))
 		{
 			UBYGMultiplayerSubsystem* Sys = GetMultiplayerSubsystem();
 			
@@ -294,13 +613,12 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 
 				//ShowRegisterButton();
 
-				IOnlineSessionPtr SessionInterface = GetMultiplayerSubsystem()->GetSession();
-				FNamedOnlineSession* FoundSession = SessionInterface->GetNamedSession(NAME_GameSession);
-				if (FoundSession && FoundSession->SessionState == EOnlineSessionState::Pending)
+				const FBYGSessionSnapshotRef Snapshot = GetMultiplayerSubsystem()->GetSessionSnapshot();
+				if (Snapshot->bHasSession && Snapshot->State == EOnlineSessionState::Pending)
 				{
 					if (ImGui::Button("Start Session"))
 					{
-						SessionInterface->StartSession(NAME_GameSession);
+						GetMultiplayerSubsystem()->StartSession();
 					}
 					ImGui::SameLine();
 					ImGui::HelpMarker("We created the session, now it is in pending state. You need to manually Start the session to allow people to join");
@@ -316,9 +634,49 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 					ImGui::SameLine();
 					ImGui::HelpMarker("Question-mark separated arguments. No starting question-mark needed. Should include 'listen'");
 					ImGui::Checkbox("Travel absolute", &Sys->OnlineSessionSettings.bTravelAbsolute);
-					if (ImGui::Button("Server travel"))
+					const bool bIsTravelling = Sys->SeamlessTravel.IsTravelling() || Sys->StreamingLobby.IsTransitioning();
+					if (bIsTravelling)
+						ImGui::PushDisabled();
+					if (ImGui::Button("Travel to lobby"))
+					{
+						Sys->OnlineSessionSettings.LobbyMapName = LobbyMap;
+						Sys->OnlineSessionSettings.MapArguments = { MapArguments };
+						Sys->TravelToLobby();
+					}
+					ImGui::SameLine();
+					if (ImGui::Button("Travel to match"))
+					{
+						Sys->OnlineSessionSettings.MapArguments = { MapArguments };
+						Sys->TravelToMatch();
+					}
+					if (bIsTravelling)
+						ImGui::PopDisabled();
+					ImGui::SameLine();
+					ImGui::HelpMarker("Seamless travel, clients stay connected. The other map is preloaded while on either.");
+
+					if (Sys->StreamingLobby.IsEnabled())
 					{
-						World->ServerTravel(FString(LobbyMap) + "?" + FString(MapArguments), Sys->OnlineSessionSettings.bTravelAbsolute);
+						ImGui::Text("Streaming lobby: %s, %d of %d clients ready", TCHAR_TO_ANSI(FBYGStreamingLobby::GetStageName(Sys->StreamingLobby.GetStage())),
+							Sys->StreamingLobby.GetNumReady(), Sys->StreamingLobby.GetNumClients());
+						ImGui::Text("Last transition: %.0fms", Sys->StreamingLobby.GetLastTransitionSeconds() * 1000.0);
+					}
+
+					const FBYGTravelReport& Report = Sys->SeamlessTravel.GetLastReport();
+					if (!Report.MapName.IsEmpty())
+					{
+						ImGui::Text("Last travel to %s%s: %.0fms here, %.0fms total", TCHAR_TO_ANSI(*Report.MapName),
+							Report.bWasPreloaded ? " (preloaded)" : "", Report.LocalSeconds * 1000.0, Report.TotalSeconds * 1000.0);
+						for (const FBYGClientTravelTime& Client : Report.Clients)
+						{
+							if (Client.Seconds >= 0.0)
+							{
+								ImGui::BulletText("%s: %.0fms", TCHAR_TO_ANSI(*Client.PlayerName), Client.Seconds * 1000.0);
+							}
+							else
+							{
+								ImGui::BulletText("%s: never arrived", TCHAR_TO_ANSI(*Client.PlayerName));
+							}
+						}
 					}
 				}
 				else
@@ -341,6 +699,11 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 
 			if (bIsHosting)
 			{
+				const FBYGLanDiscovery& LanDiscovery = GetMultiplayerSubsystem()->LanDiscovery;
+				if (LanDiscovery.IsResponding())
+				{
+					ImGui::Text("LAN discovery on port %d, answered %d queries, dropped %d", LanDiscovery.GetHostPort(), LanDiscovery.GetNumQueriesAnswered(), LanDiscovery.GetNumQueriesDropped());
+				}
 				ImGui::Text("Current Hosted Session");
 
 				ShowSessionInfo(NAME_GameSession);
@@ -349,10 +712,16 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 			ImGui::EndTabItem();
 		}
 
-		if (ImGui::BeginTabItem("Join"))
+		if (ImGui::BeginTabItem("Join", nullptr, GetTabFlags("Join")))
 		{
 			ImGui::Text("Find and join games");
-			if (OnlineSubsystemIndex == STEAM_INDEX)
+			if (GetMultiplayerSubsystem()->SearchSources.Num() > 0)
+			{
+				ImGui::Text("Searching %d sources at once", GetMultiplayerSubsystem()->SearchSources.Num());
+				ImGui::SameLine();
+				ImGui::HelpMarker("Set by SearchSources in the config. LAN and presence options below are ignored.");
+			}
+			else if (OnlineSubsystemIndex == STEAM_INDEX)
 			{
 				bFindLAN = false;
 			}
@@ -376,20 +745,27 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 			{
 				GetMultiplayerSubsystem()->FindSessions();
 			}
+			if (ImGui::CollapsingHeader("Recent Servers"))
+			{
+				ShowServerHistory();
+			}
 
 			//ShowRegisterButton();
 
-			TArray<FOnlineSessionSearchResult> Results;
-			if (GetMultiplayerSubsystem()->SessionSearch.IsValid())
-				Results = GetMultiplayerSubsystem()->SessionSearch->SearchResults;
+			ShowSearchFilter();
+
+			// Decoded, filtered and sorted off the game thread, nothing to convert here
+			const FBYGSearchSnapshotRef Search = GetMultiplayerSubsystem()->GetSearchSnapshot();
 
 			ImGui::PushStyleVar(ImGuiStyleVar_IndentSpacing, 0.0f);
-			ImGui::Columns(6, "ResultsColumns");
+			ImGui::Columns(7, "ResultsColumns");
 			ImGui::Separator();
 			ImGui::Text("Server Name");
 			ImGui::Separator();
 			ImGui::Text("User");
 			ImGui::NextColumn();
+			ImGui::Text("Source");
+			ImGui::NextColumn();
 			ImGui::Text("Ping");
 			ImGui::NextColumn();
 			ImGui::Text("Players");
@@ -399,63 +775,42 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 			ImGui::Text("Join");
 			ImGui::NextColumn();
 			ImGui::Separator();
-			if (Results.Num() > 0)
+			if (Search->VisibleRows.Num() > 0)
 			{
-				for (int32 i = 0; i < Results.Num(); ++i)
+				for (const int32 RowIndex : Search->VisibleRows)
 				{
-					ImGui::PushID(i);
-					const FOnlineSessionSetting* ServerNameProp = Results[i].Session.SessionSettings.Settings.Find(SETTING_SERVER_NAME);
-					FString ServerName;
-					ServerNameProp->Data.GetValue(ServerName);
-					ImGui::Text(TCHAR_TO_ANSI(*ServerName));
+					const FBYGSearchResultRow& Row = Search->Rows[RowIndex];
+					ImGui::PushID(Row.SearchIndex);
+					ImGui::TextUnformatted(Row.ServerName.GetAnsi());
+					ImGui::NextColumn();
+					ImGui::TextUnformatted(Row.OwningUserName.GetAnsi());
 					ImGui::NextColumn();
-					ImGui::Text(TCHAR_TO_ANSI(*Results[i].Session.OwningUserName));
+					ImGui::TextUnformatted(Row.Source.GetAnsi());
 					ImGui::NextColumn();
-					ImGui::Text("%dms", Results[i].PingInMs);
+					// Estimated from where the host says it is, see BYGNetCoordinate.h
+					ImGui::Text(Row.bPingEstimated ? "~%dms" : "%dms", Row.PingInMs);
 					ImGui::NextColumn();
-					ImGui::Text("%d", Results[i].Session.SessionSettings.NumPublicConnections - Results[i].Session.NumOpenPublicConnections);
+					ImGui::Text("%d", Row.NumPlayers);
 					ImGui::NextColumn();
-					ImGui::Text("%d", Results[i].Session.SessionSettings.NumPublicConnections);
+					ImGui::Text("%d", Row.MaxPlayers);
 					ImGui::NextColumn();
-					if (ImGui::Button("Join Game"))
+					// JoinSession would refuse it, the tooltip says why
+					const bool bCanJoin = Row.Compatibility == EBYGCompatibility::Compatible || !GetMultiplayerSubsystem()->bRefuseIncompatibleSessions;
+					if (!bCanJoin)
 					{
-						GetMultiplayerSubsystem()->JoinSession(i);
+						ImGui::PushDisabled();
 					}
-					if (ImGui::IsItemHovered())
+					if (ImGui::Button(bCanJoin ? "Join Game" : "Incompatible"))
+					{
+						GetMultiplayerSubsystem()->JoinSession(Row.SearchIndex);
+					}
+					if (!bCanJoin)
 					{
-						ImGui::BeginTooltip();
-						ImGui::Text("Session Details");
-						ImGui::PushDisabled();
-						ImGui::InputInt("Open public connections", &Results[i].Session.NumOpenPublicConnections);
-						ImGui::InputInt("Open private connections", &Results[i].Session.NumOpenPrivateConnections);
-						ImGui::InputInt("Num public connections", &Results[i].Session.SessionSettings.NumPublicConnections);
-						ImGui::InputInt("Num private connections", &Results[i].Session.SessionSettings.NumPrivateConnections);
-						ImGui::Checkbox("Is LAN match", &Results[i].Session.SessionSettings.bIsLANMatch);
-						ImGui::Checkbox("Is dedicated", &Results[i].Session.SessionSettings.bIsDedicated);
-						ImGui::Checkbox("Allow invites", &Results[i].Session.SessionSettings.bAllowInvites);
-						ImGui::Checkbox("Uses presence", &Results[i].Session.SessionSettings.bUsesPresence);
-						ImGui::Checkbox("Uses stats", &Results[i].Session.SessionSettings.bUsesStats);
-						ImGui::Checkbox("Anti cheat protected", &Results[i].Session.SessionSettings.bAntiCheatProtected);
-						ImGui::Checkbox("Allow join in progress", &Results[i].Session.SessionSettings.bAllowJoinInProgress);
-						ImGui::Checkbox("Allow join via presence", &Results[i].Session.SessionSettings.bAllowJoinViaPresence);
-						ImGui::Checkbox("Allow join via presence friends only", &Results[i].Session.SessionSettings.bAllowJoinViaPresenceFriendsOnly);
-						ImGui::InputInt("Build unique ID", &Results[i].Session.SessionSettings.BuildUniqueId);
 						ImGui::PopDisabled();
-						ImGui::Columns(2, "session custom settings");
-						ImGui::Separator();
-						ImGui::Text("Key");
-						ImGui::NextColumn();
-						ImGui::Text("Value");
-						ImGui::Separator();
-						ImGui::NextColumn();
-						for (const auto& Pair : Results[i].Session.SessionSettings.Settings)
-						{
-							ImGui::Text(TCHAR_TO_ANSI(*Pair.Key.ToString()));
-							ImGui::NextColumn();
-							ImGui::Text(TCHAR_TO_ANSI(*Pair.Value.Data.ToString()));
-							ImGui::NextColumn();
-						}
-						ImGui::EndTooltip();
+					}
+					if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+					{
+						ShowSearchResultTooltip(Row);
 					}
 					ImGui::NextColumn();
 					ImGui::PopID();
@@ -465,27 +820,20 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 			{
 				ImGui::Columns(1);
 				ImGui::PushDisabled();
-				if (GetMultiplayerSubsystem()->SessionSearch.IsValid())
-				{
-					switch (GetMultiplayerSubsystem()->SessionSearch->SearchState)
-					{
-					case EOnlineAsyncTaskState::InProgress:
-						ImGui::TextCentered("In progress");
-						break;
-					case EOnlineAsyncTaskState::Failed:
-						ImGui::TextCentered("Failed");
-						break;
-					case EOnlineAsyncTaskState::NotStarted:
-						ImGui::TextCentered("Not started");
-						break;
-					case EOnlineAsyncTaskState::Done:
-						ImGui::TextCentered("Done");
-						break;
-					}
-				}
-				else
+				switch (Search->State)
 				{
+				case EOnlineAsyncTaskState::InProgress:
+					ImGui::TextCentered("In progress");
+					break;
+				case EOnlineAsyncTaskState::Failed:
+					ImGui::TextCentered("Failed");
+					break;
+				case EOnlineAsyncTaskState::Done:
+					ImGui::TextCentered(Search->Rows.Num() > 0 ? "All results filtered out" : "No results");
+					break;
+				default:
 					ImGui::TextCentered("No results");
+					break;
 				}
 				ImGui::PopDisabled();
 			}
@@ -498,6 +846,13 @@ void UBYGMultiplayerUI::DrawDebug(bool* bIsOpen)
 			ImGui::EndTabItem();
 		}
 
+		if (ImGui::BeginTabItem("Net Stats", nullptr, GetTabFlags("Net Stats")))
+		{
+			ShowNetStats();
+
+			ImGui::EndTabItem();
+		}
+
 		ImGui::EndTabBar();
 	}
 	ImGui::End();
@@ -510,9 +865,9 @@ void UBYGMultiplayerUI::HandleTravelFailure(UWorld* InWorld, ETravelFailure::Typ
 	if (ImGui::BeginPopupModal("Travel failure", NULL, ImGuiWindowFlags_AlwaysAutoResize))
 	{
 		ImGui::Text("Failed travelling with error message:");
-		ImGui::Text(TCHAR_TO_ANSI(*ErrorString));
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(*ErrorString));
 		ImGui::Text("Failure type:");
-		ImGui::Text(TCHAR_TO_ANSI(ETravelFailure::ToString(FailureType)));
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(ETravelFailure::ToString(FailureType)));
 		ImGui::Separator();
 		if (ImGui::Button("OK", ImVec2(120, 0))) { ImGui::CloseCurrentPopup(); }
 		ImGui::SetItemDefaultFocus();
@@ -525,9 +880,9 @@ void UBYGMultiplayerUI::HandleNetworkFailure(UWorld* World, UNetDriver* NetDrive
 	if (ImGui::BeginPopupModal("Network failure", NULL, ImGuiWindowFlags_AlwaysAutoResize))
 	{
 		ImGui::Text("Failed network with error message:");
-		ImGui::Text(TCHAR_TO_ANSI(*ErrorString));
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(*ErrorString));
 		ImGui::Text("Failure type:");
-		ImGui::Text(TCHAR_TO_ANSI(ENetworkFailure::ToString(FailureType)));
+		ImGui::TextUnformatted(TCHAR_TO_ANSI(ENetworkFailure::ToString(FailureType)));
 		ImGui::Separator();
 		if (ImGui::Button("OK", ImVec2(120, 0))) { ImGui::CloseCurrentPopup(); }
 		ImGui::SetItemDefaultFocus();
@@ -0,0 +1,124 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGNetCoordinate.h"
+#include "BYGSessionKeys.h"
+#include "OnlineSubsystemTypes.h"
+
+namespace BYGNetCoordinate
+{
+	// How far a single sample can move us, and how quickly our error follows the samples. From the Vivaldi paper.
+	static constexpr float PositionGain = 0.25f;
+	static constexpr float ErrorGain = 0.25f;
+	// How sure a configured region is
+	static constexpr float RegionError = 0.25f;
+	// Keeps two coordinates that are both sure of themselves from dividing by zero
+	static constexpr float MinError = 0.01f;
+	// Keeps a host and a client at the same spot from estimating 0ms
+	static constexpr float MinHeight = 1.0f;
+}
+
+float FBYGNetCoordinate::EstimateRTT(const FBYGNetCoordinate& Other) const
+{
+	return FMath::Sqrt(FMath::Square(X - Other.X) + FMath::Square(Y - Other.Y)) + Height + Other.Height;
+}
+
+void FBYGNetCoordinate::Observe(const FBYGNetCoordinate& Remote, float RttMs)
+{
+	if (RttMs <= 0.0f)
+	{
+		return;
+	}
+
+	const float Estimate = EstimateRTT(Remote);
+	// Trust the sample in proportion to how unsure we are compared to the remote
+	const float LocalError = FMath::Max(BYGNetCoordinate::MinError, Error);
+	const float Weight = LocalError / (LocalError + FMath::Max(BYGNetCoordinate::MinError, Remote.Error));
+	const float SampleError = FMath::Abs(Estimate - RttMs) / RttMs;
+	Error = FMath::Clamp(SampleError * BYGNetCoordinate::ErrorGain * Weight + Error * (1.0f - BYGNetCoordinate::ErrorGain * Weight), 0.0f, 1.0f);
+
+	// Pushed away from the remote if the estimate was too short, pulled towards it if too long. Heights always add
+	// to the distance, so they move together with it.
+	float DirX = X - Remote.X;
+	float DirY = Y - Remote.Y;
+	if (FMath::IsNearlyZero(DirX) && FMath::IsNearlyZero(DirY))
+	{
+		// No direction to move in yet, pick one
+		const float Angle = FMath::FRandRange(0.0f, 2.0f * PI);
+		DirX = FMath::Cos(Angle);
+		DirY = FMath::Sin(Angle);
+	}
+	const float Length = FMath::Sqrt(FMath::Square(DirX) + FMath::Square(DirY)) + Height + Remote.Height;
+	const float Force = BYGNetCoordinate::PositionGain * Weight * (RttMs - Estimate);
+	X += Force * DirX / Length;
+	Y += Force * DirY / Length;
+	Height = FMath::Max(BYGNetCoordinate::MinHeight, Height + Force * (Height + Remote.Height) / Length);
+}
+
+int32 FBYGNetCoordinate::Pack() const
+{
+	const uint32 PackedX = (uint32)FMath::Clamp(FMath::RoundToInt(X), -2047, 2047) & 0xFFF;
+	const uint32 PackedY = (uint32)FMath::Clamp(FMath::RoundToInt(Y), -2047, 2047) & 0xFFF;
+	const uint32 PackedHeight = (uint32)FMath::Clamp(FMath::RoundToInt(Height), 0, 255);
+	return (int32)((PackedX << 20) | (PackedY << 8) | PackedHeight);
+}
+
+FBYGNetCoordinate FBYGNetCoordinate::Unpack(int32 Packed)
+{
+	// Sign-extends the 12 bit fields
+	FBYGNetCoordinate Coordinate;
+	Coordinate.X = (float)(Packed >> 20);
+	Coordinate.Y = (float)(((int32)((uint32)Packed << 12)) >> 20);
+	Coordinate.Height = (float)(Packed & 0xFF);
+	return Coordinate;
+}
+
+FBYGNetCoordinate FBYGNetCoordinate::FromRegion(const FBYGNetRegion& Region)
+{
+	FBYGNetCoordinate Coordinate;
+	Coordinate.X = Region.X;
+	Coordinate.Y = Region.Y;
+	Coordinate.Height = FMath::Max(BYGNetCoordinate::MinHeight, Region.Height);
+	Coordinate.Error = BYGNetCoordinate::RegionError;
+	return Coordinate;
+}
+
+void FBYGNetCoordinate::Advertise(FOnlineSessionSettings& Settings) const
+{
+	BYGSessionKeys::NetCoordinate.Set(Settings, Pack());
+	BYGSessionKeys::NetCoordinateError.Set(Settings, Error);
+}
+
+FBYGNetCoordinate FBYGNetCoordinate::FromSettings(const FSessionSettings& Settings)
+{
+	FBYGNetCoordinate Coordinate = Unpack(BYGSessionKeys::NetCoordinate.Get(Settings));
+	Coordinate.Error = FMath::Clamp(BYGSessionKeys::NetCoordinateError.Get(Settings), 0.0f, 1.0f);
+	return Coordinate;
+}
+
+bool FBYGNetCoordinate::HasMeasuredPing(const FOnlineSessionSearchResult& Result)
+{
+	return Result.PingInMs > 0 && Result.PingInMs < MAX_QUERY_PING;
+}
+
+int32 FBYGNetCoordinate::GetPing(const FOnlineSessionSearchResult& Result, const FBYGNetCoordinate& Local, bool* bOutEstimated)
+{
+	if (bOutEstimated)
+	{
+		*bOutEstimated = false;
+	}
+	if (HasMeasuredPing(Result) || !Local.IsValid() || !BYGSessionKeys::NetCoordinate.IsSet(Result.Session.SessionSettings))
+	{
+		return Result.PingInMs;
+	}
+	// Hosts advertise their coordinate before it's any good, so they can be learned from
+	const FBYGNetCoordinate Remote = FromSettings(Result.Session.SessionSettings.Settings);
+	if (!Remote.IsValid())
+	{
+		return Result.PingInMs;
+	}
+	if (bOutEstimated)
+	{
+		*bOutEstimated = true;
+	}
+	return FMath::RoundToInt(Local.EstimateRTT(Remote));
+}
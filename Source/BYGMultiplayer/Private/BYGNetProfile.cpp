@@ -0,0 +1,116 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGNetProfile.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "Engine/NetDriver.h"
+#include "GameFramework/Actor.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+namespace BYGNetProfiles
+{
+	FBYGNetProfile Make(const TCHAR* Name, EBYGNetProfileServerType ServerType, int32 MaxPlayers, int32 ClientRate, int32 TickRate, float UpdateScale, float Timeout, float InitialTimeout)
+	{
+		FBYGNetProfile Profile;
+		Profile.Name = Name;
+		Profile.ServerType = ServerType;
+		Profile.MaxPlayers = MaxPlayers;
+		Profile.MaxClientRate = ClientRate;
+		Profile.MaxInternetClientRate = ClientRate;
+		Profile.NetServerMaxTickRate = TickRate;
+		Profile.NetUpdateFrequencyScale = UpdateScale;
+		Profile.ConnectionTimeout = Timeout;
+		Profile.InitialConnectTimeout = InitialTimeout;
+		return Profile;
+	}
+}
+
+bool FBYGNetProfile::Matches(int32 NumPlayers, bool bDedicated) const
+{
+	if (ServerType == EBYGNetProfileServerType::Listen && bDedicated)
+	{
+		return false;
+	}
+	if (ServerType == EBYGNetProfileServerType::Dedicated && !bDedicated)
+	{
+		return false;
+	}
+	return MaxPlayers <= 0 || NumPlayers <= MaxPlayers;
+}
+
+void FBYGNetProfile::ApplyToNetDriver(UNetDriver* NetDriver) const
+{
+	NetDriver->MaxClientRate = MaxClientRate;
+	NetDriver->MaxInternetClientRate = MaxInternetClientRate;
+#if ENGINE_MAJOR_VERSION > 5 || (ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1)
+	NetDriver->SetNetServerMaxTickRate(NetServerMaxTickRate);
+#else
+	NetDriver->NetServerMaxTickRate = NetServerMaxTickRate;
+#endif
+	NetDriver->ConnectionTimeout = ConnectionTimeout;
+	NetDriver->InitialConnectTimeout = InitialConnectTimeout;
+}
+
+void FBYGNetProfile::ApplyToActor(AActor* Actor, float NetUpdateFrequency, float MinNetUpdateFrequency) const
+{
+	SetActorFrequencies(Actor, NetUpdateFrequency * NetUpdateFrequencyScale, MinNetUpdateFrequency * NetUpdateFrequencyScale);
+}
+
+FBYGNetProfile FBYGNetProfile::FromNetDriver(const UNetDriver* NetDriver)
+{
+	FBYGNetProfile Profile;
+	Profile.MaxClientRate = NetDriver->MaxClientRate;
+	Profile.MaxInternetClientRate = NetDriver->MaxInternetClientRate;
+#if ENGINE_MAJOR_VERSION > 5 || (ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1)
+	Profile.NetServerMaxTickRate = NetDriver->GetNetServerMaxTickRate();
+#else
+	Profile.NetServerMaxTickRate = NetDriver->NetServerMaxTickRate;
+#endif
+	Profile.ConnectionTimeout = NetDriver->ConnectionTimeout;
+	Profile.InitialConnectTimeout = NetDriver->InitialConnectTimeout;
+	return Profile;
+}
+
+void FBYGNetProfile::GetActorFrequencies(const AActor* Actor, float& OutNetUpdateFrequency, float& OutMinNetUpdateFrequency)
+{
+#if ENGINE_MAJOR_VERSION > 5 || (ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 5)
+	OutNetUpdateFrequency = Actor->GetNetUpdateFrequency();
+	OutMinNetUpdateFrequency = Actor->GetMinNetUpdateFrequency();
+#else
+	OutNetUpdateFrequency = Actor->NetUpdateFrequency;
+	OutMinNetUpdateFrequency = Actor->MinNetUpdateFrequency;
+#endif
+}
+
+void FBYGNetProfile::SetActorFrequencies(AActor* Actor, float NetUpdateFrequency, float MinNetUpdateFrequency)
+{
+#if ENGINE_MAJOR_VERSION > 5 || (ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 5)
+	Actor->SetNetUpdateFrequency(NetUpdateFrequency);
+	Actor->SetMinNetUpdateFrequency(MinNetUpdateFrequency);
+#else
+	Actor->NetUpdateFrequency = NetUpdateFrequency;
+	Actor->MinNetUpdateFrequency = MinNetUpdateFrequency;
+#endif
+}
+
+const FBYGNetProfile* FBYGNetProfile::Select(const TArray<FBYGNetProfile>& Profiles, int32 NumPlayers, bool bDedicated)
+{
+	return Profiles.FindByPredicate([NumPlayers, bDedicated](const FBYGNetProfile& Profile)
+	{
+		return Profile.Matches(NumPlayers, bDedicated);
+	});
+}
+
+const TArray<FBYGNetProfile>& FBYGNetProfile::GetDefaults()
+{
+	using namespace BYGNetProfiles;
+	// Listen servers are also rendering, so they never get a high tick rate. Bigger sessions trade per-client
+	// bandwidth and update frequency to keep the server's total upload and replication cost in budget.
+	static const TArray<FBYGNetProfile> Defaults = {
+		Make(TEXT("ListenSmall"), EBYGNetProfileServerType::Listen, 8, 50000, 30, 1.0f, 30.0f, 60.0f),
+		Make(TEXT("ListenLarge"), EBYGNetProfileServerType::Listen, 0, 20000, 30, 0.5f, 60.0f, 90.0f),
+		Make(TEXT("DedicatedSmall"), EBYGNetProfileServerType::Dedicated, 16, 60000, 60, 1.0f, 30.0f, 60.0f),
+		Make(TEXT("DedicatedMedium"), EBYGNetProfileServerType::Dedicated, 32, 30000, 45, 0.75f, 45.0f, 60.0f),
+		Make(TEXT("DedicatedLarge"), EBYGNetProfileServerType::Dedicated, 0, 15000, 30, 0.5f, 60.0f, 120.0f),
+	};
+	return Defaults;
+}
@@ -0,0 +1,182 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGNetStats.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+void FBYGNetStatsSampler::Tick(UWorld* World, float DeltaTime)
+{
+	if (SampleRate <= 0.0f)
+	{
+		return;
+	}
+
+	TimeSinceSample += DeltaTime;
+	const float SampleInterval = 1.0f / SampleRate;
+	if (TimeSinceSample < SampleInterval)
+	{
+		return;
+	}
+	// Don't try to catch up after a hitch, one sample per tick is plenty
+	TimeSinceSample = FMath::Fmod(TimeSinceSample, SampleInterval);
+
+	UNetDriver* NetDriver = World ? World->GetNetDriver() : nullptr;
+	if (NetDriver)
+	{
+		SampleNetDriver(NetDriver);
+	}
+}
+
+void FBYGNetStatsSampler::Reset()
+{
+	Connections.Reset();
+	StartTime = 0.0;
+	TimeSinceSample = 0.0f;
+	NumSamples = 0;
+}
+
+void FBYGNetStatsSampler::SampleNetDriver(UNetDriver* NetDriver)
+{
+	if (NumSamples == 0)
+	{
+		StartTime = FPlatformTime::Seconds();
+	}
+
+	for (FBYGConnectionNetStats& Stats : Connections)
+	{
+		Stats.bIsConnected = false;
+	}
+
+	if (NetDriver->ServerConnection)
+	{
+		SampleConnection(NetDriver->ServerConnection, true);
+	}
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		if (Connection)
+		{
+			SampleConnection(Connection, false);
+		}
+	}
+
+	++NumSamples;
+}
+
+void FBYGNetStatsSampler::SampleConnection(UNetConnection* Connection, bool bIsServerConnection)
+{
+	FBYGConnectionNetStats* Stats = FindOrAddConnection(Connection, bIsServerConnection);
+	if (!Stats)
+	{
+		return;
+	}
+	Stats->bIsConnected = Connection->State != USOCK_Closed;
+
+	const float Saturation = Connection->CurrentNetSpeed > 0
+		? 100.0f * Connection->OutBytesPerSecond / Connection->CurrentNetSpeed
+		: 0.0f;
+
+	Stats->Timestamps.Push(FPlatformTime::Seconds() - StartTime);
+	Stats->Stats[(int32)EBYGNetStat::RTT].Push(Connection->AvgLag * 1000.0f);
+	Stats->Stats[(int32)EBYGNetStat::InPacketLoss].Push(Connection->GetInLossPercentage().GetAvgLossPercentage() * 100.0f);
+	Stats->Stats[(int32)EBYGNetStat::OutPacketLoss].Push(Connection->GetOutLossPercentage().GetAvgLossPercentage() * 100.0f);
+	Stats->Stats[(int32)EBYGNetStat::InBytesPerSecond].Push(Connection->InBytesPerSecond);
+	Stats->Stats[(int32)EBYGNetStat::OutBytesPerSecond].Push(Connection->OutBytesPerSecond);
+	Stats->Stats[(int32)EBYGNetStat::Saturation].Push(Saturation);
+	Stats->Stats[(int32)EBYGNetStat::QueuedBits].Push(Connection->QueuedBits);
+}
+
+FBYGConnectionNetStats* FBYGNetStatsSampler::FindOrAddConnection(UNetConnection* Connection, bool bIsServerConnection)
+{
+	for (FBYGConnectionNetStats& Stats : Connections)
+	{
+		if (Stats.Connection.Get() == Connection)
+		{
+			return &Stats;
+		}
+	}
+
+	if (Connections.Num() >= MaxTrackedConnections)
+	{
+		const int32 StaleIndex = Connections.IndexOfByPredicate([](const FBYGConnectionNetStats& Stats)
+		{
+			return !Stats.Connection.IsValid();
+		});
+		if (StaleIndex == INDEX_NONE)
+		{
+			return nullptr;
+		}
+		Connections.RemoveAt(StaleIndex);
+	}
+
+	FBYGConnectionNetStats& Stats = Connections.AddDefaulted_GetRef();
+	Stats.Connection = Connection;
+	Stats.RemoteAddress = Connection->LowLevelGetRemoteAddress(true);
+	Stats.bIsServerConnection = bIsServerConnection;
+	return &Stats;
+}
+
+bool FBYGNetStatsSampler::ExportCSV(const FString& Filename) const
+{
+	FString Output = TEXT("Connection,Time");
+	for (int32 Stat = 0; Stat < (int32)EBYGNetStat::Num; ++Stat)
+	{
+		Output += TEXT(",");
+		Output += GetStatName((EBYGNetStat)Stat);
+	}
+	Output += LINE_TERMINATOR;
+
+	for (const FBYGConnectionNetStats& Stats : Connections)
+	{
+		for (int32 i = 0; i < Stats.Timestamps.Num(); ++i)
+		{
+			Output += FString::Printf(TEXT("%s,%.3f"), *Stats.RemoteAddress, Stats.Timestamps.Get(i));
+			for (int32 Stat = 0; Stat < (int32)EBYGNetStat::Num; ++Stat)
+			{
+				Output += FString::Printf(TEXT(",%.2f"), Stats.Stats[Stat].Get(i));
+			}
+			Output += LINE_TERMINATOR;
+		}
+	}
+
+	if (!FFileHelper::SaveStringToFile(Output, *Filename))
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to write net stats to '%s'"), *Filename);
+		return false;
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Wrote net stats for %d connections to '%s'"), Connections.Num(), *Filename);
+	return true;
+}
+
+FString FBYGNetStatsSampler::GetDefaultExportFilename() const
+{
+	return FPaths::ProjectSavedDir() / TEXT("BYGMultiplayer") / FString::Printf(TEXT("NetStats-%s.csv"), *FDateTime::Now().ToString());
+}
+
+const TCHAR* FBYGNetStatsSampler::GetStatName(EBYGNetStat Stat)
+{
+	switch (Stat)
+	{
+	case EBYGNetStat::RTT:
+		return TEXT("RTT (ms)");
+	case EBYGNetStat::InPacketLoss:
+		return TEXT("In loss (%)");
+	case EBYGNetStat::OutPacketLoss:
+		return TEXT("Out loss (%)");
+	case EBYGNetStat::InBytesPerSecond:
+		return TEXT("In bytes/sec");
+	case EBYGNetStat::OutBytesPerSecond:
+		return TEXT("Out bytes/sec");
+	case EBYGNetStat::Saturation:
+		return TEXT("Saturation (%)");
+	case EBYGNetStat::QueuedBits:
+		return TEXT("Queued bits");
+	default:
+		return TEXT("Unknown");
+	}
+}
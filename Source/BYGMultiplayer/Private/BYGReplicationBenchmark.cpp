@@ -0,0 +1,174 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGReplicationBenchmark.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "Components/SceneComponent.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ReplicationGraph.h"
+
+CSV_DEFINE_CATEGORY(BYGReplicationBenchmark, true);
+
+ABYGReplicationBenchmarkActor::ABYGReplicationBenchmarkActor()
+{
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	RootComponent->SetMobility(EComponentMobility::Movable);
+	PrimaryActorTick.bCanEverTick = true;
+	bReplicates = true;
+	SetReplicatingMovement(true);
+}
+
+void ABYGReplicationBenchmarkActor::BeginPlay()
+{
+	Super::BeginPlay();
+	Center = GetActorLocation();
+	Angle = FMath::FRandRange(0.0f, 2.0f * PI);
+	// Only the server moves them, clients get the replicated movement
+	SetActorTickEnabled(HasAuthority());
+}
+
+void ABYGReplicationBenchmarkActor::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+	Angle = FMath::Fmod(Angle + Speed * DeltaSeconds, 2.0f * PI);
+	SetActorLocation(Center + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0f) * Radius);
+}
+
+namespace BYGReplicationBenchmark
+{
+	// The flush itself is timed by the engine's NetworkOutgoing CSV stat, which is scoped around the whole TickFlush
+	// broadcast. Timing it from our own TickFlushEvent handler would depend on running before the net driver's.
+	struct FMeasurement
+	{
+		TWeakObjectPtr<UWorld> World;
+		FDelegateHandle PostTickFlushHandle;
+		double EndTime = 0.0;
+		int32 NumFrames = 0;
+	};
+	static FMeasurement Measurement;
+
+	static int32 CountActors(UWorld* World)
+	{
+		int32 NumActors = 0;
+		for (TActorIterator<ABYGReplicationBenchmarkActor> It(World); It; ++It)
+		{
+			++NumActors;
+		}
+		return NumActors;
+	}
+
+	static const TCHAR* GetModeName(const UNetDriver* NetDriver)
+	{
+		return NetDriver && NetDriver->GetReplicationDriver() && NetDriver->GetReplicationDriver()->IsA<UReplicationGraph>() ? TEXT("replication graph") : TEXT("default replication");
+	}
+
+	static void StopMeasuring()
+	{
+		if (UWorld* World = Measurement.World.Get())
+		{
+			World->PostTickFlushEvent.Remove(Measurement.PostTickFlushHandle);
+#if CSV_PROFILER
+			FCsvProfiler::Get()->EndCapture();
+#endif
+
+			const UNetDriver* NetDriver = World->GetNetDriver();
+			UE_LOG(LogBYGMultiplayer, Display, TEXT("Replication benchmark: %d benchmark actors, %d connections, %s, %d frames. Compare NetworkOutgoing in the CSV profile under Saved/Profiling/CSV."),
+				CountActors(World), NetDriver ? NetDriver->ClientConnections.Num() : 0, GetModeName(NetDriver), Measurement.NumFrames);
+		}
+		Measurement = FMeasurement();
+	}
+
+	static void Spawn(const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World || World->GetNetMode() == NM_Client)
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("Spawn benchmark actors on the server"));
+			return;
+		}
+		const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		const float Extent = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 50000.0f;
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		for (int32 i = 0; i < Count; ++i)
+		{
+			const FVector Location(FMath::FRandRange(-Extent, Extent), FMath::FRandRange(-Extent, Extent), 0.0f);
+			World->SpawnActor<ABYGReplicationBenchmarkActor>(Location, FRotator::ZeroRotator, SpawnParams);
+		}
+		UE_LOG(LogBYGMultiplayer, Display, TEXT("Spawned %d replication benchmark actors within %.0f units"), Count, Extent);
+	}
+
+	static void Clear(const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+		int32 NumDestroyed = 0;
+		for (TActorIterator<ABYGReplicationBenchmarkActor> It(World); It; ++It)
+		{
+			It->Destroy();
+			++NumDestroyed;
+		}
+		UE_LOG(LogBYGMultiplayer, Display, TEXT("Destroyed %d replication benchmark actors"), NumDestroyed);
+	}
+
+	static void Measure(const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World || !World->GetNetDriver() || World->GetNetMode() == NM_Client)
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("Measure replication on a listen or dedicated server"));
+			return;
+		}
+		StopMeasuring();
+#if CSV_PROFILER
+		if (FCsvProfiler::Get()->IsCapturing())
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("A CSV profile is already being captured, stop it first"));
+			return;
+		}
+
+		const float Duration = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 10.0f;
+		const int32 NumActors = CountActors(World);
+		Measurement.World = World;
+		Measurement.EndTime = FPlatformTime::Seconds() + Duration;
+		CSV_METADATA(TEXT("BYGReplication"), GetModeName(World->GetNetDriver()));
+		CSV_METADATA(TEXT("BYGBenchmarkActors"), *LexToString(NumActors));
+		FCsvProfiler::Get()->BeginCapture();
+		Measurement.PostTickFlushHandle = World->PostTickFlushEvent.AddLambda([]()
+		{
+			// Per frame, so frames can be normalized by connection count
+			const UWorld* MeasuredWorld = Measurement.World.Get();
+			const UNetDriver* NetDriver = MeasuredWorld ? MeasuredWorld->GetNetDriver() : nullptr;
+			CSV_CUSTOM_STAT(BYGReplicationBenchmark, Connections, NetDriver ? NetDriver->ClientConnections.Num() : 0, ECsvCustomStatOp::Set);
+			++Measurement.NumFrames;
+			if (FPlatformTime::Seconds() >= Measurement.EndTime)
+			{
+				StopMeasuring();
+			}
+		});
+		UE_LOG(LogBYGMultiplayer, Display, TEXT("Capturing replication for %.1f seconds"), Duration);
+#else
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Measuring replication needs the CSV profiler, which this build doesn't have"));
+#endif
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs SpawnCommand(
+		TEXT("BYG.RepBenchmark.Spawn"),
+		TEXT("Spawn moving replicated actors. Args: <Count=1000> <Extent=50000>"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&Spawn));
+
+	static FAutoConsoleCommandWithWorldAndArgs ClearCommand(
+		TEXT("BYG.RepBenchmark.Clear"),
+		TEXT("Destroy all replication benchmark actors"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&Clear));
+
+	static FAutoConsoleCommandWithWorldAndArgs MeasureCommand(
+		TEXT("BYG.RepBenchmark.Measure"),
+		TEXT("Capture a CSV profile of the net driver's flush time per frame. Args: <Seconds=10>"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&Measure));
+}
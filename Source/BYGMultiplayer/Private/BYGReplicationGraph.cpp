@@ -0,0 +1,190 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGReplicationGraph.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "ReplicationGraphTypes.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/Actor.h"
+#include "UObject/UObjectIterator.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+void UBYGReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	// The graph works in frames and squared distances, so translate what every replicated class asks for
+	int32 NumClasses = 0;
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+		const AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject(false));
+		if (!ActorCDO || !ActorCDO->GetIsReplicated())
+		{
+			continue;
+		}
+		// Blueprint compilation leftovers
+		if (Class->GetName().StartsWith(TEXT("SKEL_")) || Class->GetName().StartsWith(TEXT("REINST_")))
+		{
+			continue;
+		}
+
+		FClassReplicationInfo ClassInfo;
+#if ENGINE_MAJOR_VERSION > 5 || (ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 5)
+		ClassInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(ActorCDO->GetNetUpdateFrequency());
+		const float CullDistanceSquared = ActorCDO->GetNetCullDistanceSquared();
+#else
+		ClassInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(ActorCDO->NetUpdateFrequency);
+		const float CullDistanceSquared = ActorCDO->NetCullDistanceSquared;
+#endif
+		// Routed to the always relevant nodes, distance doesn't matter
+		ClassInfo.SetCullDistanceSquared(ActorCDO->bAlwaysRelevant || ActorCDO->bOnlyRelevantToOwner ? 0.0f : CullDistanceSquared);
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+		++NumClasses;
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Replication graph set up %d replicated classes"), NumClasses);
+}
+
+void UBYGReplicationGraph::InitGlobalGraphNodes()
+{
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = CellSize;
+	GridNode->SpatialBias = SpatialBias;
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+void UBYGReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* Node = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(Node, RepGraphConnection);
+	AlwaysRelevantForConnection.Add({ RepGraphConnection->NetConnection, Node });
+}
+
+void UBYGReplicationGraph::RemoveClientConnection(UNetConnection* NetConnection)
+{
+	AlwaysRelevantForConnection.RemoveAllSwap([NetConnection](const FConnectionAlwaysRelevantNode& Entry)
+	{
+		return Entry.NetConnection == NetConnection;
+	});
+	// Their node goes with the connection, wait for them to get a new owner
+	for (auto It = OwnerOnlyActorConnections.CreateIterator(); It; ++It)
+	{
+		if (It.Value() == NetConnection)
+		{
+			ActorsWithoutNetConnection.Add(It.Key());
+			It.RemoveCurrent();
+		}
+	}
+	Super::RemoveClientConnection(NetConnection);
+}
+
+void UBYGReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	AActor* Actor = ActorInfo.Actor;
+	if (Actor->bAlwaysRelevant)
+	{
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+	}
+	else if (Actor->bOnlyRelevantToOwner)
+	{
+		// Picked up in ServerReplicateActors once it has an owning connection
+		ActorsWithoutNetConnection.Add(Actor);
+	}
+	else
+	{
+		// Treated as static while dormant, so sleeping actors cost nothing to keep in the grid
+		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+	}
+}
+
+void UBYGReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	AActor* Actor = ActorInfo.Actor;
+	if (Actor->bAlwaysRelevant)
+	{
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+	}
+	else if (Actor->bOnlyRelevantToOwner)
+	{
+		UNetConnection* NetConnection = nullptr;
+		if (ActorsWithoutNetConnection.RemoveSingleSwap(Actor) == 0 && OwnerOnlyActorConnections.RemoveAndCopyValue(Actor, NetConnection))
+		{
+			if (UReplicationGraphNode_AlwaysRelevant_ForConnection* Node = GetAlwaysRelevantNodeForConnection(NetConnection))
+			{
+				Node->NotifyRemoveNetworkActor(ActorInfo);
+			}
+		}
+	}
+	else
+	{
+		GridNode->RemoveActor_Dormancy(ActorInfo);
+	}
+}
+
+int32 UBYGReplicationGraph::ServerReplicateActors(float DeltaSeconds)
+{
+	// Owners can change after the actor was routed, e.g. a weapon picked up by another player. Without this it
+	// would keep replicating to its old owner and never to the new one.
+	for (auto It = OwnerOnlyActorConnections.CreateIterator(); It; ++It)
+	{
+		AActor* Actor = It.Key();
+		if (!IsValid(Actor))
+		{
+			continue;
+		}
+		UNetConnection* NetConnection = Actor->GetNetConnection();
+		if (NetConnection == It.Value())
+		{
+			continue;
+		}
+		const FNewReplicatedActorInfo ActorInfo(Actor);
+		if (UReplicationGraphNode_AlwaysRelevant_ForConnection* OldNode = GetAlwaysRelevantNodeForConnection(It.Value()))
+		{
+			OldNode->NotifyRemoveNetworkActor(ActorInfo);
+		}
+		if (UReplicationGraphNode_AlwaysRelevant_ForConnection* NewNode = GetAlwaysRelevantNodeForConnection(NetConnection))
+		{
+			NewNode->NotifyAddNetworkActor(ActorInfo);
+			It.Value() = NetConnection;
+		}
+		else
+		{
+			// Lost its owner, or the new one has no connection yet
+			ActorsWithoutNetConnection.Add(Actor);
+			It.RemoveCurrent();
+		}
+	}
+
+	for (int32 i = ActorsWithoutNetConnection.Num() - 1; i >= 0; --i)
+	{
+		AActor* Actor = ActorsWithoutNetConnection[i];
+		if (!IsValid(Actor))
+		{
+			ActorsWithoutNetConnection.RemoveAtSwap(i);
+			continue;
+		}
+		UNetConnection* NetConnection = Actor->GetNetConnection();
+		if (UReplicationGraphNode_AlwaysRelevant_ForConnection* Node = GetAlwaysRelevantNodeForConnection(NetConnection))
+		{
+			Node->NotifyAddNetworkActor(FNewReplicatedActorInfo(Actor));
+			OwnerOnlyActorConnections.Add(Actor, NetConnection);
+			ActorsWithoutNetConnection.RemoveAtSwap(i);
+		}
+	}
+
+	return Super::ServerReplicateActors(DeltaSeconds);
+}
+
+UReplicationGraphNode_AlwaysRelevant_ForConnection* UBYGReplicationGraph::GetAlwaysRelevantNodeForConnection(const UNetConnection* NetConnection) const
+{
+	if (!NetConnection)
+	{
+		return nullptr;
+	}
+	const FConnectionAlwaysRelevantNode* Entry = AlwaysRelevantForConnection.FindByKey(NetConnection);
+	return Entry ? Entry->Node : nullptr;
+}
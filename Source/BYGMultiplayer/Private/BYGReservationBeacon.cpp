@@ -0,0 +1,239 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGReservationBeacon.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/GameModeBase.h"
+#include "HAL/PlatformTime.h"
+#include "TimerManager.h"
+
+namespace BYGReservations
+{
+	// Anything bigger than this is not a party
+	static const int32 MaxPartySize = 64;
+}
+
+bool ABYGReservationBeaconClient::RequestReservation(const FString& ConnectInfo, const TArray<FUniqueNetIdRepl>& InMembers, bool bInPrivateSlots)
+{
+	Members = InMembers;
+	bPrivateSlots = bInPrivateSlots;
+	bResponded = false;
+
+	FURL URL(nullptr, *ConnectInfo, TRAVEL_Absolute);
+	if (!URL.Valid || !InitClient(URL))
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Could not connect to reservation beacon at '%s'"), *ConnectInfo);
+		return false;
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Requesting %d %s slots from %s"), Members.Num(), bPrivateSlots ? TEXT("private") : TEXT("public"), *ConnectInfo);
+	return true;
+}
+
+const TCHAR* ABYGReservationBeaconClient::GetResultName(EBYGReservationResult Result)
+{
+	switch (Result)
+	{
+	case EBYGReservationResult::Granted:
+		return TEXT("Granted");
+	case EBYGReservationResult::Full:
+		return TEXT("Full");
+	case EBYGReservationResult::Denied:
+		return TEXT("Denied");
+	case EBYGReservationResult::ConnectionFailed:
+		return TEXT("Connection failed");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
+void ABYGReservationBeaconClient::OnConnected()
+{
+	Super::OnConnected();
+	ServerRequestReservation(Members, bPrivateSlots);
+}
+
+void ABYGReservationBeaconClient::OnFailure()
+{
+	Super::OnFailure();
+	Respond(EBYGReservationResult::ConnectionFailed);
+}
+
+bool ABYGReservationBeaconClient::ServerRequestReservation_Validate(const TArray<FUniqueNetIdRepl>& RequestMembers, bool bRequestPrivateSlots)
+{
+	return RequestMembers.Num() > 0 && RequestMembers.Num() <= BYGReservations::MaxPartySize;
+}
+
+void ABYGReservationBeaconClient::ServerRequestReservation_Implementation(const TArray<FUniqueNetIdRepl>& RequestMembers, bool bRequestPrivateSlots)
+{
+	ABYGReservationBeaconHostObject* Host = Cast<ABYGReservationBeaconHostObject>(GetBeaconOwner());
+	// Who is asking comes from the beacon's join handshake, not from the request
+	UNetConnection* Connection = GetNetConnection();
+	const EBYGReservationResult Result = Host && Connection
+		? Host->ProcessReservationRequest(RequestMembers, bRequestPrivateSlots, Connection->PlayerId, Connection->LowLevelGetRemoteAddress(false))
+		: EBYGReservationResult::Denied;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Reservation for %s (%d players): %s"),
+		RequestMembers.Num() > 0 ? *RequestMembers[0].ToString() : TEXT("nobody"), RequestMembers.Num(), GetResultName(Result));
+	ClientReservationResponse(Result);
+}
+
+void ABYGReservationBeaconClient::ClientReservationResponse_Implementation(EBYGReservationResult Result)
+{
+	Respond(Result);
+}
+
+void ABYGReservationBeaconClient::Respond(EBYGReservationResult Result)
+{
+	if (bResponded)
+	{
+		return;
+	}
+	bResponded = true;
+	OnResponse.ExecuteIfBound(Result);
+
+	// We're done with the beacon either way, but not from inside its own RPC or failure handling
+	if (UWorld* World = GetWorld())
+	{
+		TWeakObjectPtr<ABYGReservationBeaconClient> WeakThis(this);
+		World->GetTimerManager().SetTimerForNextTick([WeakThis]()
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->DestroyBeacon();
+			}
+		});
+	}
+}
+
+ABYGReservationBeaconHostObject::ABYGReservationBeaconHostObject()
+{
+	ClientBeaconActorClass = ABYGReservationBeaconClient::StaticClass();
+	BeaconTypeName = ClientBeaconActorClass->GetName();
+}
+
+EBYGReservationResult ABYGReservationBeaconHostObject::ProcessReservationRequest(const TArray<FUniqueNetIdRepl>& Members, bool bPrivateSlots, const FUniqueNetIdRepl& RequesterId, const FString& RequesterAddress)
+{
+	if (Members.Num() == 0 || Members.ContainsByPredicate([](const FUniqueNetIdRepl& Member) { return !Member.IsValid(); }))
+	{
+		return EBYGReservationResult::Denied;
+	}
+	const FUniqueNetIdRepl& Leader = Members[0];
+	if (!RequesterId.IsValid() || Leader != RequesterId)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Refusing a reservation led by %s from %s, who is %s"), *Leader.ToString(), *RequesterAddress, *RequesterId.ToString());
+		return EBYGReservationResult::Denied;
+	}
+
+	PruneExpired();
+	// Asking again replaces the one they have, the party may have changed since
+	Reservations.RemoveAll([&Leader](const FReservation& Reservation)
+	{
+		return Reservation.Leader == Leader;
+	});
+
+	const int32 NumFromAddress = Reservations.FilterByPredicate([&RequesterAddress](const FReservation& Reservation)
+	{
+		return Reservation.Address == RequesterAddress;
+	}).Num();
+	if (MaxReservationsPerAddress > 0 && NumFromAddress >= MaxReservationsPerAddress)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Refusing a reservation from %s, which already holds %d"), *RequesterAddress, NumFromAddress);
+		return EBYGReservationResult::Denied;
+	}
+
+	// No public limit means anyone can come in, no private slots means nobody can have one
+	const bool bLimited = bPrivateSlots || MaxPublicSlots > 0;
+	if (bLimited && GetNumFreeSlots(bPrivateSlots) < Members.Num())
+	{
+		return EBYGReservationResult::Full;
+	}
+
+	FReservation& Reservation = Reservations.AddDefaulted_GetRef();
+	Reservation.Leader = Leader;
+	Reservation.Address = RequesterAddress;
+	Reservation.Members = Members;
+	Reservation.bPrivateSlots = bPrivateSlots;
+	Reservation.ExpireTime = FPlatformTime::Seconds() + ReservationLifetime;
+	return EBYGReservationResult::Granted;
+}
+
+bool ABYGReservationBeaconHostObject::CanLogin(const FUniqueNetIdRepl& PlayerId)
+{
+	PruneExpired();
+	return MaxPublicSlots <= 0 || FindReservation(PlayerId) != nullptr || GetNumFreeSlots(false) > 0;
+}
+
+void ABYGReservationBeaconHostObject::ConsumeReservation(const FUniqueNetIdRepl& PlayerId)
+{
+	FReservation* Reservation = FindReservation(PlayerId);
+	if (!Reservation)
+	{
+		return;
+	}
+	if (Reservation->bPrivateSlots)
+	{
+		PrivateSlotPlayers.AddUnique(PlayerId);
+	}
+	Reservation->Members.Remove(PlayerId);
+	Reservations.RemoveAll([](const FReservation& Each)
+	{
+		return Each.Members.Num() == 0;
+	});
+}
+
+void ABYGReservationBeaconHostObject::OnPlayerLeft(const FUniqueNetIdRepl& PlayerId)
+{
+	PrivateSlotPlayers.Remove(PlayerId);
+}
+
+int32 ABYGReservationBeaconHostObject::GetNumReservedSlots(bool bPrivateSlots) const
+{
+	int32 NumReserved = 0;
+	for (const FReservation& Reservation : Reservations)
+	{
+		if (Reservation.bPrivateSlots == bPrivateSlots)
+		{
+			NumReserved += Reservation.Members.Num();
+		}
+	}
+	return NumReserved;
+}
+
+int32 ABYGReservationBeaconHostObject::GetNumFreeSlots(bool bPrivateSlots) const
+{
+	const int32 NumPrivatePlayers = PrivateSlotPlayers.Num();
+	if (bPrivateSlots)
+	{
+		return MaxPrivateSlots - NumPrivatePlayers - GetNumReservedSlots(true);
+	}
+	return MaxPublicSlots - (GetNumPlayers() - NumPrivatePlayers) - GetNumReservedSlots(false);
+}
+
+void ABYGReservationBeaconHostObject::PruneExpired()
+{
+	const double Now = FPlatformTime::Seconds();
+	const int32 NumRemoved = Reservations.RemoveAll([Now](const FReservation& Reservation)
+	{
+		return Reservation.ExpireTime < Now;
+	});
+	if (NumRemoved > 0)
+	{
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("%d reservations expired without the player joining"), NumRemoved);
+	}
+}
+
+ABYGReservationBeaconHostObject::FReservation* ABYGReservationBeaconHostObject::FindReservation(const FUniqueNetIdRepl& PlayerId)
+{
+	return Reservations.FindByPredicate([&PlayerId](const FReservation& Reservation)
+	{
+		return Reservation.Members.Contains(PlayerId);
+	});
+}
+
+int32 ABYGReservationBeaconHostObject::GetNumPlayers() const
+{
+	const UWorld* World = GetWorld();
+	// GetNumPlayers() isn't const
+	AGameModeBase* GameMode = World ? World->GetAuthGameMode() : nullptr;
+	return GameMode ? GameMode->GetNumPlayers() : 0;
+}
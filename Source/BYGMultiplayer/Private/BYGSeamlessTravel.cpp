@@ -0,0 +1,285 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGSeamlessTravel.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "Engine/GameInstance.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+
+namespace BYGSeamlessTravel
+{
+	FString GetWorldShortName(const UWorld* World)
+	{
+		return FPackageName::GetShortName(UWorld::RemovePIEPrefix(World->GetOutermost()->GetName()));
+	}
+}
+
+void FBYGSeamlessTravel::Init(UBYGMultiplayerSubsystem* InSubsystem)
+{
+	Subsystem = InSubsystem;
+	ClientTimeout = Subsystem->TravelClientTimeout;
+	SeamlessTravelStartHandle = FWorldDelegates::OnSeamlessTravelStart.AddRaw(this, &FBYGSeamlessTravel::OnSeamlessTravelStart);
+}
+
+void FBYGSeamlessTravel::Deinit()
+{
+	FWorldDelegates::OnSeamlessTravelStart.Remove(SeamlessTravelStartHandle);
+	ReleasePreload();
+	Subsystem = nullptr;
+}
+
+UWorld* FBYGSeamlessTravel::GetWorld() const
+{
+	return Subsystem && Subsystem->GetGameInstance() ? Subsystem->GetGameInstance()->GetWorld() : nullptr;
+}
+
+bool FBYGSeamlessTravel::Travel(UWorld* World, const FString& MapName, const FString& Options, bool bAbsolute)
+{
+	if (!World || World->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Only the server can travel to '%s'"), *MapName);
+		return false;
+	}
+	if (bIsTravelling && !bWaitingForClients)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Already travelling, ignoring travel to '%s'"), *MapName);
+		return false;
+	}
+	// Still waiting on stragglers from the last one, report them as missing
+	if (bWaitingForClients)
+	{
+		Finish();
+	}
+
+	if (AGameModeBase* GameMode = World->GetAuthGameMode())
+	{
+		GameMode->bUseSeamlessTravel = true;
+	}
+	if (World->IsPlayInEditor())
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Seamless travel may not be supported in PIE, clients will probably reconnect"));
+	}
+
+	Start(MapName, true);
+	const FString URL = Options.IsEmpty() ? MapName : MapName + TEXT("?") + Options;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Seamless travel to %s%s"), *URL, PendingReport.bWasPreloaded ? TEXT(", already preloaded") : TEXT(""));
+	World->ServerTravel(URL, bAbsolute);
+	return true;
+}
+
+void FBYGSeamlessTravel::OnSeamlessTravelStart(UWorld* World, const FString& MapName)
+{
+	// Servers started it themselves in Travel()
+	if (!bIsTravelling && World && World == GetWorld())
+	{
+		Start(MapName, false);
+	}
+}
+
+void FBYGSeamlessTravel::Start(const FString& MapName, bool bIsServer)
+{
+	bIsTravelling = true;
+	bWaitingForClients = false;
+	TravelStartTime = FPlatformTime::Seconds();
+	DestinationShortName = FPackageName::GetShortName(MapName);
+	PendingClients.Reset();
+	PendingReport = FBYGTravelReport();
+	PendingReport.MapName = MapName;
+	PendingReport.bWasServer = bIsServer;
+	PendingReport.bWasPreloaded = IsPreloaded(MapName);
+}
+
+void FBYGSeamlessTravel::OnPostLoadMap(UWorld* World)
+{
+	Arrive(World);
+}
+
+void FBYGSeamlessTravel::Tick()
+{
+	if (!bIsTravelling)
+	{
+		return;
+	}
+	if (bWaitingForClients)
+	{
+		TickClients();
+		return;
+	}
+	// In case PostLoadMap isn't broadcast for the travel
+	UWorld* World = GetWorld();
+	if (World && !World->IsInSeamlessTravel())
+	{
+		Arrive(World);
+	}
+}
+
+void FBYGSeamlessTravel::Arrive(UWorld* World)
+{
+	if (!bIsTravelling || bWaitingForClients || !World || BYGSeamlessTravel::GetWorldShortName(World) != DestinationShortName)
+	{
+		return;
+	}
+
+	ArrivalTime = FPlatformTime::Seconds();
+	PendingReport.LocalSeconds = ArrivalTime - TravelStartTime;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Arrived on %s in %.0fms"), *DestinationShortName, PendingReport.LocalSeconds * 1000.0);
+
+	// The world holds on to it now
+	if (IsPreloaded(PendingReport.MapName))
+	{
+		ReleasePreload();
+	}
+
+	if (!PendingReport.bWasServer)
+	{
+		Finish();
+		return;
+	}
+
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PC = It->Get();
+		UNetConnection* Connection = PC ? PC->GetNetConnection() : nullptr;
+		if (Connection && !PC->IsLocalController())
+		{
+			FPendingClient& Client = PendingClients.AddDefaulted_GetRef();
+			Client.Connection = Connection;
+			Client.PlayerName = PC->PlayerState ? PC->PlayerState->GetPlayerName() : PC->GetName();
+		}
+	}
+	bWaitingForClients = true;
+	TickClients();
+}
+
+void FBYGSeamlessTravel::TickClients()
+{
+	const double Now = FPlatformTime::Seconds();
+	for (int32 i = PendingClients.Num() - 1; i >= 0; --i)
+	{
+		UNetConnection* Connection = PendingClients[i].Connection.Get();
+		// Null while the game mode swaps in a new controller
+		APlayerController* PC = Connection ? Connection->PlayerController : nullptr;
+		if (!Connection || Connection->State == USOCK_Closed)
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("%s left during travel"), *PendingClients[i].PlayerName);
+		}
+		else if (PC && PC->HasClientLoadedCurrentWorld())
+		{
+			FBYGClientTravelTime& Time = PendingReport.Clients.AddDefaulted_GetRef();
+			Time.PlayerName = PendingClients[i].PlayerName;
+			Time.Seconds = Now - TravelStartTime;
+		}
+		else
+		{
+			continue;
+		}
+		PendingClients.RemoveAtSwap(i);
+	}
+
+	if (PendingClients.Num() == 0 || Now - ArrivalTime > ClientTimeout)
+	{
+		Finish();
+	}
+}
+
+void FBYGSeamlessTravel::Finish()
+{
+	for (const FPendingClient& Client : PendingClients)
+	{
+		FBYGClientTravelTime& Time = PendingReport.Clients.AddDefaulted_GetRef();
+		Time.PlayerName = Client.PlayerName;
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("%s hadn't loaded %s after %.1f seconds"), *Client.PlayerName, *DestinationShortName, FPlatformTime::Seconds() - TravelStartTime);
+	}
+	PendingClients.Reset();
+
+	PendingReport.TotalSeconds = FPlatformTime::Seconds() - TravelStartTime;
+	for (const FBYGClientTravelTime& Time : PendingReport.Clients)
+	{
+		if (Time.Seconds >= 0.0)
+		{
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("  %s loaded %s in %.0fms"), *Time.PlayerName, *DestinationShortName, Time.Seconds * 1000.0);
+		}
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Travel to %s took %.0fms%s"), *DestinationShortName, PendingReport.TotalSeconds * 1000.0,
+		PendingReport.bWasServer ? *FString::Printf(TEXT(" including %d clients"), PendingReport.Clients.Num()) : TEXT(""));
+
+	bIsTravelling = false;
+	bWaitingForClients = false;
+	LastReport = MoveTemp(PendingReport);
+	PendingReport = FBYGTravelReport();
+	OnTravelComplete.Broadcast(LastReport);
+}
+
+void FBYGSeamlessTravel::Preload(const FString& MapName)
+{
+	const FString LongName = GetLongPackageName(MapName);
+	if (LongName.IsEmpty())
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Can't preload '%s', no such map"), *MapName);
+		return;
+	}
+	if (LongName == PreloadMapName)
+	{
+		return;
+	}
+
+	ReleasePreload();
+	PreloadMapName = LongName;
+	const int32 Serial = ++PreloadSerial;
+	const double StartTime = FPlatformTime::Seconds();
+	TWeakObjectPtr<UBYGMultiplayerSubsystem> WeakSubsystem(Subsystem);
+	LoadPackageAsync(LongName, FLoadPackageAsyncDelegate::CreateLambda([WeakSubsystem, Serial, StartTime](const FName& PackageName, UPackage* Package, EAsyncLoadingResult::Type Result)
+	{
+		if (!WeakSubsystem.IsValid())
+		{
+			return;
+		}
+		FBYGSeamlessTravel& Self = WeakSubsystem->SeamlessTravel;
+		if (Serial != Self.PreloadSerial)
+		{
+			return;
+		}
+		if (Result != EAsyncLoadingResult::Succeeded || !Package)
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("Failed to preload %s"), *PackageName.ToString());
+			Self.PreloadMapName.Reset();
+			return;
+		}
+		Self.PreloadedPackage.Reset(Package);
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Preloaded %s in %.0fms"), *PackageName.ToString(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}));
+}
+
+void FBYGSeamlessTravel::ReleasePreload()
+{
+	// Also drops a load that's still in flight
+	++PreloadSerial;
+	PreloadMapName.Reset();
+	PreloadedPackage.Reset();
+}
+
+bool FBYGSeamlessTravel::IsPreloaded(const FString& MapName) const
+{
+	return PreloadedPackage.IsValid() && FPackageName::GetShortName(PreloadMapName) == FPackageName::GetShortName(MapName);
+}
+
+FString FBYGSeamlessTravel::GetLongPackageName(const FString& MapName)
+{
+	if (FPackageName::IsValidLongPackageName(MapName))
+	{
+		return MapName;
+	}
+	// Hits the disk, but only once per preload
+	FString LongName;
+	if (FPackageName::SearchForPackageOnDisk(MapName, &LongName))
+	{
+		return LongName;
+	}
+	return FString();
+}
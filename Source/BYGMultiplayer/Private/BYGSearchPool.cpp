@@ -0,0 +1,108 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGSearchPool.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "BYGMultiplayerStats.h"
+#include "OnlineSessionSettings.h"
+
+TSharedRef<FOnlineSessionSearch> FBYGSearchPool::Acquire()
+{
+	BYG_LLM_SCOPE();
+
+	for (const TSharedRef<FOnlineSessionSearch>& Search : Searches)
+	{
+		// Only we hold it, so no online subsystem is writing to it and no task is reading it
+		if (Search.GetSharedReferenceCount() == 1)
+		{
+			const FOnlineSessionSearch Defaults;
+			// Reset rather than Empty, the allocations are what we're here to keep
+			Search->SearchResults.Reset();
+			Search->QuerySettings.SearchParams.Reset();
+			Search->SearchState = Defaults.SearchState;
+			Search->MaxSearchResults = Defaults.MaxSearchResults;
+			Search->bIsLanQuery = Defaults.bIsLanQuery;
+			Search->PingBucketSize = Defaults.PingBucketSize;
+			Search->PlatformHash = Defaults.PlatformHash;
+			Search->TimeoutInSeconds = Defaults.TimeoutInSeconds;
+			return Search;
+		}
+	}
+
+	TSharedRef<FOnlineSessionSearch> Search = MakeShared<FOnlineSessionSearch>();
+	if (Searches.Num() < MaxPooled)
+	{
+		Searches.Add(Search);
+	}
+	return Search;
+}
+
+void FBYGSearchPool::Empty()
+{
+	Searches.Empty();
+}
+
+int32 FBYGSearchPool::TrimResult(FOnlineSessionSearchResult& Result, int32 MaxSettingLength)
+{
+	if (MaxSettingLength <= 0)
+	{
+		return 0;
+	}
+
+	int32 NumDropped = 0;
+	for (FSessionSettings::TIterator It(Result.Session.SessionSettings.Settings); It; ++It)
+	{
+		const FVariantData& Data = It.Value().Data;
+		int32 Length = 0;
+		if (Data.GetType() == EOnlineKeyValuePairDataType::String)
+		{
+			FString Value;
+			Data.GetValue(Value);
+			Length = Value.Len();
+		}
+		else if (Data.GetType() == EOnlineKeyValuePairDataType::Blob)
+		{
+			TArray<uint8> Value;
+			Data.GetValue(Value);
+			Length = Value.Num();
+		}
+		if (Length > MaxSettingLength)
+		{
+			UE_LOG(LogBYGMultiplayer, Verbose, TEXT("Dropping %d long setting '%s' from session %s"), Length, *It.Key().ToString(), *Result.GetSessionIdStr());
+			It.RemoveCurrent();
+			++NumDropped;
+		}
+	}
+	return NumDropped;
+}
+
+SIZE_T FBYGSearchPool::GetAllocatedSize(const FOnlineSessionSearch& Search)
+{
+	SIZE_T Size = sizeof(FOnlineSessionSearch) + Search.SearchResults.GetAllocatedSize() + Search.QuerySettings.SearchParams.GetAllocatedSize();
+	// FVariantData only hands out copies, reused so strings don't allocate once the buffer fits the longest one
+	FString String;
+	TArray<uint8> Blob;
+	for (const FOnlineSessionSearchResult& Result : Search.SearchResults)
+	{
+		const FSessionSettings& Settings = Result.Session.SessionSettings.Settings;
+		Size += Settings.GetAllocatedSize() + Result.Session.OwningUserName.GetAllocatedSize();
+		for (const TPair<FName, FOnlineSessionSetting>& Pair : Settings)
+		{
+			// Strings and blobs are the only settings stored outside the map
+			switch (Pair.Value.Data.GetType())
+			{
+			case EOnlineKeyValuePairDataType::String:
+				Pair.Value.Data.GetValue(String);
+				Size += (String.Len() + 1) * sizeof(TCHAR);
+				break;
+			case EOnlineKeyValuePairDataType::Blob:
+				Blob.Reset();
+				Pair.Value.Data.GetValue(Blob);
+				Size += Blob.Num();
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	return Size;
+}
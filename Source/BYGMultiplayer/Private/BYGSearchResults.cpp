@@ -0,0 +1,276 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGSearchResults.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "BYGMultiplayerStats.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Crc.h"
+
+namespace BYGSearchResults
+{
+	// Below this it's not worth waking up other workers
+	static const int32 ParallelDecodeBatchSize = 256;
+}
+
+FBYGSearchResultRow FBYGSearchResultRow::FromSearchResult(int32 SearchIndex, const FOnlineSessionSearchResult& Result, const FBYGNetCoordinate& LocalCoordinate)
+{
+	const FOnlineSessionSettings& Settings = Result.Session.SessionSettings;
+
+	FBYGSearchResultRow Row;
+	Row.SearchIndex = SearchIndex;
+	Row.SessionId.Set(Result.GetSessionIdStr());
+	Row.OwningUserName.Set(Result.Session.OwningUserName);
+	Row.PingInMs = FBYGNetCoordinate::GetPing(Result, LocalCoordinate, &Row.bPingEstimated);
+	Row.MaxPlayers = Settings.NumPublicConnections;
+	Row.NumOpenPublicConnections = Result.Session.NumOpenPublicConnections;
+	Row.NumPlayers = Settings.NumPublicConnections - Result.Session.NumOpenPublicConnections;
+	Row.BuildUniqueId = BYGSessionKeys::BuildId.IsSet(Settings) ? BYGSessionKeys::BuildId.Get(Settings) : Settings.BuildUniqueId;
+	Row.bIsLANMatch = Settings.bIsLANMatch;
+	Row.bIsDedicated = Settings.bIsDedicated;
+
+	// Either of these may be missing if the host isn't running this plugin
+	Row.ServerName.Set(BYGSessionKeys::ServerName.Get(Settings));
+	Row.MapName.Set(BYGSessionKeys::MapName.Get(Settings));
+	Row.Source.Set(BYGSessionKeys::SearchSource.Get(Settings));
+	Row.Compatibility = FBYGCompatibility::Check(Result);
+
+	return Row;
+}
+
+SIZE_T FBYGSearchResultRow::GetAllocatedSize() const
+{
+	return SessionId.GetAllocatedSize() + ServerName.GetAllocatedSize() + MapName.GetAllocatedSize()
+		+ OwningUserName.GetAllocatedSize() + Source.GetAllocatedSize();
+}
+
+void FBYGSearchIndex::Build(const TArray<FBYGSearchResultRow>& Rows)
+{
+	const int32 NumRows = Rows.Num();
+	Ping.SetNumUninitialized(NumRows);
+	OpenSlots.SetNumUninitialized(NumRows);
+	MaxSlots.SetNumUninitialized(NumRows);
+	BuildId.SetNumUninitialized(NumRows);
+	MapId.SetNumUninitialized(NumRows);
+	NameHash.SetNumUninitialized(NumRows);
+	Compatible.SetNumUninitialized(NumRows);
+	MapNames.Reset();
+
+	// Almost every result is on one of a handful of maps
+	TMap<FString, int32> MapIds;
+	for (int32 i = 0; i < NumRows; ++i)
+	{
+		const FBYGSearchResultRow& Row = Rows[i];
+		Ping[i] = Row.PingInMs;
+		OpenSlots[i] = Row.NumOpenPublicConnections;
+		MaxSlots[i] = Row.MaxPlayers;
+		BuildId[i] = Row.BuildUniqueId;
+		NameHash[i] = HashServerName(Row.ServerName.ToString());
+		Compatible[i] = Row.Compatibility == EBYGCompatibility::Compatible;
+
+		const FString& MapName = Row.MapName.ToString();
+		int32* ExistingId = MapIds.Find(MapName);
+		if (ExistingId)
+		{
+			MapId[i] = *ExistingId;
+		}
+		else
+		{
+			MapId[i] = MapNames.Add(MapName);
+			MapIds.Add(MapName, MapId[i]);
+		}
+	}
+}
+
+int32 FBYGSearchIndex::FindMapId(const FString& MapName) const
+{
+	return MapNames.IndexOfByPredicate([&MapName](const FString& Name)
+	{
+		return Name.Equals(MapName, ESearchCase::IgnoreCase);
+	});
+}
+
+void FBYGSearchIndex::Filter(const FBYGSearchFilter& InFilter, TArray<uint8>& OutMask) const
+{
+	const int32 NumRows = Num();
+	OutMask.SetNumUninitialized(NumRows);
+
+	// Turn every option into a bound or a wildcard up front so the loop has no branches
+	const int32 MaxPing = InFilter.MaxPing > 0 ? InFilter.MaxPing : MAX_int32;
+	const int32 MinOpen = InFilter.bHideFull ? 1 : MIN_int32;
+	const int32 MinPlayers = InFilter.bHideEmpty ? 1 : MIN_int32;
+	const uint8 bAnyBuild = InFilter.BuildUniqueId == 0;
+	const int32 RequiredBuild = InFilter.BuildUniqueId;
+	const uint8 bAnyMap = InFilter.MapName.IsEmpty();
+	// INDEX_NONE if nobody is on the map, which correctly filters out everything
+	const int32 RequiredMap = bAnyMap ? INDEX_NONE : FindMapId(InFilter.MapName);
+	const uint8 bAnyName = !InFilter.bExactServerName || InFilter.ServerNameContains.IsEmpty();
+	const uint32 RequiredName = bAnyName ? 0 : HashServerName(InFilter.ServerNameContains);
+	const uint8 bAnyCompatibility = !InFilter.bHideIncompatible;
+
+	const int32* RESTRICT PingData = Ping.GetData();
+	const int32* RESTRICT OpenData = OpenSlots.GetData();
+	const int32* RESTRICT MaxData = MaxSlots.GetData();
+	const int32* RESTRICT BuildData = BuildId.GetData();
+	const int32* RESTRICT MapData = MapId.GetData();
+	const uint32* RESTRICT NameData = NameHash.GetData();
+	const uint8* RESTRICT CompatibleData = Compatible.GetData();
+	uint8* RESTRICT MaskData = OutMask.GetData();
+	for (int32 i = 0; i < NumRows; ++i)
+	{
+		MaskData[i] = (uint8)((PingData[i] <= MaxPing)
+			& (OpenData[i] >= MinOpen)
+			& (MaxData[i] - OpenData[i] >= MinPlayers)
+			& (bAnyBuild | (BuildData[i] == RequiredBuild))
+			& (bAnyMap | (MapData[i] == RequiredMap))
+			& (bAnyName | (NameData[i] == RequiredName))
+			& (bAnyCompatibility | CompatibleData[i]));
+	}
+}
+
+void FBYGSearchIndex::Score(const FBYGSearchFilter& InFilter, TArray<float>& OutKeys) const
+{
+	const int32 NumRows = Num();
+	OutKeys.SetNumUninitialized(NumRows);
+
+	// Select the columns by weight rather than branching per row
+	float PingWeight = 0.0f;
+	float PlayersWeight = 0.0f;
+	float FillWeight = 0.0f;
+	switch (InFilter.SortKey)
+	{
+	case EBYGSearchSortKey::Ping:
+		PingWeight = 1.0f;
+		break;
+	case EBYGSearchSortKey::Players:
+		PlayersWeight = 1.0f;
+		break;
+	case EBYGSearchSortKey::Score:
+		PingWeight = InFilter.PingWeight;
+		FillWeight = -InFilter.FillWeight;
+		break;
+	default:
+		break;
+	}
+	const float Direction = InFilter.bSortDescending ? -1.0f : 1.0f;
+
+	const int32* RESTRICT PingData = Ping.GetData();
+	const int32* RESTRICT OpenData = OpenSlots.GetData();
+	const int32* RESTRICT MaxData = MaxSlots.GetData();
+	float* RESTRICT KeyData = OutKeys.GetData();
+	for (int32 i = 0; i < NumRows; ++i)
+	{
+		const float Players = (float)(MaxData[i] - OpenData[i]);
+		const float Fill = Players / FMath::Max((float)MaxData[i], 1.0f);
+		KeyData[i] = Direction * (PingWeight * (float)PingData[i] + PlayersWeight * Players + FillWeight * Fill);
+	}
+}
+
+uint32 FBYGSearchIndex::HashServerName(const FString& ServerName)
+{
+	return FCrc::StrCrc32(*ServerName.ToLower());
+}
+
+SIZE_T FBYGSearchIndex::GetAllocatedSize() const
+{
+	SIZE_T Size = Ping.GetAllocatedSize() + OpenSlots.GetAllocatedSize() + MaxSlots.GetAllocatedSize() + BuildId.GetAllocatedSize()
+		+ MapId.GetAllocatedSize() + NameHash.GetAllocatedSize() + Compatible.GetAllocatedSize() + MapNames.GetAllocatedSize();
+	for (const FString& MapName : MapNames)
+	{
+		Size += MapName.GetAllocatedSize();
+	}
+	return Size;
+}
+
+TSharedRef<FBYGSearchSnapshot, ESPMode::ThreadSafe> FBYGSearchSnapshot::Build(const TArray<FOnlineSessionSearchResult>& Results, EOnlineAsyncTaskState::Type State, const FBYGSearchFilter& Filter, const FBYGNetCoordinate& LocalCoordinate)
+{
+	BYG_LLM_SCOPE();
+	TSharedRef<FBYGSearchSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShared<FBYGSearchSnapshot, ESPMode::ThreadSafe>();
+	Snapshot->State = State;
+	Snapshot->Rows.SetNum(Results.Num());
+
+	const int32 NumBatches = FMath::DivideAndRoundUp(Results.Num(), BYGSearchResults::ParallelDecodeBatchSize);
+	ParallelFor(NumBatches, [&Results, &Snapshot, &LocalCoordinate](int32 Batch)
+	{
+		// LLM scopes are per thread
+		BYG_LLM_SCOPE();
+		const int32 Start = Batch * BYGSearchResults::ParallelDecodeBatchSize;
+		const int32 End = FMath::Min(Start + BYGSearchResults::ParallelDecodeBatchSize, Results.Num());
+		for (int32 i = Start; i < End; ++i)
+		{
+			Snapshot->Rows[i] = FBYGSearchResultRow::FromSearchResult(i, Results[i], LocalCoordinate);
+		}
+	}, NumBatches <= 1);
+
+	Snapshot->Index.Build(Snapshot->Rows);
+	Snapshot->ApplyFilter(Filter);
+	return Snapshot;
+}
+
+void FBYGSearchSnapshot::ApplyFilter(const FBYGSearchFilter& Filter)
+{
+	BYG_LLM_SCOPE();
+	const double StartTime = FPlatformTime::Seconds();
+
+	TArray<uint8> Mask;
+	Index.Filter(Filter, Mask);
+
+	// String filters can't be done on the index, but only have to look at what's left
+	const bool bFilterName = !Filter.ServerNameContains.IsEmpty();
+	VisibleRows.Reset(Rows.Num());
+	for (int32 i = 0; i < Mask.Num(); ++i)
+	{
+		if (Mask[i] && (!bFilterName || (Filter.bExactServerName
+			? Rows[i].ServerName.ToString().Equals(Filter.ServerNameContains, ESearchCase::IgnoreCase)
+			: Rows[i].ServerName.ToString().Contains(Filter.ServerNameContains))))
+		{
+			VisibleRows.Add(i);
+		}
+	}
+
+	if (Filter.SortKey == EBYGSearchSortKey::ServerName)
+	{
+		const TArray<FBYGSearchResultRow>& SortRows = Rows;
+		const bool bDescending = Filter.bSortDescending;
+		Algo::StableSort(VisibleRows, [&SortRows, bDescending](int32 A, int32 B)
+		{
+			const int32 Compare = SortRows[A].ServerName.ToString().Compare(SortRows[B].ServerName.ToString(), ESearchCase::IgnoreCase);
+			return bDescending ? Compare > 0 : Compare < 0;
+		});
+	}
+	else if (Filter.SortKey != EBYGSearchSortKey::None)
+	{
+		TArray<float> Keys;
+		Index.Score(Filter, Keys);
+
+		// Pack the key above the row index and sort plain integers. The index breaks ties, so this is stable.
+		TArray<uint64> SortKeys;
+		SortKeys.SetNumUninitialized(VisibleRows.Num());
+		for (int32 i = 0; i < VisibleRows.Num(); ++i)
+		{
+			uint32 Bits;
+			FMemory::Memcpy(&Bits, &Keys[VisibleRows[i]], sizeof(Bits));
+			// Flip so that unsigned comparison orders like the floats do
+			const uint32 Ordered = Bits ^ ((Bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u);
+			SortKeys[i] = ((uint64)Ordered << 32) | (uint32)VisibleRows[i];
+		}
+		Algo::Sort(SortKeys);
+		for (int32 i = 0; i < SortKeys.Num(); ++i)
+		{
+			VisibleRows[i] = (int32)(SortKeys[i] & 0xFFFFFFFFu);
+		}
+	}
+
+	FilterSeconds = FPlatformTime::Seconds() - StartTime;
+}
+
+SIZE_T FBYGSearchSnapshot::GetAllocatedSize() const
+{
+	SIZE_T Size = sizeof(FBYGSearchSnapshot) + Rows.GetAllocatedSize() + Index.GetAllocatedSize() + VisibleRows.GetAllocatedSize();
+	for (const FBYGSearchResultRow& Row : Rows)
+	{
+		Size += Row.GetAllocatedSize();
+	}
+	return Size;
+}
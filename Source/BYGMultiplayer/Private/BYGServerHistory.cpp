@@ -0,0 +1,486 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGServerHistory.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/NetDriver.h"
+#include "Engine/PendingNetGame.h"
+#include "Engine/World.h"
+#include "Interfaces/OnlineSessionInterface.h"
+#include "Kismet/GameplayStatics.h"
+#include "OnlineSubsystemTypes.h"
+#include "UObject/UObjectGlobals.h"
+
+void FBYGServerHistory::Init(UBYGMultiplayerSubsystem* InSubsystem)
+{
+	Subsystem = InSubsystem;
+	SearchResultsHandle = Subsystem->OnSearchResultsReady.AddRaw(this, &FBYGServerHistory::OnSearchResultsReady);
+	PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddRaw(this, &FBYGServerHistory::OnPostLoadMap);
+	if (GEngine)
+	{
+		TravelFailureHandle = GEngine->OnTravelFailure().AddRaw(this, &FBYGServerHistory::HandleTravelFailure);
+		NetworkFailureHandle = GEngine->OnNetworkFailure().AddRaw(this, &FBYGServerHistory::HandleNetworkFailure);
+	}
+}
+
+void FBYGServerHistory::Deinit()
+{
+	FinishRejoin();
+	if (Subsystem)
+	{
+		Subsystem->OnSearchResultsReady.Remove(SearchResultsHandle);
+	}
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+	if (GEngine)
+	{
+		GEngine->OnTravelFailure().Remove(TravelFailureHandle);
+		GEngine->OnNetworkFailure().Remove(NetworkFailureHandle);
+	}
+	Subsystem = nullptr;
+}
+
+UWorld* FBYGServerHistory::GetWorld() const
+{
+	return Subsystem && Subsystem->GetGameInstance() ? Subsystem->GetGameInstance()->GetWorld() : nullptr;
+}
+
+FString FBYGServerHistory::GetSessionId(const FOnlineSession& Session)
+{
+	return Session.SessionInfo.IsValid() ? Session.SessionInfo->GetSessionId().ToString() : FString();
+}
+
+void FBYGServerHistory::Load()
+{
+	if (bLoaded)
+	{
+		return;
+	}
+	bLoaded = true;
+	if (!UGameplayStatics::DoesSaveGameExist(Subsystem->ServerHistorySlot, 0))
+	{
+		return;
+	}
+	if (const UBYGServerHistorySave* SaveGame = Cast<UBYGServerHistorySave>(UGameplayStatics::LoadGameFromSlot(Subsystem->ServerHistorySlot, 0)))
+	{
+		Servers = SaveGame->Servers;
+		Servers.StableSort([](const FBYGKnownServer& A, const FBYGKnownServer& B) { return A.LastJoined > B.LastJoined; });
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Loaded %d known servers"), Servers.Num());
+	}
+	else
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Couldn't read the server history in save slot '%s'"), *Subsystem->ServerHistorySlot);
+	}
+}
+
+void FBYGServerHistory::Save()
+{
+	UBYGServerHistorySave* SaveGame = NewObject<UBYGServerHistorySave>();
+	SaveGame->Servers = Servers;
+	// Serialized right away, only the write happens in the background
+	UGameplayStatics::AsyncSaveGameToSlot(SaveGame, Subsystem->ServerHistorySlot, 0);
+}
+
+const TArray<FBYGKnownServer>& FBYGServerHistory::GetServers()
+{
+	Load();
+	return Servers;
+}
+
+FBYGKnownServer* FBYGServerHistory::FindMutable(const FString& Key)
+{
+	Load();
+	return Key.IsEmpty() ? nullptr : Servers.FindByPredicate([&Key](const FBYGKnownServer& Server) { return Server.GetKey() == Key; });
+}
+
+const FBYGKnownServer* FBYGServerHistory::Find(const FString& Key)
+{
+	return FindMutable(Key);
+}
+
+void FBYGServerHistory::Touch(FBYGKnownServer Server)
+{
+	Load();
+	const int32 Index = Servers.IndexOfByPredicate([&Server](const FBYGKnownServer& Known) { return Known.GetKey() == Server.GetKey(); });
+	if (Index != INDEX_NONE)
+	{
+		Server.bFavorite = Servers[Index].bFavorite;
+		Server.NumJoins = Servers[Index].NumJoins;
+		Servers.RemoveAt(Index);
+	}
+	++Server.NumJoins;
+	Server.LastJoined = FDateTime::UtcNow();
+	Servers.Insert(MoveTemp(Server), 0);
+
+	// Oldest go first, favorites never do
+	int32 NumRecent = 0;
+	for (int32 i = 0; i < Servers.Num(); ++i)
+	{
+		if (!Servers[i].bFavorite && ++NumRecent > Subsystem->MaxRecentServers)
+		{
+			Servers.RemoveAt(i--);
+		}
+	}
+	Save();
+}
+
+void FBYGServerHistory::Remember(const FString& SessionId, const FString& ConnectInfo, FName SubsystemName, const FOnlineSessionSettings& Settings)
+{
+	if (!Subsystem->bRememberServers || (SessionId.IsEmpty() && ConnectInfo.IsEmpty()))
+	{
+		return;
+	}
+	FBYGKnownServer Server;
+	Server.SessionId = SessionId;
+	Server.ConnectInfo = ConnectInfo;
+	Server.Subsystem = SubsystemName;
+	Server.ServerName = BYGSessionKeys::ServerName.Get(Settings);
+	Server.MapName = BYGSessionKeys::MapName.Get(Settings);
+	PendingServer = MoveTemp(Server);
+}
+
+void FBYGServerHistory::SetFavorite(const FString& Key, bool bFavorite)
+{
+	if (FBYGKnownServer* Server = FindMutable(Key))
+	{
+		Server->bFavorite = bFavorite;
+		Save();
+	}
+}
+
+void FBYGServerHistory::Forget(const FString& Key)
+{
+	Load();
+	if (Servers.RemoveAll([&Key](const FBYGKnownServer& Server) { return Server.GetKey() == Key; }) > 0)
+	{
+		Save();
+	}
+}
+
+bool FBYGServerHistory::Rejoin(const FString& Key)
+{
+	const FBYGKnownServer* Server = Find(Key);
+	if (!Server)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("No known server '%s' to rejoin"), *Key);
+		return false;
+	}
+	CancelRejoin();
+	Target = *Server;
+	bRejoining = true;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Rejoining '%s' at %s"), *Target.ServerName, *Target.ConnectInfo);
+
+	// Travel first, a lookup that fails right away would otherwise start a search we don't need yet
+	bTravelling = !Target.ConnectInfo.IsEmpty() && Subsystem->JoinDirect(Target.ConnectInfo);
+	if (bTravelling && Subsystem->bRememberServers)
+	{
+		PendingServer = Target;
+	}
+	bLookingUp = true;
+	if (!StartLookup())
+	{
+		bLookingUp = false;
+		if (!bTravelling)
+		{
+			StartSearch();
+		}
+	}
+	return true;
+}
+
+void FBYGServerHistory::CancelRejoin()
+{
+	if (bRejoining)
+	{
+		CancelTravel();
+		FinishRejoin();
+	}
+}
+
+void FBYGServerHistory::FinishRejoin()
+{
+	bRejoining = false;
+	bTravelling = false;
+	bLookingUp = false;
+	bSearching = false;
+	bSearchComplete = false;
+	bConnected = false;
+	bJoinedSession = false;
+	FoundResult.Reset();
+	// Anything still on its way belongs to this rejoin
+	++RejoinSerial;
+}
+
+bool FBYGServerHistory::StartLookup()
+{
+	if (Target.SessionId.IsEmpty() || Target.Subsystem != Subsystem->GetCurrentSubsystemName() || Subsystem->IsReplaying())
+	{
+		return false;
+	}
+	IOnlineSessionPtr SessionInterface = Subsystem->GetSession();
+	TSharedPtr<const FUniqueNetId> PlayerId = Subsystem->GetPlayerId();
+	TSharedPtr<const FUniqueNetId> SessionId = SessionInterface.IsValid() ? SessionInterface->CreateSessionIdFromString(Target.SessionId) : nullptr;
+	if (!PlayerId.IsValid() || !SessionId.IsValid())
+	{
+		return false;
+	}
+	// Not every subsystem can look sessions up by id, those return false and we go by the connect alone
+	const uint32 Serial = RejoinSerial;
+	return SessionInterface->FindSessionById(*PlayerId, *SessionId, *PlayerId, FOnSingleSessionResultCompleteDelegate::CreateWeakLambda(Subsystem,
+		[this, Serial](int32 LocalUserNum, bool bWasSuccessful, const FOnlineSessionSearchResult& Result)
+		{
+			if (Serial == RejoinSerial && bLookingUp)
+			{
+				OnLookupComplete(bWasSuccessful, Result);
+			}
+		}));
+}
+
+void FBYGServerHistory::OnLookupComplete(bool bWasSuccessful, const FOnlineSessionSearchResult& Result)
+{
+	bLookingUp = false;
+	if (bWasSuccessful && Result.IsValid())
+	{
+		FoundResult = Result;
+		FString ConnectInfo;
+		Subsystem->GetConnectString(Result, NAME_GamePort, ConnectInfo);
+		if (bConnected || (bTravelling && ConnectInfo == Target.ConnectInfo))
+		{
+			// Already there or on our way, only the session is missing
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Found the session for '%s', joining it without travelling again"), *Target.ServerName);
+			bJoinedSession = true;
+			Subsystem->JoinSearchResult(Result, true);
+			if (bConnected)
+			{
+				FinishRejoin();
+			}
+			return;
+		}
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("'%s' is at %s now, joining it there"), *Target.ServerName, *ConnectInfo);
+		CancelTravel();
+		JoinFoundResult();
+		return;
+	}
+
+	if (bConnected)
+	{
+		// Same as a host that has no session
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Rejoined '%s', but couldn't find its session"), *Target.ServerName);
+		FinishRejoin();
+		return;
+	}
+
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Session for '%s' not found, searching in case the connect doesn't work out"), *Target.ServerName);
+	StartSearch();
+}
+
+void FBYGServerHistory::StartSearch()
+{
+	if (bSearching || bSearchComplete)
+	{
+		return;
+	}
+	bSearching = true;
+	Subsystem->FindSessions();
+}
+
+void FBYGServerHistory::OnSearchResultsReady(const FBYGSearchSnapshotRef& Snapshot)
+{
+	if (!bSearching || Snapshot->State == EOnlineAsyncTaskState::NotStarted || Snapshot->State == EOnlineAsyncTaskState::InProgress)
+	{
+		return;
+	}
+	bSearching = false;
+	bSearchComplete = true;
+	// Only needed if the connect fails
+	if (bTravelling)
+	{
+		return;
+	}
+	if (!JoinFromSearch())
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Couldn't find '%s' any more"), *Target.ServerName);
+		FinishRejoin();
+	}
+}
+
+bool FBYGServerHistory::JoinFromSearch()
+{
+	const FBYGSearchSnapshotRef Snapshot = Subsystem->GetSearchSnapshot();
+	const FBYGSearchResultRow* Best = nullptr;
+	const FBYGSearchResultRow* SameName = nullptr;
+	for (const FBYGSearchResultRow& Row : Snapshot->Rows)
+	{
+		if (!Target.SessionId.IsEmpty() && Row.SessionId.ToString() == Target.SessionId)
+		{
+			Best = &Row;
+			break;
+		}
+		// Restarted servers come back with a new session id, but usually under the same name and address. Names
+		// alone aren't unique, plenty of hosts never change the default.
+		if (!Best && !Target.ServerName.IsEmpty() && Row.ServerName.ToString() == Target.ServerName)
+		{
+			FString ConnectInfo;
+			const bool bSameAddress = !Target.ConnectInfo.IsEmpty() && Subsystem->SessionSearch.IsValid()
+				&& Subsystem->SessionSearch->SearchResults.IsValidIndex(Row.SearchIndex)
+				&& Subsystem->GetConnectString(Subsystem->SessionSearch->SearchResults[Row.SearchIndex], NAME_GamePort, ConnectInfo)
+				&& ConnectInfo == Target.ConnectInfo;
+			if (bSameAddress)
+			{
+				Best = &Row;
+			}
+			else if (!SameName)
+			{
+				SameName = &Row;
+			}
+		}
+	}
+	if (!Best)
+	{
+		if (SameName)
+		{
+			// Could be a stranger, so it's left in the search results for the player to pick rather than joined
+			UE_LOG(LogBYGMultiplayer, Log, TEXT("Search result %d is also called '%s', but isn't at %s. Not joining it."),
+				SameName->SearchIndex, *Target.ServerName, *Target.ConnectInfo);
+		}
+		return false;
+	}
+
+	// The new session takes over the old one's place, so it stays a favorite
+	const FString NewSessionId = Best->SessionId.ToString();
+	FBYGKnownServer* Known = FindMutable(Target.GetKey());
+	if (Known && !Target.SessionId.IsEmpty() && NewSessionId != Target.SessionId && !FindMutable(NewSessionId))
+	{
+		Known->SessionId = NewSessionId;
+		Save();
+	}
+
+	const int32 SearchIndex = Best->SearchIndex;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Found '%s' again, joining search result %d"), *Target.ServerName, SearchIndex);
+	FinishRejoin();
+	Subsystem->JoinSession(SearchIndex);
+	return true;
+}
+
+void FBYGServerHistory::JoinFoundResult()
+{
+	const FOnlineSessionSearchResult Result = FoundResult.GetValue();
+	FinishRejoin();
+	Subsystem->JoinSearchResult(Result);
+}
+
+void FBYGServerHistory::OnTravelFailed()
+{
+	if (!bRejoining || !bTravelling)
+	{
+		return;
+	}
+	bTravelling = false;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Couldn't connect to '%s' at %s directly"), *Target.ServerName, *Target.ConnectInfo);
+
+	if (bJoinedSession)
+	{
+		// The session's address is the one that just failed, and the subsystem ends the session on failures
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Couldn't rejoin '%s'"), *Target.ServerName);
+		FinishRejoin();
+	}
+	else if (FoundResult.IsSet())
+	{
+		JoinFoundResult();
+	}
+	else if (bSearchComplete)
+	{
+		if (!JoinFromSearch())
+		{
+			UE_LOG(LogBYGMultiplayer, Warning, TEXT("Couldn't find '%s' any more"), *Target.ServerName);
+			FinishRejoin();
+		}
+	}
+	else if (!bLookingUp)
+	{
+		StartSearch();
+	}
+	// Otherwise whichever of the lookup and the search finishes decides
+}
+
+void FBYGServerHistory::CancelTravel()
+{
+	if (!bTravelling)
+	{
+		return;
+	}
+	bTravelling = false;
+	PendingServer.Reset();
+	Subsystem->TravelProfiler.Abort();
+	FWorldContext* Context = GEngine ? GEngine->GetWorldContextFromWorld(GetWorld()) : nullptr;
+	if (Context)
+	{
+		// Either still waiting for the next tick to start connecting, or already connecting
+		Context->TravelURL.Empty();
+		GEngine->CancelPending(*Context);
+	}
+}
+
+void FBYGServerHistory::OnPostLoadMap(UWorld* World)
+{
+	if (!World || World->GetNetMode() != NM_Client)
+	{
+		return;
+	}
+	// The host let us in
+	if (PendingServer.IsSet())
+	{
+		Touch(MoveTemp(PendingServer.GetValue()));
+		PendingServer.Reset();
+	}
+
+	if (!bRejoining || !bTravelling)
+	{
+		return;
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Rejoined '%s' directly"), *Target.ServerName);
+	bTravelling = false;
+	bConnected = true;
+	// The session is joined once the lookup finds it. A fallback search may still be running, it just fills the browser.
+	if (!bLookingUp)
+	{
+		FinishRejoin();
+	}
+}
+
+bool FBYGServerHistory::IsOurConnection(UWorld* World, UNetDriver* NetDriver) const
+{
+	// The engine broadcasts failures for every world, e.g. other PIE instances
+	UWorld* OurWorld = GetWorld();
+	if (World && World != OurWorld)
+	{
+		return false;
+	}
+	// Travel failures don't say which driver
+	if (!NetDriver)
+	{
+		return true;
+	}
+	// Not a beacon's, or a driver left over from somewhere we've already left
+	const FWorldContext* Context = GEngine ? GEngine->GetWorldContextFromWorld(OurWorld) : nullptr;
+	const bool bPending = Context && Context->PendingNetGame && Context->PendingNetGame->NetDriver == NetDriver;
+	return bPending || (OurWorld && OurWorld->GetNetDriver() == NetDriver);
+}
+
+void FBYGServerHistory::HandleTravelFailure(UWorld* World, ETravelFailure::Type FailureType, const FString& ErrorString)
+{
+	if (IsOurConnection(World, nullptr))
+	{
+		PendingServer.Reset();
+		OnTravelFailed();
+	}
+}
+
+void FBYGServerHistory::HandleNetworkFailure(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString)
+{
+	if (IsOurConnection(World, NetDriver))
+	{
+		PendingServer.Reset();
+		OnTravelFailed();
+	}
+}
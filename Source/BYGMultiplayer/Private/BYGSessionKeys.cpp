@@ -0,0 +1,22 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGSessionKeys.h"
+
+namespace BYGSessionKeys
+{
+	const TBYGSessionKey<FString> ServerName(TEXT("SERVER_NAME"), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing, FString());
+	const TBYGSessionKey<FString> MapName(TEXT("MAPNAME"), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing, FString());
+	const TBYGSessionKey<FString> NetProfile(TEXT("BYG_NET_PROFILE"), EOnlineDataAdvertisementType::ViaOnlineService, FString());
+	const TBYGSessionKey<int32> BeaconPort(TEXT("BEACONPORT"), EOnlineDataAdvertisementType::ViaOnlineService, 0);
+	const TBYGSessionKey<FString> LobbyMap(TEXT("BYG_LOBBY_MAP"), EOnlineDataAdvertisementType::ViaOnlineService, FString());
+	const TBYGSessionKey<FString> MatchMap(TEXT("BYG_MATCH_MAP"), EOnlineDataAdvertisementType::ViaOnlineService, FString());
+	const TBYGSessionKey<FString> SearchSource(TEXT("BYG_SEARCH_SOURCE"), EOnlineDataAdvertisementType::DontAdvertise, FString());
+	const TBYGSessionKey<FString> SearchSubsystem(TEXT("BYG_SEARCH_SUBSYSTEM"), EOnlineDataAdvertisementType::DontAdvertise, FString());
+	const TBYGSessionKey<FString> HostAddress(TEXT("BYG_HOST_ADDRESS"), EOnlineDataAdvertisementType::DontAdvertise, FString());
+	const TBYGSessionKey<int32> GamePort(TEXT("BYG_GAME_PORT"), EOnlineDataAdvertisementType::DontAdvertise, 0);
+	const TBYGSessionKey<int32> BuildId(TEXT("BYG_BUILD_ID"), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing, 0);
+	const TBYGSessionKey<FString> ContentVersion(TEXT("BYG_CONTENT_VERSION"), EOnlineDataAdvertisementType::ViaOnlineService, FString());
+	const TBYGSessionKey<int32> NetCoordinate(TEXT("BYG_NET_COORD"), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing, 0);
+	// Hosts that only advertised the coordinate only did so once it was about as good as a region's
+	const TBYGSessionKey<float> NetCoordinateError(TEXT("BYG_NET_COORD_ERR"), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing, 0.25f);
+}
@@ -0,0 +1,372 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGSessionRecorder.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "OnlineSessionSettings.h"
+#include "OnlineSubsystemTypes.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace BYGSessionRecording
+{
+	// 'BYGR'
+	static const uint32 FileMagic = 0x42594752;
+	static const int32 FileVersion = 2;
+
+	template<typename T>
+	void SerializeValue(FArchive& Ar, FVariantData& Data)
+	{
+		T Value{};
+		if (Ar.IsSaving())
+		{
+			Data.GetValue(Value);
+		}
+		Ar << Value;
+		if (Ar.IsLoading())
+		{
+			Data.SetValue(Value);
+		}
+	}
+
+	// FVariantData::ToString/FromString would lose blobs and float precision, so save the raw value by type
+	void SerializeVariantData(FArchive& Ar, FVariantData& Data)
+	{
+		uint8 Type = (uint8)Data.GetType();
+		Ar << Type;
+		switch ((EOnlineKeyValuePairDataType::Type)Type)
+		{
+		case EOnlineKeyValuePairDataType::Int32:
+			SerializeValue<int32>(Ar, Data);
+			break;
+		case EOnlineKeyValuePairDataType::UInt32:
+			SerializeValue<uint32>(Ar, Data);
+			break;
+		case EOnlineKeyValuePairDataType::Int64:
+			SerializeValue<int64>(Ar, Data);
+			break;
+		case EOnlineKeyValuePairDataType::UInt64:
+			SerializeValue<uint64>(Ar, Data);
+			break;
+		case EOnlineKeyValuePairDataType::Float:
+			SerializeValue<float>(Ar, Data);
+			break;
+		case EOnlineKeyValuePairDataType::Double:
+			SerializeValue<double>(Ar, Data);
+			break;
+		case EOnlineKeyValuePairDataType::Bool:
+			SerializeValue<bool>(Ar, Data);
+			break;
+		case EOnlineKeyValuePairDataType::String:
+			SerializeValue<FString>(Ar, Data);
+			break;
+		case EOnlineKeyValuePairDataType::Blob:
+			SerializeValue<TArray<uint8>>(Ar, Data);
+			break;
+		case EOnlineKeyValuePairDataType::Json:
+		{
+			FString Json = Ar.IsSaving() ? Data.ToString() : FString();
+			Ar << Json;
+			if (Ar.IsLoading())
+			{
+				Data.SetJsonValueFromString(Json);
+			}
+			break;
+		}
+		default:
+			if (Ar.IsLoading())
+			{
+				Data.Empty();
+			}
+			break;
+		}
+	}
+
+	// Stands in for the session info of the recorded result, which only needs to answer with its session ID
+	class FRecordedSessionInfo : public FOnlineSessionInfo
+	{
+	public:
+		explicit FRecordedSessionInfo(const FString& InSessionId)
+			: SessionId(FBYGSessionReplayer::MakeUniqueNetId(InSessionId))
+		{
+		}
+
+		virtual const uint8* GetBytes() const override { return nullptr; }
+		virtual int32 GetSize() const override { return 0; }
+		virtual bool IsValid() const override { return true; }
+		virtual const FUniqueNetId& GetSessionId() const override { return *SessionId; }
+		virtual FString ToString() const override { return SessionId->ToString(); }
+		virtual FString ToDebugString() const override { return FString::Printf(TEXT("Recorded session %s"), *ToString()); }
+
+	protected:
+		TSharedRef<const FUniqueNetId> SessionId;
+	};
+}
+
+FArchive& operator<<(FArchive& Ar, FBYGRecordedSessionSetting& Setting)
+{
+	Ar << Setting.Key;
+	BYGSessionRecording::SerializeVariantData(Ar, Setting.Data);
+	Ar << Setting.AdvertisementType;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FBYGRecordedSearchResult& Result)
+{
+	Ar << Result.SessionId << Result.OwningUserId << Result.OwningUserName << Result.PingInMs;
+	Ar << Result.NumOpenPublicConnections << Result.NumOpenPrivateConnections;
+	Ar << Result.NumPublicConnections << Result.NumPrivateConnections << Result.BuildUniqueId;
+	Ar << Result.bIsLANMatch << Result.bIsDedicated << Result.bUsesPresence << Result.bAllowJoinInProgress;
+	Ar << Result.Settings;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FBYGSessionEvent& Event)
+{
+	uint8 Type = (uint8)Event.Type;
+	Ar << Event.Time << Type << Event.SessionName << Event.bWasSuccessful << Event.Value << Event.Message << Event.SearchResults;
+	Event.Type = (EBYGSessionEventType)Type;
+	return Ar;
+}
+
+FBYGRecordedSearchResult FBYGRecordedSearchResult::FromSearchResult(const FOnlineSessionSearchResult& Result)
+{
+	FBYGRecordedSearchResult Recorded;
+	if (Result.IsSessionInfoValid())
+	{
+		Recorded.SessionId = Result.Session.SessionInfo->GetSessionId().ToString();
+	}
+	if (Result.Session.OwningUserId.IsValid())
+	{
+		Recorded.OwningUserId = Result.Session.OwningUserId->ToString();
+	}
+	Recorded.OwningUserName = Result.Session.OwningUserName;
+	Recorded.PingInMs = Result.PingInMs;
+	Recorded.NumOpenPublicConnections = Result.Session.NumOpenPublicConnections;
+	Recorded.NumOpenPrivateConnections = Result.Session.NumOpenPrivateConnections;
+
+	const FOnlineSessionSettings& SessionSettings = Result.Session.SessionSettings;
+	Recorded.NumPublicConnections = SessionSettings.NumPublicConnections;
+	Recorded.NumPrivateConnections = SessionSettings.NumPrivateConnections;
+	Recorded.BuildUniqueId = SessionSettings.BuildUniqueId;
+	Recorded.bIsLANMatch = SessionSettings.bIsLANMatch;
+	Recorded.bIsDedicated = SessionSettings.bIsDedicated;
+	Recorded.bUsesPresence = SessionSettings.bUsesPresence;
+	Recorded.bAllowJoinInProgress = SessionSettings.bAllowJoinInProgress;
+
+	Recorded.Settings.Reserve(SessionSettings.Settings.Num());
+	for (const auto& Pair : SessionSettings.Settings)
+	{
+		FBYGRecordedSessionSetting& Setting = Recorded.Settings.AddDefaulted_GetRef();
+		Setting.Key = Pair.Key;
+		Setting.Data = Pair.Value.Data;
+		Setting.AdvertisementType = (uint8)Pair.Value.AdvertisementType;
+	}
+	return Recorded;
+}
+
+FOnlineSessionSearchResult FBYGRecordedSearchResult::ToSearchResult() const
+{
+	FOnlineSessionSearchResult Result;
+	Result.PingInMs = PingInMs;
+	if (!SessionId.IsEmpty())
+	{
+		Result.Session.SessionInfo = MakeShared<BYGSessionRecording::FRecordedSessionInfo>(SessionId);
+	}
+	if (!OwningUserId.IsEmpty())
+	{
+		Result.Session.OwningUserId = FBYGSessionReplayer::MakeUniqueNetId(OwningUserId);
+	}
+	Result.Session.OwningUserName = OwningUserName;
+	Result.Session.NumOpenPublicConnections = NumOpenPublicConnections;
+	Result.Session.NumOpenPrivateConnections = NumOpenPrivateConnections;
+
+	FOnlineSessionSettings& SessionSettings = Result.Session.SessionSettings;
+	SessionSettings.NumPublicConnections = NumPublicConnections;
+	SessionSettings.NumPrivateConnections = NumPrivateConnections;
+	SessionSettings.BuildUniqueId = BuildUniqueId;
+	SessionSettings.bIsLANMatch = bIsLANMatch;
+	SessionSettings.bIsDedicated = bIsDedicated;
+	SessionSettings.bUsesPresence = bUsesPresence;
+	SessionSettings.bAllowJoinInProgress = bAllowJoinInProgress;
+	for (const FBYGRecordedSessionSetting& Setting : Settings)
+	{
+		SessionSettings.Settings.Add(Setting.Key, FOnlineSessionSetting(Setting.Data, (EOnlineDataAdvertisementType::Type)Setting.AdvertisementType));
+	}
+	return Result;
+}
+
+const TCHAR* FBYGSessionEvent::GetTypeName(EBYGSessionEventType Type)
+{
+	switch (Type)
+	{
+	case EBYGSessionEventType::HostGame:
+		return TEXT("HostGame");
+	case EBYGSessionEventType::CancelHosting:
+		return TEXT("CancelHosting");
+	case EBYGSessionEventType::FindSessions:
+		return TEXT("FindSessions");
+	case EBYGSessionEventType::JoinSession:
+		return TEXT("JoinSession");
+	case EBYGSessionEventType::LoginComplete:
+		return TEXT("LoginComplete");
+	case EBYGSessionEventType::CreateSessionComplete:
+		return TEXT("CreateSessionComplete");
+	case EBYGSessionEventType::StartSessionComplete:
+		return TEXT("StartSessionComplete");
+	case EBYGSessionEventType::FindSessionsComplete:
+		return TEXT("FindSessionsComplete");
+	case EBYGSessionEventType::JoinSessionComplete:
+		return TEXT("JoinSessionComplete");
+	case EBYGSessionEventType::EndSessionComplete:
+		return TEXT("EndSessionComplete");
+	case EBYGSessionEventType::NetworkFailure:
+		return TEXT("NetworkFailure");
+	case EBYGSessionEventType::TravelFailure:
+		return TEXT("TravelFailure");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
+void FBYGSessionRecorder::Start()
+{
+	Events.Reset();
+	StartTime = FPlatformTime::Seconds();
+	bIsRecording = true;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Started recording session events"));
+}
+
+void FBYGSessionRecorder::Stop()
+{
+	if (bIsRecording)
+	{
+		bIsRecording = false;
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Stopped recording session events, %d events over %.1f seconds"), Events.Num(), GetDuration());
+	}
+}
+
+FBYGSessionEvent* FBYGSessionRecorder::Record(EBYGSessionEventType Type, FName SessionName, bool bWasSuccessful, int32 Value, const FString& Message)
+{
+	if (!bIsRecording)
+	{
+		return nullptr;
+	}
+
+	FBYGSessionEvent& Event = Events.AddDefaulted_GetRef();
+	Event.Time = FPlatformTime::Seconds() - StartTime;
+	Event.Type = Type;
+	Event.SessionName = SessionName;
+	Event.bWasSuccessful = bWasSuccessful;
+	Event.Value = Value;
+	Event.Message = Message;
+	return &Event;
+}
+
+bool FBYGSessionRecorder::SaveToFile(const FString& Filename) const
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	uint32 Magic = BYGSessionRecording::FileMagic;
+	int32 Version = BYGSessionRecording::FileVersion;
+	Writer << Magic << Version;
+	// Const is only in the way of the shared operator<<
+	Writer << const_cast<TArray<FBYGSessionEvent>&>(Events);
+
+	if (!FFileHelper::SaveArrayToFile(Bytes, *Filename))
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Failed to write session recording to '%s'"), *Filename);
+		return false;
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Wrote %d session events (%d bytes) to '%s'"), Events.Num(), Bytes.Num(), *Filename);
+	return true;
+}
+
+bool FBYGSessionRecorder::LoadFromFile(const FString& Filename, TArray<FBYGSessionEvent>& OutEvents)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Filename))
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Could not read session recording '%s'"), *Filename);
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 Magic = 0;
+	int32 Version = 0;
+	Reader << Magic << Version;
+	if (Magic != BYGSessionRecording::FileMagic || Version != BYGSessionRecording::FileVersion)
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("'%s' is not a session recording, or is from an incompatible version (%d)"), *Filename, Version);
+		return false;
+	}
+	Reader << OutEvents;
+	return !Reader.IsError();
+}
+
+FString FBYGSessionRecorder::GetDefaultFilename()
+{
+	return FPaths::ProjectSavedDir() / TEXT("BYGMultiplayer") / FString::Printf(TEXT("Session-%s.bygrec"), *FDateTime::Now().ToString());
+}
+
+TSharedRef<const FUniqueNetId> FBYGSessionReplayer::MakeUniqueNetId(const FString& Id)
+{
+	static const FName ReplayType(TEXT("BYGReplay"));
+#if ENGINE_MAJOR_VERSION >= 5
+	return FUniqueNetIdString::Create(Id, ReplayType);
+#else
+	return MakeShared<FUniqueNetIdString>(Id, ReplayType);
+#endif
+}
+
+void FBYGSessionReplayer::Start(TArray<FBYGSessionEvent>&& InEvents, float InSpeed)
+{
+	Events = MoveTemp(InEvents);
+	Speed = InSpeed;
+	NextEvent = 0;
+	ReplayTime = 0.0;
+	StartWallTime = FPlatformTime::Seconds();
+	bIsReplaying = true;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Replaying %d session events at %s"), Events.Num(),
+		Speed > 0.0f ? *FString::Printf(TEXT("%.1fx speed"), Speed) : TEXT("full speed"));
+}
+
+void FBYGSessionReplayer::Stop()
+{
+	bIsReplaying = false;
+	Events.Reset();
+	NextEvent = 0;
+}
+
+bool FBYGSessionReplayer::Tick(float DeltaTime, TFunctionRef<void(const FBYGSessionEvent&)> Dispatch)
+{
+	if (!bIsReplaying)
+	{
+		return false;
+	}
+
+	ReplayTime += DeltaTime * Speed;
+	while (NextEvent < Events.Num() && (Speed <= 0.0f || Events[NextEvent].Time <= ReplayTime))
+	{
+		// Advance first, dispatching may stop the replay
+		const int32 EventIndex = NextEvent++;
+		Dispatch(Events[EventIndex]);
+		if (!bIsReplaying)
+		{
+			return false;
+		}
+	}
+
+	if (NextEvent >= Events.Num())
+	{
+		LastReplayDuration = FPlatformTime::Seconds() - StartWallTime;
+		UE_LOG(LogBYGMultiplayer, Log, TEXT("Replay finished in %.3f seconds, recording was %.3f seconds"),
+			LastReplayDuration, Events.Num() > 0 ? Events.Last().Time : 0.0);
+		Stop();
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,28 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGSessionSnapshot.h"
+
+const TCHAR* FBYGSessionSnapshot::GetStateName(EOnlineSessionState::Type State)
+{
+	switch (State)
+	{
+	case EOnlineSessionState::NoSession:
+		return TEXT("No session");
+	case EOnlineSessionState::Creating:
+		return TEXT("Creating");
+	case EOnlineSessionState::Pending:
+		return TEXT("Pending");
+	case EOnlineSessionState::Starting:
+		return TEXT("Starting");
+	case EOnlineSessionState::InProgress:
+		return TEXT("In progress");
+	case EOnlineSessionState::Ending:
+		return TEXT("Ending");
+	case EOnlineSessionState::Ended:
+		return TEXT("Ended");
+	case EOnlineSessionState::Destroying:
+		return TEXT("Destroying");
+	default:
+		return TEXT("Unknown");
+	}
+}
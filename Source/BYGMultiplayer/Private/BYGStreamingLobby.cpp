@@ -0,0 +1,263 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGStreamingLobby.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "EngineUtils.h"
+#include "Engine/GameInstance.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/PlatformTime.h"
+#include "Kismet/GameplayStatics.h"
+#include "Net/UnrealNetwork.h"
+
+ABYGStreamingLobbyState::ABYGStreamingLobbyState()
+{
+	bReplicates = true;
+	bAlwaysRelevant = true;
+}
+
+void ABYGStreamingLobbyState::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(ABYGStreamingLobbyState, Stage);
+	DOREPLIFETIME(ABYGStreamingLobbyState, NumReady);
+	DOREPLIFETIME(ABYGStreamingLobbyState, NumClients);
+}
+
+void FBYGStreamingLobby::Init(UBYGMultiplayerSubsystem* InSubsystem)
+{
+	Subsystem = InSubsystem;
+	ReadyTimeout = Subsystem->StreamingReadyTimeout;
+}
+
+bool FBYGStreamingLobby::IsEnabled() const
+{
+	return Subsystem && Subsystem->bStreamingLobby;
+}
+
+UWorld* FBYGStreamingLobby::GetWorld() const
+{
+	return Subsystem && Subsystem->GetGameInstance() ? Subsystem->GetGameInstance()->GetWorld() : nullptr;
+}
+
+const TCHAR* FBYGStreamingLobby::GetStageName(EBYGLobbyStage Stage)
+{
+	switch (Stage)
+	{
+	case EBYGLobbyStage::Lobby:
+		return TEXT("Lobby");
+	case EBYGLobbyStage::LoadingMatch:
+		return TEXT("Loading match");
+	case EBYGLobbyStage::Match:
+		return TEXT("Match");
+	case EBYGLobbyStage::LoadingLobby:
+		return TEXT("Loading lobby");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
+ABYGStreamingLobbyState* FBYGStreamingLobby::FindState() const
+{
+	if (State.IsValid())
+	{
+		return State.Get();
+	}
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return nullptr;
+	}
+	// Clients only have the replicated copy
+	for (TActorIterator<ABYGStreamingLobbyState> It(World); It; ++It)
+	{
+		State = *It;
+		return *It;
+	}
+	return nullptr;
+}
+
+EBYGLobbyStage FBYGStreamingLobby::GetStage() const
+{
+	const ABYGStreamingLobbyState* LobbyState = FindState();
+	return LobbyState ? LobbyState->Stage : EBYGLobbyStage::Lobby;
+}
+
+int32 FBYGStreamingLobby::GetNumReady() const
+{
+	const ABYGStreamingLobbyState* LobbyState = FindState();
+	return LobbyState ? LobbyState->NumReady : 0;
+}
+
+int32 FBYGStreamingLobby::GetNumClients() const
+{
+	const ABYGStreamingLobbyState* LobbyState = FindState();
+	return LobbyState ? LobbyState->NumClients : 0;
+}
+
+void FBYGStreamingLobby::Tick()
+{
+	if (!IsEnabled())
+	{
+		return;
+	}
+	UWorld* World = GetWorld();
+	if (!World || !Subsystem->bIsHosting || World->GetNetMode() == NM_Client || World->GetNetMode() == NM_Standalone)
+	{
+		return;
+	}
+	if (World != HostWorld.Get())
+	{
+		StartHosting(World);
+	}
+	if (bTransitioning)
+	{
+		TickTransition(World);
+	}
+}
+
+void FBYGStreamingLobby::StartHosting(UWorld* World)
+{
+	HostWorld = World;
+	bTransitioning = false;
+
+	ULevelStreaming* Lobby = FindLevel(World, false);
+	ULevelStreaming* Match = FindLevel(World, true);
+	if (!Lobby || !Match)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Streaming lobby is on, but %s has no '%s' and '%s' sublevels"),
+			*World->GetMapName(), *Subsystem->StreamingLobbyLevel, *Subsystem->StreamingMatchLevel);
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Name = TEXT("BYGStreamingLobbyState");
+	SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+	State = World->SpawnActor<ABYGStreamingLobbyState>(SpawnParams);
+
+	SetLevelStreaming(World, Lobby, true, true);
+	SetLevelStreaming(World, Match, false, false);
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Streaming lobby ready, showing '%s'"), *Subsystem->StreamingLobbyLevel);
+}
+
+bool FBYGStreamingLobby::StreamTo(bool bToMatch)
+{
+	UWorld* World = GetWorld();
+	ABYGStreamingLobbyState* LobbyState = State.Get();
+	if (!IsEnabled() || !World || World->GetNetMode() == NM_Client || !LobbyState)
+	{
+		UE_LOG(LogBYGMultiplayer, Error, TEXT("Only a server hosting a streaming lobby can stream to the %s"), bToMatch ? TEXT("match") : TEXT("lobby"));
+		return false;
+	}
+	if (bTransitioning)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Already streaming to the %s"), bTransitionToMatch ? TEXT("match") : TEXT("lobby"));
+		return false;
+	}
+	const EBYGLobbyStage Destination = bToMatch ? EBYGLobbyStage::Match : EBYGLobbyStage::Lobby;
+	if (LobbyState->Stage == Destination)
+	{
+		return true;
+	}
+
+	ULevelStreaming* Incoming = FindLevel(World, bToMatch);
+	if (!Incoming)
+	{
+		return false;
+	}
+
+	bTransitioning = true;
+	bTransitionToMatch = bToMatch;
+	TransitionStartTime = FPlatformTime::Seconds();
+	LobbyState->Stage = bToMatch ? EBYGLobbyStage::LoadingMatch : EBYGLobbyStage::LoadingLobby;
+	LobbyState->NumReady = 0;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Streaming in the %s"), bToMatch ? TEXT("match") : TEXT("lobby"));
+	SetLevelStreaming(World, Incoming, true, true);
+	return true;
+}
+
+void FBYGStreamingLobby::TickTransition(UWorld* World)
+{
+	ABYGStreamingLobbyState* LobbyState = State.Get();
+	ULevelStreaming* Incoming = FindLevel(World, bTransitionToMatch);
+	ULevelStreaming* Outgoing = FindLevel(World, !bTransitionToMatch);
+	if (!LobbyState || !Incoming || !Outgoing)
+	{
+		bTransitioning = false;
+		return;
+	}
+
+	int32 NumClients = 0;
+	const int32 NumReady = CountReadyClients(World, Incoming, NumClients);
+	// Only assign on change, so it's only replicated on change
+	if (LobbyState->NumReady != NumReady || LobbyState->NumClients != NumClients)
+	{
+		LobbyState->NumReady = NumReady;
+		LobbyState->NumClients = NumClients;
+	}
+
+	const double Elapsed = FPlatformTime::Seconds() - TransitionStartTime;
+	const bool bAllReady = Incoming->IsLevelVisible() && NumReady == NumClients;
+	if (!bAllReady && Elapsed < ReadyTimeout)
+	{
+		return;
+	}
+	if (!bAllReady)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Only %d of %d clients were ready after %.1f seconds, carrying on without them"), NumReady, NumClients, Elapsed);
+	}
+
+	SetLevelStreaming(World, Outgoing, false, false);
+	LobbyState->Stage = bTransitionToMatch ? EBYGLobbyStage::Match : EBYGLobbyStage::Lobby;
+	bTransitioning = false;
+	LastTransitionSeconds = Elapsed;
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("Streamed to the %s in %.0fms with %d clients"), bTransitionToMatch ? TEXT("match") : TEXT("lobby"), Elapsed * 1000.0, NumClients);
+	OnTransitionComplete.Broadcast(bTransitionToMatch, Elapsed);
+}
+
+ULevelStreaming* FBYGStreamingLobby::FindLevel(UWorld* World, bool bMatch) const
+{
+	const FString& LevelName = bMatch ? Subsystem->StreamingMatchLevel : Subsystem->StreamingLobbyLevel;
+	return UGameplayStatics::GetStreamingLevel(World, FName(*LevelName));
+}
+
+void FBYGStreamingLobby::SetLevelStreaming(UWorld* World, ULevelStreaming* Level, bool bShouldBeLoaded, bool bShouldBeVisible) const
+{
+	Level->SetShouldBeLoaded(bShouldBeLoaded);
+	Level->SetShouldBeVisible(bShouldBeVisible);
+
+	const FName PackageName = Level->GetWorldAssetPackageFName();
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PC = It->Get();
+		if (PC && !PC->IsLocalController())
+		{
+			PC->ClientUpdateLevelStreamingStatus(PC->NetworkRemapPath(PackageName, false), bShouldBeLoaded, bShouldBeVisible, false, INDEX_NONE);
+		}
+	}
+}
+
+int32 FBYGStreamingLobby::CountReadyClients(UWorld* World, ULevelStreaming* Level, int32& OutNumClients) const
+{
+	// Clients tell the server when they've made a level visible, that's all the readiness we need
+	const FName PackageName = Level->GetWorldAssetPackageFName();
+	int32 NumReady = 0;
+	OutNumClients = 0;
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		const UNetConnection* Connection = PC ? PC->GetNetConnection() : nullptr;
+		if (!Connection || PC->IsLocalController())
+		{
+			continue;
+		}
+		++OutNumClients;
+		if (Connection->ClientVisibleLevelNames.Contains(PackageName))
+		{
+			++NumReady;
+		}
+	}
+	return NumReady;
+}
@@ -0,0 +1,308 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#include "BYGTravelProfiler.h"
+#include "BYGMultiplayerSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+#include "UObject/UObjectGlobals.h"
+
+void FBYGTravelProfiler::Init(UBYGMultiplayerSubsystem* InSubsystem)
+{
+	Subsystem = InSubsystem;
+	PreLoadMapHandle = FCoreUObjectDelegates::PreLoadMap.AddRaw(this, &FBYGTravelProfiler::OnPreLoadMap);
+	PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddRaw(this, &FBYGTravelProfiler::OnPostLoadMap);
+	PreWorldInitHandle = FWorldDelegates::OnPreWorldInitialization.AddRaw(this, &FBYGTravelProfiler::OnPreWorldInit);
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(this, &FBYGTravelProfiler::OnPostGarbageCollect);
+	SeamlessTravelStartHandle = FWorldDelegates::OnSeamlessTravelStart.AddRaw(this, &FBYGTravelProfiler::OnSeamlessTravelStart);
+}
+
+void FBYGTravelProfiler::Deinit()
+{
+	FCoreUObjectDelegates::PreLoadMap.Remove(PreLoadMapHandle);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+	FWorldDelegates::OnPreWorldInitialization.Remove(PreWorldInitHandle);
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+	FWorldDelegates::OnSeamlessTravelStart.Remove(SeamlessTravelStartHandle);
+	bIsProfiling = false;
+	Subsystem = nullptr;
+}
+
+UWorld* FBYGTravelProfiler::GetWorld() const
+{
+	return Subsystem && Subsystem->GetGameInstance() ? Subsystem->GetGameInstance()->GetWorld() : nullptr;
+}
+
+const TCHAR* FBYGTravelProfiler::GetPhaseName(EBYGTravelPhase InPhase)
+{
+	switch (InPhase)
+	{
+	case EBYGTravelPhase::Teardown:
+		return TEXT("Teardown");
+	case EBYGTravelPhase::Load:
+		return TEXT("Load");
+	case EBYGTravelPhase::WorldInit:
+		return TEXT("WorldInit");
+	case EBYGTravelPhase::Handshake:
+		return TEXT("Handshake");
+	case EBYGTravelPhase::FirstFrame:
+		return TEXT("FirstFrame");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
+FString FBYGTravelProfiler::GetHistoryFilename()
+{
+	return FPaths::ProjectSavedDir() / TEXT("BYGMultiplayer") / TEXT("TravelHistory.csv");
+}
+
+void FBYGTravelProfiler::Begin(const FString& Reason, const FString& MapName)
+{
+	if (!Subsystem || !Subsystem->bProfileTravel)
+	{
+		return;
+	}
+	if (bIsProfiling)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Travel to '%s' started before the last one finished"), *MapName);
+		Finish(false);
+	}
+
+	bIsProfiling = true;
+	bLoadStarted = false;
+	Phase = EBYGTravelPhase::Teardown;
+	StartTime = FPlatformTime::Seconds();
+	LastHeartbeat = StartTime;
+	DestinationShortName = MapName.IsEmpty() ? FString() : FPackageName::GetShortName(MapName);
+	Pending = FBYGTravelProfile();
+	Pending.Timestamp = FDateTime::Now();
+	Pending.BuildVersion = FApp::GetBuildVersion();
+	Pending.BuildId = GetBuildUniqueId();
+	Pending.MapName = MapName;
+	Pending.Reason = Reason;
+}
+
+void FBYGTravelProfiler::Abort()
+{
+	if (bIsProfiling)
+	{
+		Finish(false);
+	}
+}
+
+void FBYGTravelProfiler::Heartbeat()
+{
+	const double Now = FPlatformTime::Seconds();
+	const double Gap = Now - LastHeartbeat;
+	Pending.PhaseSeconds[(int32)Phase] += Gap;
+	Pending.PhaseHitchSeconds[(int32)Phase] = FMath::Max(Pending.PhaseHitchSeconds[(int32)Phase], Gap);
+	LastHeartbeat = Now;
+}
+
+void FBYGTravelProfiler::Enter(EBYGTravelPhase NewPhase)
+{
+	Heartbeat();
+	if (NewPhase != Phase)
+	{
+		UE_LOG(LogBYGMultiplayer, Verbose, TEXT("Travel phase %s after %.0fms"), GetPhaseName(NewPhase), (LastHeartbeat - StartTime) * 1000.0);
+		Phase = NewPhase;
+		PhaseStartFrame = GFrameCounter;
+	}
+}
+
+bool FBYGTravelProfiler::IsDestination(const UWorld* World) const
+{
+	if (!World || !World->IsGameWorld())
+	{
+		return false;
+	}
+	// Joins don't know where they're going until the load starts
+	return DestinationShortName.IsEmpty()
+		|| FPackageName::GetShortName(UWorld::RemovePIEPrefix(World->GetOutermost()->GetName())) == DestinationShortName;
+}
+
+bool FBYGTravelProfiler::HasPendingNetGame() const
+{
+	const FWorldContext* Context = Subsystem->GetGameInstance() ? Subsystem->GetGameInstance()->GetWorldContext() : nullptr;
+	return Context && Context->PendingNetGame;
+}
+
+bool FBYGTravelProfiler::HasReplicatedPlayer() const
+{
+	UWorld* World = GetWorld();
+	const APlayerController* PC = World ? Subsystem->GetGameInstance()->GetFirstLocalPlayerController(World) : nullptr;
+	return PC && PC->GetWorld() == World && PC->PlayerState;
+}
+
+void FBYGTravelProfiler::OnPreLoadMap(const FString& MapName)
+{
+	if (!bIsProfiling)
+	{
+		// Every PIE instance hears every other instance's loads, there we only follow travels we started
+		if (GIsEditor)
+		{
+			return;
+		}
+		Begin(TEXT("Travel"), MapName);
+		if (!bIsProfiling)
+		{
+			return;
+		}
+	}
+	Enter(EBYGTravelPhase::Teardown);
+	bLoadStarted = true;
+	DestinationShortName = FPackageName::GetShortName(MapName);
+	if (Pending.MapName.IsEmpty())
+	{
+		Pending.MapName = MapName;
+	}
+}
+
+void FBYGTravelProfiler::OnPostGarbageCollect()
+{
+	// LoadMap collects the old world right before it loads the new one
+	if (bIsProfiling && bLoadStarted && Phase == EBYGTravelPhase::Teardown)
+	{
+		Enter(EBYGTravelPhase::Load);
+	}
+}
+
+void FBYGTravelProfiler::OnPreWorldInit(UWorld* World, const UWorld::InitializationValues IVS)
+{
+	// Seamless travel initializes the transition map on the way, that's still loading as far as we're concerned
+	if (bIsProfiling && bLoadStarted && IsDestination(World))
+	{
+		Enter(EBYGTravelPhase::WorldInit);
+	}
+}
+
+void FBYGTravelProfiler::OnPostLoadMap(UWorld* World)
+{
+	if (!bIsProfiling || !bLoadStarted || World != GetWorld() || !IsDestination(World))
+	{
+		return;
+	}
+	Enter(World->GetNetMode() == NM_Client && !HasReplicatedPlayer() ? EBYGTravelPhase::Handshake : EBYGTravelPhase::FirstFrame);
+}
+
+void FBYGTravelProfiler::OnSeamlessTravelStart(UWorld* World, const FString& MapName)
+{
+	if (!World || World != GetWorld())
+	{
+		return;
+	}
+	if (!bIsProfiling)
+	{
+		Begin(TEXT("Seamless"), MapName);
+		if (!bIsProfiling)
+		{
+			return;
+		}
+	}
+	// The old world stays up while the new one loads in the background, there's no separate teardown
+	bLoadStarted = true;
+	DestinationShortName = FPackageName::GetShortName(MapName);
+	Enter(EBYGTravelPhase::Load);
+}
+
+void FBYGTravelProfiler::Tick()
+{
+	if (!bIsProfiling)
+	{
+		return;
+	}
+
+	if (Phase == EBYGTravelPhase::FirstFrame)
+	{
+		// We may be ticked later in the same frame the map loaded in, wait until a whole one has gone by
+		if (GFrameCounter > PhaseStartFrame)
+		{
+			Finish(true);
+		}
+		else
+		{
+			Heartbeat();
+		}
+		return;
+	}
+	if (!bLoadStarted)
+	{
+		Enter(HasPendingNetGame() ? EBYGTravelPhase::Handshake : EBYGTravelPhase::Teardown);
+	}
+	else if (Phase == EBYGTravelPhase::Handshake && HasReplicatedPlayer())
+	{
+		Enter(EBYGTravelPhase::FirstFrame);
+	}
+	else
+	{
+		Heartbeat();
+	}
+
+	if (LastHeartbeat - StartTime > Subsystem->TravelProfileTimeout)
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Gave up profiling the travel to '%s' in %s"), *Pending.MapName, GetPhaseName(Phase));
+		Finish(false);
+	}
+}
+
+void FBYGTravelProfiler::Finish(bool bCompleted)
+{
+	Heartbeat();
+	bIsProfiling = false;
+	Pending.bCompleted = bCompleted;
+	Pending.TotalSeconds = LastHeartbeat - StartTime;
+
+	FString Breakdown;
+	for (int32 i = 0; i < (int32)EBYGTravelPhase::Num; ++i)
+	{
+		Breakdown += FString::Printf(TEXT(" %s %.0fms (hitch %.0fms)"), GetPhaseName((EBYGTravelPhase)i), Pending.PhaseSeconds[i] * 1000.0, Pending.PhaseHitchSeconds[i] * 1000.0);
+	}
+	UE_LOG(LogBYGMultiplayer, Log, TEXT("%s to '%s' %s in %.0fms:%s"), *Pending.Reason, *Pending.MapName,
+		bCompleted ? TEXT("finished") : TEXT("failed"), Pending.TotalSeconds * 1000.0, *Breakdown);
+
+	if (Subsystem->bSaveTravelHistory)
+	{
+		AppendToHistoryFile(Pending);
+	}
+	History.Add(Pending);
+	if (History.Num() > FMath::Max(Subsystem->TravelHistorySize, 1))
+	{
+		History.RemoveAt(0, History.Num() - FMath::Max(Subsystem->TravelHistorySize, 1));
+	}
+	OnTravelProfiled.Broadcast(History.Last());
+}
+
+void FBYGTravelProfiler::AppendToHistoryFile(const FBYGTravelProfile& Profile) const
+{
+	const FString Filename = GetHistoryFilename();
+	FString Output;
+	if (!FPaths::FileExists(Filename))
+	{
+		Output += TEXT("Timestamp,BuildVersion,BuildId,Map,Reason,Completed,TotalMs");
+		for (int32 i = 0; i < (int32)EBYGTravelPhase::Num; ++i)
+		{
+			Output += FString::Printf(TEXT(",%sMs,%sHitchMs"), GetPhaseName((EBYGTravelPhase)i), GetPhaseName((EBYGTravelPhase)i));
+		}
+		Output += LINE_TERMINATOR;
+	}
+	Output += FString::Printf(TEXT("%s,%s,%d,%s,%s,%d,%.1f"), *Profile.Timestamp.ToIso8601(), *Profile.BuildVersion, Profile.BuildId,
+		*FPackageName::GetShortName(Profile.MapName), *Profile.Reason, Profile.bCompleted ? 1 : 0, Profile.TotalSeconds * 1000.0);
+	for (int32 i = 0; i < (int32)EBYGTravelPhase::Num; ++i)
+	{
+		Output += FString::Printf(TEXT(",%.1f,%.1f"), Profile.PhaseSeconds[i] * 1000.0, Profile.PhaseHitchSeconds[i] * 1000.0);
+	}
+	Output += LINE_TERMINATOR;
+
+	if (!FFileHelper::SaveStringToFile(Output, *Filename, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append))
+	{
+		UE_LOG(LogBYGMultiplayer, Warning, TEXT("Failed to append to travel history '%s'"), *Filename);
+	}
+}
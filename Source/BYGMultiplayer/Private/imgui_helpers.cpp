@@ -1,5 +1,7 @@
 ﻿#include "imgui_helpers.h"
 
+#if WITH_IMGUI
+
 // dear imgui: wrappers for C++ standard library (STL) types (std::string, etc.)
 // This is also an example of how you may wrap your own similar types.
 
@@ -95,3 +97,5 @@ bool ImGui::InputTextWithHint(const char* label, const char* hint, std::string*
     cb_user_data.ChainCallbackUserData = user_data;
     return InputTextWithHint(label, hint, (char*)str->c_str(), str->capacity() + 1, flags, InputTextCallback, &cb_user_data);
 }
+
+#endif // WITH_IMGUI
@@ -11,9 +11,11 @@
 #pragma once
 
 #include "ImGuiCommon.h"
-#include "ThirdParty/ImGuiLibrary/Private/imgui_internal.h"
 #include "CoreMinimal.h"
 
+#if WITH_IMGUI
+#include "ThirdParty/ImGuiLibrary/Private/imgui_internal.h"
+
 #include <string>
 
 namespace ImGui
@@ -59,3 +61,5 @@ static void TextCentered(const char* fmt)
 	ImGui::Text(fmt);
 }
 }
+
+#endif // WITH_IMGUI
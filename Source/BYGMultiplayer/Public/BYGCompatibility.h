@@ -0,0 +1,45 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Whether we can play on a host, worked out from what it advertises, so joins that are bound to fail are caught
+// before they start instead of at the end of the join and travel.
+//
+// Hosts advertise their build id, the project's content version (UBYGMultiplayerSubsystem::ContentVersion) and the
+// lobby and match maps they have. Clients compare the first two with their own and check they have both maps.
+// Results that don't match are flagged in the search, and JoinSession refuses them unless bRefuseIncompatibleSessions
+// is turned off. Hosts that advertise none of it are assumed to be compatible.
+//
+// The content version is whatever the project bumps when it ships content that can't play with the old one, e.g. a
+// DLC or patch id. It is the same across platforms and between client and server cooks, which package bytes aren't.
+// Whether a map exists is looked up once per map name and remembered.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineSessionSettings.h"
+
+enum class EBYGCompatibility : uint8
+{
+	// Or the host didn't say
+	Compatible,
+	BuildMismatch,
+	ContentMismatch,
+	// We don't have the host's lobby or match map
+	MissingMap
+};
+
+struct BYGMULTIPLAYER_API FBYGCompatibility
+{
+	// Adds our build id, and unless bContentVersion is false our content version
+	static void Advertise(FOnlineSessionSettings& Settings, bool bContentVersion);
+
+	// Thread-safe, only compares what the host advertised with our own
+	static EBYGCompatibility Check(const FOnlineSessionSearchResult& Result);
+
+	// From config, empty if the project doesn't set one. Thread-safe.
+	static const FString& GetContentVersion();
+
+	// Whether we have a map package, by long or short package name. Empty names count as present. Thread-safe.
+	static bool HasMap(const FString& MapName);
+
+	static const TCHAR* GetName(EBYGCompatibility Compatibility);
+};
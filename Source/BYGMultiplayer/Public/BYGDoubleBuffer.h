@@ -0,0 +1,91 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Optional.h"
+#include <atomic>
+
+// Lock-free single-writer, multi-reader double buffer.
+//
+// The writer (the game thread, for everything in this plugin) publishes into the back slot and flips it to the front.
+// Readers on any thread copy the front slot out while holding a per-slot reader count, so the writer never overwrites
+// a slot somebody is reading. If readers are still holding the back slot, Publish() keeps the value and returns false
+// instead of waiting; call Flush() later (the subsystem does so every tick) to finish publishing it.
+//
+// T should be cheap to copy and immutable once published, e.g. TSharedRef<const Foo, ESPMode::ThreadSafe>.
+template<typename T>
+class TBYGDoubleBuffer
+{
+public:
+	explicit TBYGDoubleBuffer(const T& Initial)
+		: Slots{ FSlot(Initial), FSlot(Initial) }
+	{
+	}
+
+	TBYGDoubleBuffer(const TBYGDoubleBuffer&) = delete;
+	TBYGDoubleBuffer& operator=(const TBYGDoubleBuffer&) = delete;
+
+	// Any thread. Never blocks, only retries if the writer flipped while we were acquiring the slot.
+	T Read() const
+	{
+		for (;;)
+		{
+			const int32 Index = FrontIndex.load();
+			const FSlot& Slot = Slots[Index];
+			Slot.Readers.fetch_add(1);
+			if (FrontIndex.load() == Index)
+			{
+				T Result = Slot.Value;
+				Slot.Readers.fetch_sub(1);
+				return Result;
+			}
+			Slot.Readers.fetch_sub(1);
+		}
+	}
+
+	// Writer thread only. Replaces any value still waiting to be published.
+	bool Publish(const T& Value)
+	{
+		Pending = Value;
+		return Flush();
+	}
+
+	// Writer thread only. Returns true if there is nothing left to publish.
+	bool Flush()
+	{
+		if (!Pending.IsSet())
+		{
+			return true;
+		}
+
+		const int32 BackIndex = 1 - FrontIndex.load();
+		FSlot& Back = Slots[BackIndex];
+		if (Back.Readers.load() != 0)
+		{
+			return false;
+		}
+
+		Back.Value = MoveTemp(Pending.GetValue());
+		Pending.Reset();
+		FrontIndex.store(BackIndex);
+		return true;
+	}
+
+	bool HasPending() const { return Pending.IsSet(); }
+
+private:
+	struct alignas(PLATFORM_CACHE_LINE_SIZE) FSlot
+	{
+		explicit FSlot(const T& InValue) : Value(InValue) {}
+		// Only used while constructing the buffer, before anyone can be reading it
+		FSlot(const FSlot& Other) : Value(Other.Value) {}
+
+		T Value;
+		mutable std::atomic<int32> Readers{ 0 };
+	};
+
+	FSlot Slots[2];
+	std::atomic<int32> FrontIndex{ 0 };
+	TOptional<T> Pending;
+};
@@ -0,0 +1,159 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Opt-in listen server host migration.
+//
+// The host spawns an ABYGSessionReplicatedInfo that replicates what's needed to recreate its session, plus a
+// successor list in join order. When the host drops, every client walks the same list: the first candidate re-hosts
+// the session on the same map, the others connect straight to its address without searching. If a candidate doesn't
+// come up in time, everyone moves on to the next one.
+//
+// Candidates are identified by a token passed in the join URL, and reached at the address the old host saw them on
+// plus the port they would listen on (-port=). That works on a LAN or on localhost, e.g. one host and two clients:
+//
+//   MyGame -log -BYGHostMigration -port=7777
+//   MyGame -log -BYGHostMigration -port=7778
+//   MyGame -log -BYGHostMigration -port=7779
+//
+// Clients behind NAT can't be reached this way, so it doesn't help for internet sessions without a relay.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "BYGHostMigration.generated.h"
+
+class UBYGMultiplayerSubsystem;
+
+USTRUCT()
+struct BYGMULTIPLAYER_API FBYGMigrationSettings
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FString ServerName;
+	UPROPERTY()
+	FString PublicMapName;
+	// Long package name of the map the host was on
+	UPROPERTY()
+	FString MapPath;
+	UPROPERTY()
+	int32 NumPublicConnections = 0;
+	UPROPERTY()
+	bool bIsLANMatch = false;
+
+	bool operator==(const FBYGMigrationSettings& Other) const
+	{
+		return ServerName == Other.ServerName && PublicMapName == Other.PublicMapName && MapPath == Other.MapPath
+			&& NumPublicConnections == Other.NumPublicConnections && bIsLANMatch == Other.bIsLANMatch;
+	}
+};
+
+USTRUCT()
+struct BYGMULTIPLAYER_API FBYGMigrationCandidate
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FString Token;
+	UPROPERTY()
+	FString Address;
+	UPROPERTY()
+	int32 Port = 0;
+
+	bool operator==(const FBYGMigrationCandidate& Other) const
+	{
+		return Token == Other.Token && Address == Other.Address && Port == Other.Port;
+	}
+};
+
+UCLASS(NotPlaceable, NotBlueprintable)
+class BYGMULTIPLAYER_API ABYGSessionReplicatedInfo : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ABYGSessionReplicatedInfo();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	UPROPERTY(ReplicatedUsing = OnRep_MigrationState)
+	FBYGMigrationSettings Settings;
+
+	// In the order clients will try them
+	UPROPERTY(ReplicatedUsing = OnRep_MigrationState)
+	TArray<FBYGMigrationCandidate> Successors;
+
+protected:
+	UFUNCTION()
+	void OnRep_MigrationState();
+};
+
+enum class EBYGMigrationPhase : uint8
+{
+	None,
+	// Lost the host, waiting for the engine to finish disconnecting us
+	WaitingForDisconnect,
+	// We're the successor and are hosting the session again
+	Rehosting,
+	// Giving the successor time to start listening
+	WaitingToRejoin,
+	Rejoining
+};
+
+class BYGMULTIPLAYER_API FBYGHostMigration
+{
+public:
+	void Init(UBYGMultiplayerSubsystem* InSubsystem);
+
+	bool IsEnabled() const;
+	EBYGMigrationPhase GetPhase() const { return Phase; }
+	bool IsMigrating() const { return Phase != EBYGMigrationPhase::None; }
+	static const TCHAR* GetPhaseName(EBYGMigrationPhase Phase);
+	// Wall-clock time from losing the host until we were hosting or connected again, 0 if we never migrated
+	double GetLastMigrationSeconds() const { return LastMigrationSeconds; }
+	const TArray<FBYGMigrationCandidate>& GetSuccessors() const { return CachedSuccessors; }
+	// Appended to the connect string when joining, so the host can put us in the successor list
+	FString GetJoinOptions() const;
+
+	void Tick(float DeltaTime);
+	void OnPostLoadMap(UWorld* World);
+	void OnStateReplicated(const ABYGSessionReplicatedInfo& Info);
+	// Returns true if migration is handling the failure
+	bool OnNetworkFailure(UWorld* World);
+	void OnTravelFailure();
+	// NAME_GameSession is gone, so a successor waiting to re-host can create it again
+	void OnSessionDestroyed();
+
+	// Time between a client losing the host and connecting to the successor, so the successor can start listening
+	float RejoinDelay = 2.0f;
+	// How long to wait on a candidate before moving on to the next one
+	float CandidateTimeout = 15.0f;
+
+protected:
+	UBYGMultiplayerSubsystem* Subsystem = nullptr;
+	const FString Token = FGuid::NewGuid().ToString();
+
+	EBYGMigrationPhase Phase = EBYGMigrationPhase::None;
+	double MigrationStartTime = 0.0;
+	double PhaseStartTime = 0.0;
+	double LastMigrationSeconds = 0.0;
+	int32 CandidateIndex = 0;
+
+	FBYGMigrationSettings CachedSettings;
+	TArray<FBYGMigrationCandidate> CachedSuccessors;
+
+	// Host side
+	TWeakObjectPtr<ABYGSessionReplicatedInfo> HostInfo;
+	double NextSuccessorRefreshTime = 0.0;
+	void TickHost(UWorld* World);
+	void RefreshSuccessors(UWorld* World, ABYGSessionReplicatedInfo* Info) const;
+
+	void SetPhase(EBYGMigrationPhase NewPhase);
+	void TryCurrentCandidate();
+	// We're the successor but the old session is still being destroyed
+	bool bRehostPending = false;
+	void Rehost();
+	void NextCandidate();
+	void Finish(bool bSucceeded);
+	UWorld* GetWorld() const;
+};
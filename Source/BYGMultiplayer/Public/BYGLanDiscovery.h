@@ -0,0 +1,106 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// LAN discovery with our own small UDP packets instead of the NULL subsystem's LAN query.
+//
+// Hosts of LAN sessions listen on the first free port in [Port, Port + PortRange). Searching clients send a 10 byte
+// query to every port in that range on the broadcast address, every BroadcastInterval, and each host answers with
+// one packet holding just what the server browser shows. Hosts answer any one address at most once per
+// ResponseInterval and everyone at most MaxResponsesPerSecond times a second, so a hall full of clients searching at
+// once can't flood them. Responders are handed to the search as they arrive instead of after a fixed timeout.
+//
+// Since every host gets its own port, several of them can run on one machine. Set Address to 127.0.0.1 (or run with
+// -BYGLanDiscoveryAddress=127.0.0.1) to find them over loopback.
+//
+// Packets are little-endian. Both start with the magic "BYGL", a version byte, a type byte and the query's nonce.
+// Queries are just that header, so hosts answer every build and clients check compatibility themselves. Responses
+// add the session's guid, game port, beacon port, open and max slots, build id, a flags byte, the host's net
+// coordinate and its error, then the server name, public map name, content version, lobby map and match map as UTF-8
+// with a length byte, cut at a character boundary. The last three may be empty, see BYGCompatibility.h. Anything with
+// the wrong magic or version is dropped.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineSessionSettings.h"
+
+class UBYGMultiplayerSubsystem;
+class FSocket;
+class FInternetAddr;
+
+class BYGMULTIPLAYER_API FBYGLanDiscovery
+{
+public:
+	// What results found this way report as their subsystem, and what to put in FBYGSearchSource::Subsystem
+	static const FName SubsystemName;
+	static const uint8 Version = 4;
+
+	void Init(UBYGMultiplayerSubsystem* InSubsystem);
+	void Deinit();
+	bool IsEnabled() const;
+
+	void Tick();
+
+	// Client. Searches for SearchDuration seconds, or until StopSearch().
+	bool StartSearch();
+	void StopSearch();
+	bool IsSearching() const { return ClientSocket != nullptr; }
+	// Moves out responders that arrived since the last call
+	void ConsumeResults(TArray<FOnlineSessionSearchResult>& OutResults);
+
+	// Host. Started and stopped from Tick() while hosting a LAN session.
+	bool IsResponding() const { return HostSocket != nullptr; }
+	int32 GetHostPort() const { return HostPort; }
+	int32 GetNumQueriesAnswered() const { return NumQueriesAnswered; }
+	int32 GetNumQueriesDropped() const { return NumQueriesDropped; }
+
+	int32 Port = 14001;
+	int32 PortRange = 8;
+	FString Address = TEXT("255.255.255.255");
+	float BroadcastInterval = 0.5f;
+	float SearchDuration = 2.0f;
+	float ResponseInterval = 0.25f;
+	int32 MaxResponsesPerSecond = 64;
+
+protected:
+	UBYGMultiplayerSubsystem* Subsystem = nullptr;
+
+	enum class EPacketType : uint8
+	{
+		Query = 1,
+		Response = 2
+	};
+
+	FSocket* HostSocket = nullptr;
+	int32 HostPort = 0;
+	// Only try once per world, ports that are taken now will still be taken next tick
+	TWeakObjectPtr<UWorld> HostAttemptWorld;
+	FGuid HostSessionGuid;
+	// When each address was last answered, pruned as entries go stale
+	TMap<FString, double> LastResponseTimes;
+	double ResponseWindowStart = 0.0;
+	int32 ResponsesInWindow = 0;
+	int32 NumQueriesAnswered = 0;
+	int32 NumQueriesDropped = 0;
+	void StartResponding();
+	void StopResponding();
+	void TickHost();
+	bool ShouldRespond(const FString& FromAddress, double Now);
+	void WriteResponse(TArray<uint8>& OutPacket, uint32 Nonce) const;
+
+	FSocket* ClientSocket = nullptr;
+	double SearchStartTime = 0.0;
+	double NextBroadcastTime = 0.0;
+	// Random per search, so responses to an old search aren't mistaken for ours
+	uint32 NonceBase = 0;
+	// Send time of each query, so responses give us a round trip
+	TMap<uint32, double> QueryTimes;
+	TSet<FGuid> KnownSessions;
+	TArray<FOnlineSessionSearchResult> NewResults;
+	void TickClient();
+	void Broadcast(double Now);
+	bool ReadResponse(const uint8* Packet, int32 Size, const FString& FromAddress, double Now);
+
+	static FSocket* CreateSocket(int32 BindPort, bool bBroadcast);
+	static void DestroySocket(FSocket*& Socket);
+	UWorld* GetWorld() const;
+};
@@ -0,0 +1,113 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Searching several backends, or several kinds of query, at once.
+//
+// Each FBYGSearchSource is one search: an online subsystem, and whether to search the LAN or via presence. Sources on
+// different subsystems run in parallel, so a LAN search on NULL and an internet search on Steam take as long as the
+// slower of the two instead of both timeouts back to back. A session interface only runs one search at a time, so
+// sources sharing a subsystem run one after the other.
+//
+// Results are merged into one FOnlineSessionSearch as each source completes. A result with the same session id or
+// connect address as one that's already in, e.g. a host found both through presence and the server list, only keeps
+// whichever has the lower ping. Each result is tagged with the source that found it, see BYGSessionKeys::SearchSource.
+// Past UBYGMultiplayerSubsystem::MaxRetainedSearchResults, new results are dropped, so indices into the results stay
+// valid while the search runs. Put the sources you'd rather keep results from first.
+//
+// A source with the subsystem BYGLAN uses FBYGLanDiscovery instead of an online subsystem. Its responders are merged
+// in as they arrive rather than when the search ends.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Interfaces/OnlineSessionInterface.h"
+#include "BYGMultiSearch.generated.h"
+
+class UBYGMultiplayerSubsystem;
+class FOnlineSessionSearch;
+
+USTRUCT()
+struct BYGMULTIPLAYER_API FBYGSearchSource
+{
+	GENERATED_BODY()
+
+	// e.g. NULL, STEAM or BYGLAN. None for the subsystem currently in use.
+	UPROPERTY(Config)
+	FName Subsystem;
+
+	UPROPERTY(Config)
+	bool bLAN = false;
+
+	UPROPERTY(Config)
+	bool bPresence = false;
+
+	// Shown with every result it finds. Defaults to the subsystem and query, e.g. "NULL LAN".
+	UPROPERTY(Config)
+	FString Label;
+};
+
+// bWasSuccessful if any source succeeded
+DECLARE_DELEGATE_OneParam(FOnBYGMultiSearchComplete, bool /*bWasSuccessful*/);
+
+class BYGMULTIPLAYER_API FBYGMultiSearch
+{
+public:
+	void Init(UBYGMultiplayerSubsystem* InSubsystem);
+
+	// Searches every one of Sources and merges what they find into Results.
+	// Returns false if not a single source could be started, in which case Results is marked as failed.
+	bool Start(const TSharedRef<FOnlineSessionSearch>& Results, const TArray<FBYGSearchSource>& Sources);
+	// Stops any searches still running. Results merged so far are left as they are.
+	void Cancel();
+	bool IsSearching() const { return bSearching; }
+
+	void Tick();
+
+	// Every time a source's results have been merged in
+	FSimpleDelegate OnResultsMerged;
+	// Once every source is done, after which Results isn't modified again
+	FOnBYGMultiSearchComplete OnComplete;
+
+	// Subsystem a merged result was found on, None for results that didn't come from a multi-search
+	static FName GetResultSubsystem(const FOnlineSessionSearchResult& Result);
+	static FString GetLabel(const FBYGSearchSource& Source, FName SubsystemName);
+
+protected:
+	UBYGMultiplayerSubsystem* Subsystem = nullptr;
+
+	// Sources on the same subsystem, searched one at a time
+	struct FGroup
+	{
+		FName SubsystemName;
+		// Invalid for LAN discovery
+		IOnlineSessionPtr SessionInterface;
+		TArray<FBYGSearchSource> Sources;
+		int32 Current = INDEX_NONE;
+		TSharedPtr<FOnlineSessionSearch> Search;
+		FDelegateHandle CompleteHandle;
+		double SourceStartTime = 0.0;
+		// Set by the completion callback, the results are merged on the next tick
+		bool bSourceComplete = false;
+		bool bSourceSucceeded = false;
+
+		bool IsFinished() const { return Current >= Sources.Num(); }
+		bool IsLanDiscovery() const { return !SessionInterface.IsValid(); }
+	};
+	TArray<FGroup> Groups;
+	TSharedPtr<FOnlineSessionSearch> Merged;
+	// "Id:" and "Address:" keys of everything merged so far, to its index in Merged
+	TMap<FString, int32> KnownResults;
+	bool bSearching = false;
+	bool bAnySucceeded = false;
+	int32 NumDuplicates = 0;
+	// Dropped because we already had UBYGMultiplayerSubsystem::MaxRetainedSearchResults
+	int32 NumCapped = 0;
+	double StartTime = 0.0;
+
+	void StartNextSource(int32 GroupIndex);
+	void OnSourceComplete(bool bWasSuccessful, int32 GroupIndex);
+	// Returns true if any responders came in
+	bool TickLanDiscovery(FGroup& Group);
+	void MergeSource(FGroup& Group);
+	void MergeResults(const FGroup& Group, TArray<FOnlineSessionSearchResult>& Results, int32& OutNumAdded);
+	void Finish();
+};
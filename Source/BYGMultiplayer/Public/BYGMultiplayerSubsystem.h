@@ -9,6 +9,12 @@
 // Under the hood:
 // Create Session => Join Session => Start Session
 
+// Threading:
+// Everything on UBYGMultiplayerSubsystem is game thread only, including the public fields, unless its name ends in
+// _AnyThread. The _AnyThread functions return immutable snapshots that are published without locks (see
+// TBYGDoubleBuffer), so analytics or matchmaking code on task graph workers can read them without marshalling back
+// to the game thread. Snapshots may lag the game thread by a frame if a reader was holding the previous one.
+
 #pragma once
 
 #include "CoreMinimal.h"
@@ -16,13 +22,32 @@
 #include "Interfaces/OnlineSessionInterface.h"
 #include "Interfaces/OnlineIdentityInterface.h"
 #include "OnlineSessionSettings.h"
+#include "Containers/Ticker.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Runtime/Launch/Resources/Version.h"
 #include "ImGuiCommon.h"
+#include "BYGNetStats.h"
+#include "BYGNetProfile.h"
+#include "BYGHostMigration.h"
+#include "BYGReservationBeacon.h"
+#include "BYGSeamlessTravel.h"
+#include "BYGTravelProfiler.h"
+#include "BYGStreamingLobby.h"
+#include "BYGMultiSearch.h"
+#include "BYGLanDiscovery.h"
+#include "BYGCompatibility.h"
+#include "BYGNetCoordinate.h"
+#include "BYGServerHistory.h"
+#include "BYGSessionRecorder.h"
+#include "BYGSessionSnapshot.h"
+#include "BYGSearchResults.h"
+#include "BYGSearchPool.h"
+#include "BYGSessionKeys.h"
+#include "BYGDoubleBuffer.h"
 #include "BYGMultiplayerSubsystem.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogBYGMultiplayer, Log, All);
 
-#define SETTING_SERVER_NAME FName(TEXT("SERVER_NAME"))
-
 // Creates sensible defaults and exposes some more functionality in a nicer way
 struct FBYGOnlineSessionSettings : public FOnlineSessionSettings
 {
@@ -36,7 +61,8 @@ public:
 		bUsesPresence = true;
 		bAllowJoinInProgress = true;
 		bAllowJoinViaPresence = true;
-		NumPrivateConnections = true;
+		// Only handed out through party reservations, see ReservePartySlots()
+		NumPrivateConnections = 0;
 		bAllowInvites = true;
 		bAntiCheatProtected = false;
 		bAllowJoinViaPresenceFriendsOnly = false;
@@ -45,6 +71,7 @@ public:
 		LobbyMapName = "MP_Lobby";
 		MapArguments = {};
 		bTravelAbsolute = true;
+		bAdvertiseContentVersion = true;
 	}
 	FOnlineSessionSettings GetSessionSettings() const
 	{
@@ -60,27 +87,66 @@ public:
 		BaseSettings.bUsesPresence = bUsesPresence;
 		BaseSettings.bAllowJoinInProgress = bAllowJoinInProgress;
 		BaseSettings.bAllowJoinViaPresence = bAllowJoinViaPresence;
-		BaseSettings.bUseLobbiesIfAvailable = true;
-		BaseSettings.Set<FString>(SETTING_MAPNAME, TargetPublicFacingMapName, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		// Lobbies belong to a user, dedicated servers don't have one
+		BaseSettings.bUseLobbiesIfAvailable = !bIsDedicated;
+		// Anything the game added with the typed Set
+		BaseSettings.Settings = Settings;
+		BYGSessionKeys::MapName.Set(BaseSettings, TargetPublicFacingMapName);
 		// Custom but we can standardize it
-		BaseSettings.Set<FString>(SETTING_SERVER_NAME, ServerName, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		BYGSessionKeys::ServerName.Set(BaseSettings, ServerName);
+		// Only maps we have, so clients without them find out before joining. See BYGCompatibility.h
+		if (FBYGCompatibility::HasMap(LobbyMapName.ToString()))
+		{
+			BYGSessionKeys::LobbyMap.Set(BaseSettings, LobbyMapName.ToString());
+		}
+		if (FBYGCompatibility::HasMap(TargetMapName.ToString()))
+		{
+			BYGSessionKeys::MatchMap.Set(BaseSettings, TargetMapName.ToString());
+		}
+		FBYGCompatibility::Advertise(BaseSettings, bAdvertiseContentVersion);
 		return BaseSettings;
 	}
+	// Typed custom settings, advertised along with everything else. See BYGSessionKeys.h
+	using FOnlineSessionSettings::Set;
+	using FOnlineSessionSettings::Get;
+	template<typename T>
+	void Set(const TBYGSessionKey<T>& Key, const typename TIdentity<T>::Type& Value)
+	{
+		Key.Set(*this, Value);
+	}
+	template<typename T>
+	T Get(const TBYGSessionKey<T>& Key) const
+	{
+		return Key.Get(*this);
+	}
 	FString ServerName;
 	FString TargetPublicFacingMapName;
 	FName TargetMapName;
 	FName LobbyMapName;
 	TArray<FString> MapArguments;
 	bool bTravelAbsolute;
+	// Lets clients with different content see that before joining, see BYGCompatibility.h
+	bool bAdvertiseContentVersion;
+};
+
+enum class EBYGLoginState : uint8
+{
+	NotLoggedIn,
+	LoggingIn,
+	WaitingToRetry,
+	LoggedIn,
+	// Gave up after LoginMaxAttempts. Call Login() to try again.
+	Failed
 };
 
-UCLASS()
+UCLASS(Config = Game)
 class BYGMULTIPLAYER_API UBYGMultiplayerSubsystem : public UGameInstanceSubsystem
 {
 public:
 	GENERATED_BODY()
 public:
 	// Begin USubsystem
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
 	// End USubsystem
@@ -89,6 +155,41 @@ public:
 	void DrawDebug(bool* bIsOpen);
 #endif
 
+	// Set to false (or run with -NoBYGMultiplayer) to not create the subsystem at all.
+	// Handy for measuring what it costs at startup.
+	UPROPERTY(Config)
+	bool bEnabled = true;
+
+	// When true, the online subsystem and debug UI are only brought up on first use, or by calling Warmup().
+	// See [/Script/BYGMultiplayer.BYGMultiplayerSubsystem] in DefaultGame.ini
+	UPROPERTY(Config)
+	bool bDeferInitialization = false;
+
+	// Dedicated servers create, start and advertise a session as soon as they boot, using the AutoHost settings.
+	// -BYGAutoHost turns this on for any target, -NoBYGAutoHost turns it off.
+	UPROPERTY(Config)
+	bool bAutoHostDedicatedServer = true;
+	// Each of these can be overridden on the command line, e.g. -BYGServerName="EU 3" -BYGMaxPlayers=32 -BYGLAN
+	UPROPERTY(Config)
+	FString AutoHostServerName = TEXT("Dedicated Server");
+	UPROPERTY(Config)
+	int32 AutoHostMaxPlayers = 16;
+	// -BYGMap=. Leave empty to stay on the map the server booted into.
+	UPROPERTY(Config)
+	FString AutoHostMap;
+	// -BYGPublicMapName=. Defaults to AutoHostMap, or the current map.
+	UPROPERTY(Config)
+	FString AutoHostPublicMapName;
+	UPROPERTY(Config)
+	bool bAutoHostLAN = false;
+	bool ShouldAutoHost() const;
+
+	// Initializes over the next few frames, e.g. while a splash screen is up. Safe to call more than once.
+	void Warmup();
+	bool IsInitialized() const { return bCoreInitialized && bUIInitialized; }
+	// Total time spent initializing so far, in seconds
+	double GetInitializationTime() const { return InitializationSeconds; }
+
 	// Making this all public for now. be nice
 
 	bool bHostLAN = false;
@@ -104,8 +205,131 @@ public:
 	int32 FindMaxResults = 10;
 	int32 FindTimeout = 10;
 
-	//bool bIsLoggedIn = false;
-	//FString PlayerNickname = "(Unknown)";
+	// When set, FindSessions searches all of these at once instead of just the current subsystem with bFindLAN and
+	// bFindViaPresence, and merges the results. See BYGMultiSearch.h.
+	UPROPERTY(Config)
+	TArray<FBYGSearchSource> SearchSources;
+	FBYGMultiSearch MultiSearch;
+
+	// Hosts of LAN sessions answer our own compact discovery queries, and LAN searches use them instead of the NULL
+	// subsystem's. -BYGLanDiscovery turns it on. See BYGLanDiscovery.h.
+	UPROPERTY(Config)
+	bool bLanDiscovery = false;
+	// Hosts listen on the first free port from LanDiscoveryPort, searches query all of them
+	UPROPERTY(Config)
+	int32 LanDiscoveryPort = 14001;
+	UPROPERTY(Config)
+	int32 LanDiscoveryPortRange = 8;
+	// -BYGLanDiscoveryAddress=. 127.0.0.1 finds hosts on this machine only.
+	UPROPERTY(Config)
+	FString LanDiscoveryAddress = TEXT("255.255.255.255");
+	UPROPERTY(Config)
+	float LanDiscoveryBroadcastInterval = 0.5f;
+	UPROPERTY(Config)
+	float LanDiscoverySearchDuration = 2.0f;
+	// Hosts answer each address at most once per interval, and no more than the max per second overall
+	UPROPERTY(Config)
+	float LanDiscoveryResponseInterval = 0.25f;
+	UPROPERTY(Config)
+	int32 LanDiscoveryMaxResponsesPerSecond = 64;
+	FBYGLanDiscovery LanDiscovery;
+
+	// Login is kicked off when the online subsystem is initialized. Host and join requests made before it
+	// completes are queued and run once it does.
+	float LoginTimeout = 15.0f;
+	float LoginRetryDelay = 2.0f;
+	int32 LoginMaxAttempts = 3;
+
+	// When hosting, tune the net driver and actor update rates to the session's size and server type.
+	// The profile name is advertised with the session.
+	UPROPERTY(Config)
+	bool bApplyNetProfile = true;
+	// Checked in order, the first match is used. FBYGNetProfile::GetDefaults() is used if this is empty.
+	UPROPERTY(Config)
+	TArray<FBYGNetProfile> NetProfiles;
+	// Null unless we're hosting with a profile
+	const FBYGNetProfile* GetActiveNetProfile() const { return ActiveNetProfile.GetPtrOrNull(); }
+
+	// Hosted sessions with at least ReplicationGraphMinPlayers public connections replicate through a replication
+	// graph instead of checking every actor against every connection. Only applies to net drivers created afterwards.
+	UPROPERTY(Config)
+	bool bUseReplicationGraph = true;
+	UPROPERTY(Config)
+	int32 ReplicationGraphMinPlayers = 24;
+	// Defaults to UBYGReplicationGraph
+	UPROPERTY(Config)
+	TSoftClassPtr<class UReplicationGraph> ReplicationGraphClass;
+
+	// When a listen server host drops, its clients pick a successor to re-host the same session and everyone else
+	// reconnects to it. Off by default, -BYGHostMigration turns it on. See BYGHostMigration.h for the limitations.
+	UPROPERTY(Config)
+	bool bHostMigration = false;
+	UPROPERTY(Config)
+	float HostMigrationRejoinDelay = 2.0f;
+	UPROPERTY(Config)
+	float HostMigrationCandidateTimeout = 15.0f;
+	FBYGHostMigration HostMigration;
+
+	// Server only. Seamlessly travels everyone to OnlineSessionSettings.LobbyMapName or TargetMapName, keeping clients
+	// connected through the transition map. SeamlessTravel.OnTravelComplete reports how long each client took.
+	bool TravelToLobby();
+	bool TravelToMatch();
+	// While on the lobby or match map, load the other one in the background so travelling to it is quicker.
+	// Costs the memory of both maps while in either.
+	UPROPERTY(Config)
+	bool bPreloadTravelMaps = true;
+	// Overrides the project's Transition Map. Leave empty to use that, or an empty world if it has none.
+	UPROPERTY(Config)
+	FString TransitionMap;
+	// Clients that haven't loaded the new map after this many seconds are reported as missing
+	UPROPERTY(Config)
+	float TravelClientTimeout = 60.0f;
+	FBYGSeamlessTravel SeamlessTravel;
+
+	// Breaks every travel down by phase, see BYGTravelProfiler.h
+	UPROPERTY(Config)
+	bool bProfileTravel = true;
+	// Travels kept in TravelProfiler.GetHistory()
+	UPROPERTY(Config)
+	int32 TravelHistorySize = 32;
+	// Also append each one to Saved/BYGMultiplayer/TravelHistory.csv
+	UPROPERTY(Config)
+	bool bSaveTravelHistory = true;
+	// Travels that haven't finished after this many seconds are reported as failed
+	UPROPERTY(Config)
+	float TravelProfileTimeout = 120.0f;
+	FBYGTravelProfiler TravelProfiler;
+
+	// Host on one persistent map with the lobby and match as streaming sublevels, and have TravelToLobby() and
+	// TravelToMatch() stream between them instead of travelling. See BYGStreamingLobby.h.
+	UPROPERTY(Config)
+	bool bStreamingLobby = false;
+	// Short package names of the sublevels
+	UPROPERTY(Config)
+	FString StreamingLobbyLevel = TEXT("Lobby");
+	UPROPERTY(Config)
+	FString StreamingMatchLevel = TEXT("Match");
+	UPROPERTY(Config)
+	float StreamingReadyTimeout = 30.0f;
+	FBYGStreamingLobby StreamingLobby;
+
+	// Samples the world's net connections while enabled. See the "Net Stats" debug tab.
+	bool bNetStatsEnabled = false;
+	FBYGNetStatsSampler NetStats;
+
+	// Records calls and callbacks so they can be replayed later. Start with -BYGRecordSession to capture from boot,
+	// the recording is saved to Saved/BYGMultiplayer when the subsystem shuts down.
+	void StartRecording();
+	// Returns the file the recording was written to, or an empty string on failure
+	FString StopRecording(const FString& Filename = FString());
+	bool IsRecording() const { return Recorder.IsRecording(); }
+
+	// Feeds a recording back through our callbacks instead of the online subsystem. Speed of 0 runs as fast as possible.
+	// Can also be started with -BYGReplaySession=<file> -BYGReplaySpeed=<speed>
+	bool StartReplay(const FString& Filename, float Speed = 1.0f);
+	void StopReplay();
+	bool IsReplaying() const { return Replayer.IsReplaying(); }
+	const FBYGSessionReplayer& GetReplayer() const { return Replayer; }
 
 	// Names are case-insensitive. Using strings because future-proofing?
 	// You probably want "STEAM" or "NULL"
@@ -114,23 +338,264 @@ public:
 
 	void HostGame();
 	void CancelHostingGame();
+	// Only needed if the session was left in the Pending state, HostGame starts it automatically
+	void StartSession();
 
 	void FindSessions();
 
 	// Index refers to an entry in SessionSearch. Call FindSessions first to populate it.
+	// With reservations on, the host is asked for a slot first. If it refuses, the next visible search result is
+	// tried instead, until one accepts or we run out.
 	void JoinSession(uint32 Index);
+	bool IsReserving() const { return ReservationClient.IsValid(); }
+
+	// Reserves a slot for every member of a party in one request, then joins the leader. Members[0] is the leader,
+	// normally the local player. Private slots come out of the session's NumPrivateConnections. Refused reservations
+	// move on to the next visible result that has room for the whole party, hosts without a reservation beacon are
+	// skipped. Once granted, send the connect info from OnPartyReservationComplete to the other members through your
+	// party system, and have them call JoinDirect() with it.
+	void ReservePartySlots(uint32 Index, const TArray<FUniqueNetIdRepl>& Members, bool bPrivateSlots = false);
+	FOnBYGPartyReservationComplete OnPartyReservationComplete;
+	// Travels straight to a host without searching or joining its online session, e.g. with connect info from a party
+	// leader. Only works if the host has a slot for us, such as one reserved by ReservePartySlots().
+	// False if there's no local player to travel with.
+	bool JoinDirect(const FString& ConnectInfo);
+	// Joins a result that didn't come from FindSessions, e.g. one looked up by id. Replaces the search results with it.
+	// bAlreadyConnecting only joins the online session, for when we're already travelling to or on its host.
+	void JoinSearchResult(const FOnlineSessionSearchResult& Result, bool bAlreadyConnecting = false);
+
+	// Servers we've joined before, see BYGServerHistory.h
+	UPROPERTY(Config)
+	bool bRememberServers = true;
+	// Favorites don't count towards it
+	UPROPERTY(Config)
+	int32 MaxRecentServers = 20;
+	UPROPERTY(Config)
+	FString ServerHistorySlot = TEXT("BYGServerHistory");
+	FBYGServerHistory ServerHistory;
+	// Connects to a server from ServerHistory at its last known address, searching for it only if that fails.
+	// Key is FBYGKnownServer::GetKey(). False if we don't know it.
+	bool RejoinServer(const FString& Key);
+
+	// Hosts run a reservation beacon and clients reserve a slot before joining, see BYGReservationBeacon.h.
+	// Sessions that don't advertise a beacon, or whose beacon can't be reached, are joined directly. Off by default,
+	// hosts open another port and turn away players without a reservation once they're full.
+	UPROPERTY(Config)
+	bool bUseReservations = false;
+	// JoinSession and ReservePartySlots refuse hosts with a different build or content version, or maps we don't
+	// have, see BYGCompatibility.h
+	UPROPERTY(Config)
+	bool bRefuseIncompatibleSessions = true;
+	// Advertised by hosts and compared by clients, see BYGCompatibility.h. Empty doesn't advertise or check one.
+	UPROPERTY(Config)
+	FString ContentVersion;
+
+	// Results the backend couldn't ping get an estimate from the coordinate their host advertises, and we advertise
+	// ours when hosting, see BYGNetCoordinate.h. We start out at NetRegion in NetRegions, -BYGNetRegion= overrides it.
+	UPROPERTY(Config)
+	bool bEstimatePing = true;
+	UPROPERTY(Config)
+	FString NetRegion;
+	UPROPERTY(Config)
+	TArray<FBYGNetRegion> NetRegions;
+	// Refine our coordinate from real pings to hosts, and the connection to the host we're playing on
+	UPROPERTY(Config)
+	bool bLearnNetCoordinate = true;
+	// Where the learned coordinate is kept between launches, empty to start over every time
+	UPROPERTY(Config)
+	FString NetCoordinateSlot = TEXT("BYGNetCoordinate");
+	// After every search, the best few results the backend didn't ping are pinged directly (ICMP echo), best estimate
+	// first. Gives them a real ping and us something to learn from. 0 turns it off.
+	UPROPERTY(Config)
+	int32 NetProbeCount = 3;
+	UPROPERTY(Config)
+	float NetProbeTimeout = 1.0f;
+	const FBYGNetCoordinate& GetNetCoordinate() const { return NetCoordinate; }
+	// Ping to a search result, estimated if the backend didn't give one
+	int32 GetPingEstimate(const FOnlineSessionSearchResult& Result) const;
 
 	IOnlineSessionPtr GetSession();
+	// The session interface of the subsystem a search result was found on, which isn't always the current one
+	IOnlineSessionPtr GetSessionForResult(const FOnlineSessionSearchResult& Result);
+	// Like IOnlineSession::GetResolvedConnectString, for results from any search source
+	bool GetConnectString(const FOnlineSessionSearchResult& Result, FName PortType, FString& OutConnectInfo);
+	FName GetCurrentSubsystemName() const { return CurrentSubsystemName; }
 	void ResetState();
 
+	// State of NAME_GameSession. Rebuilt only when a session event fires, so it's cheap to read every frame.
+	FBYGSessionSnapshotRef GetSessionSnapshot() const { return SessionSnapshot; }
+	FBYGSessionSnapshotRef GetSessionSnapshot_AnyThread() const { return SessionSnapshotBuffer.Read(); }
+	// Broadcast on the game thread
+	FOnBYGSessionSnapshotChanged OnSessionSnapshotChanged;
+
+	// Plain-data copy of the latest search results, rebuilt when a search starts or completes
+	FBYGSearchSnapshotRef GetSearchSnapshot() const { return SearchSnapshot; }
+	FBYGSearchSnapshotRef GetSearchSnapshot_AnyThread() const { return SearchSnapshotBuffer.Read(); }
+	// Broadcast on the game thread once results have been decoded, filtered and sorted
+	FOnBYGSearchResultsReady OnSearchResultsReady;
+
+	// Decides the snapshot's VisibleRows. Changing it re-filters the current results.
+	void SetSearchFilter(const FBYGSearchFilter& InFilter);
+	const FBYGSearchFilter& GetSearchFilter() const { return SearchFilter; }
+	// Result sets at least this big are decoded, filtered and sorted on background tasks rather than in the
+	// completion callback. The snapshot then arrives a frame or so later.
+	int32 AsyncSearchProcessingThreshold = 64;
+
+	// Most search results kept, also an upper bound on FindMaxResults. Once a multi-search has this many, further
+	// results are dropped. 0 for no limit.
+	UPROPERTY(Config)
+	int32 MaxRetainedSearchResults = 200;
+	// Advertised string and blob settings longer than this are dropped from search results. 0 for no limit.
+	UPROPERTY(Config)
+	int32 MaxSearchSettingLength = 1024;
+	int32 GetMaxSearchResults() const { return MaxRetainedSearchResults > 0 ? FMath::Min(FindMaxResults, MaxRetainedSearchResults) : FindMaxResults; }
+	// What SessionSearch and the search snapshot hold on to, updated with every snapshot
+	SIZE_T GetSearchMemoryBytes() const { return SearchMemoryBytes; }
+	// Recycles the searches behind SessionSearch, see BYGSearchPool.h
+	FBYGSearchPool SearchPool;
+
 	TSharedPtr<class FOnlineSessionSearch> SessionSearch;
 	
 	UPROPERTY()
 	class UBYGMultiplayerUI* UI;
 
+	// (Re)starts the login pipeline for the current online subsystem. Does nothing if already logged in.
+	void Login();
+	EBYGLoginState GetLoginState() const { return LoginState; }
+	bool IsLoggedIn() const { return LoginState == EBYGLoginState::LoggedIn; }
+	static const TCHAR* GetLoginStateName(EBYGLoginState State);
+
+	// Cached on login, so these are cheap to call every frame
 	FString GetPlayerNickname() const;
+	TSharedPtr<const FUniqueNetId> GetPlayerId() const { return CachedPlayerId; }
 protected:
+	FBYGNetCoordinate NetCoordinate;
+	double LastNetCoordinateSampleTime = 0.0;
+	// Learned since it was last saved
+	bool bNetCoordinateChanged = false;
+	double LastNetCoordinateSaveTime = 0.0;
+	void InitNetCoordinate();
+	// Async unless we're shutting down, when there's nobody left to finish the write
+	void SaveNetCoordinate(bool bAsync);
+	// Invalid unless bEstimatePing, so nothing gets estimated
+	FBYGNetCoordinate GetEstimationCoordinate() const { return bEstimatePing ? NetCoordinate : FBYGNetCoordinate(); }
+	void ObserveLatency(const FSessionSettings& HostSettings, float RttMs);
+	void TickNetCoordinate();
+	// See NetProbeCount
+	void ProbeSearchResults();
+	void OnProbeComplete(const TSharedPtr<class FOnlineSessionSearch>& Search, int32 Index, float RttMs);
+
+	// Swaps in synthetic sessions and search results while it measures, see BYGFrameBenchmark.cpp
+	friend class FBYGFrameBenchmark;
+
 	FName CurrentSubsystemName = NAME_None;
+
+	bool bCoreInitialized = false;
+	bool bUIInitialized = false;
+	bool bIsWarmingUp = false;
+	double InitializationSeconds = 0.0;
+	void EnsureInitialized();
+	void InitializeCore();
+	void InitializeUI();
+	void TickWarmup();
+
+	TOptional<FBYGNetProfile> ActiveNetProfile;
+	// The world whose spawns we scale, and the settings things had before any profile, put back by RestoreNetProfile
+	TWeakObjectPtr<UWorld> NetProfileWorld;
+	TWeakObjectPtr<UNetDriver> NetProfileDriver;
+	TOptional<FBYGNetProfile> OriginalNetDriverSettings;
+	TMap<TWeakObjectPtr<AActor>, TPair<float, float>> OriginalActorFrequencies;
+	FDelegateHandle PostLoadMapHandle;
+	FDelegateHandle ActorSpawnedHandle;
+	void SelectNetProfile(FOnlineSessionSettings& SessionSettings);
+	// Safe to call again, e.g. with a different profile or after a travel
+	void ApplyNetProfile(UWorld* World);
+	void ApplyNetProfileToActor(AActor* Actor);
+	// Once the session is gone
+	void RestoreNetProfile();
+	void OnPostLoadMap(UWorld* World);
+	void OnActorSpawned(AActor* Actor);
+
+	bool TravelToSessionMap(FName MapName);
+	void PreloadNextSessionMap(UWorld* World);
+
+	bool bBoundReplicationDriver = false;
+	class UReplicationDriver* CreateReplicationDriver(UNetDriver* NetDriver, const FURL& URL, UWorld* World);
+	// Number of players the session we're hosting or about to auto-host is for, 0 if we aren't hosting
+	int32 GetExpectedSessionSize() const;
+
+	// Waits for the first tick with a world, so the session can travel once started
+	bool bAutoHostPending = false;
+	void StartAutoHost();
+	// Fills OnlineSessionSettings from config and command line
+	void ApplyAutoHostSettings();
+	int32 GetAutoHostMaxPlayers() const;
+
+	IOnlineIdentityPtr GetIdentity() const;
+
+	// Host side of reservations. Beacons live in the world, so this is started again after every map change.
+	TWeakObjectPtr<class AOnlineBeaconHost> ReservationBeaconHost;
+	TWeakObjectPtr<ABYGReservationBeaconHostObject> ReservationHost;
+	// Only try once per world, a port that's taken now will still be taken next tick
+	TWeakObjectPtr<UWorld> ReservationBeaconWorld;
+	FDelegateHandle PreLoginHandle;
+	FDelegateHandle PostLoginHandle;
+	void StartReservationBeacon(UWorld* World);
+	void StopReservationBeacon();
+	void OnGameModePreLogin(class AGameModeBase* GameMode, const FUniqueNetIdRepl& NewPlayer, FString& ErrorMessage);
+	void OnGameModePostLogin(class AGameModeBase* GameMode, class APlayerController* NewPlayer);
+	void OnGameModeLogout(class AGameModeBase* GameMode, class AController* Exiting);
+	FDelegateHandle LogoutHandle;
+
+	// Client side
+	TWeakObjectPtr<ABYGReservationBeaconClient> ReservationClient;
+	// Search results already asked during this join, so a refusal never sends us back to one
+	TArray<int32> ReservationAttempts;
+	// Who we're reserving for, just the local player unless it's a party
+	TArray<FUniqueNetIdRepl> ReservationMembers;
+	bool bReservationPrivateSlots = false;
+	// Set by ReservePartySlots, even for a party of one. Parties only join hosts that reserved for all of them, and
+	// hear back through OnPartyReservationComplete.
+	bool bPartyReservation = false;
+	bool IsPartyReservation() const { return bPartyReservation; }
+	// Logs why if not
+	bool CanJoinResult(int32 Index) const;
+	// Returns false if the result has no beacon to ask, in which case just join it
+	bool RequestReservation(int32 Index);
+	// Asks the next visible result with room for the party. Returns false if there are none left.
+	bool TryNextReservation();
+	void OnReservationResponse(EBYGReservationResult Result, int32 Index);
+	void DoJoinSession(int32 Index);
+	// Set by JoinSearchResult when we're already connecting, so OnJoinSessionComplete doesn't travel again
+	bool bSkipJoinTravel = false;
+	// Replaces the search results with just this one
+	void SetSearchResult(const FOnlineSessionSearchResult& Result);
+
+	FBYGSessionRecorder Recorder;
+	FBYGSessionReplayer Replayer;
+	void ReplayEvent(const FBYGSessionEvent& Event);
+
+	EBYGLoginState LoginState = EBYGLoginState::NotLoggedIn;
+	int32 LoginAttempts = 0;
+	double LoginAttemptStartTime = 0.0;
+	double NextLoginAttemptTime = 0.0;
+	TSharedPtr<const FUniqueNetId> CachedPlayerId;
+	FString CachedPlayerNickname;
+
+	struct FPendingLoginAction
+	{
+		FName Name;
+		TFunction<void()> Action;
+	};
+	// Actions with the same name replace each other, so mashing "Host" only hosts once
+	TArray<FPendingLoginAction> PendingLoginActions;
+	// Returns true if we're logged in and the caller can go ahead. Otherwise queues the action and starts logging in.
+	bool RunWhenLoggedIn(FName Name, TFunction<void()> Action);
+
+	void StartLoginAttempt();
+	void TickLogin();
+	void OnLoginAttemptFailed(const FString& Error);
+	void OnLoggedIn();
 	bool InitializeOnlineSubsystem(const FName& SubsystemName);
 
 	FOnCreateSessionCompleteDelegate CreateCompleteDelegate;
@@ -153,20 +618,51 @@ protected:
 	FDelegateHandle FindSessionsCompleteDelegateHandle;
 	void OnFindSessionsComplete(bool bWasSuccessful);
 
-	//void OnUpdateSessionComplete(FName SessionName, bool bWasSuccessful);
+	// These fire for changes we didn't ask for (e.g. remote players registering), so they stay bound
+	// for as long as we're using a subsystem
+	void BindSessionNotifications();
+	FDelegateHandle UpdateSessionCompleteDelegateHandle;
+	FDelegateHandle DestroySessionCompleteDelegateHandle;
+	FDelegateHandle RegisterPlayersCompleteDelegateHandle;
+	FDelegateHandle UnregisterPlayersCompleteDelegateHandle;
+	void OnUpdateSessionComplete(FName SessionName, bool bWasSuccessful);
 
 	void DoEndSession(FName SessionName);
 
 	FOnEndSessionCompleteDelegate EndSessionCompleteDelegate;
 	FDelegateHandle EndSessionCompleteDelegateHandle;
 	void OnEndSessionComplete(FName SessionName, bool bWasSuccessful);
-	//void OnDestroySessionComplete(FName SessionName, bool bWasSuccessful);
+	void OnDestroySessionComplete(FName SessionName, bool bWasSuccessful);
 	//void OnPingSearchResultsComplete(bool bWasSuccessful);
 	//void OnCancelFindSessionsComplete(bool bWasSuccessful);
 	//void OnMatchmakingComplete(FName SessionName, bool bWasSuccessful);
 	//void OnCancelMatchmakingComplete(FName SessionName, bool bWasSuccessful);
-	//void OnRegisterPlayersComplete(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& PlayerIDs, bool bWasSuccessful);
-	//void OnUnregisterPlayersComplete(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& PlayerIDs, bool bWasSuccessful);
+	void OnRegisterPlayersComplete(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& PlayerIDs, bool bWasSuccessful);
+	void OnUnregisterPlayersComplete(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& PlayerIDs, bool bWasSuccessful);
+
+	FBYGSessionSnapshotRef SessionSnapshot = MakeShared<FBYGSessionSnapshot, ESPMode::ThreadSafe>();
+	TBYGDoubleBuffer<FBYGSessionSnapshotRef> SessionSnapshotBuffer{ SessionSnapshot };
+	// Call after anything that may have changed the session
+	void RefreshSessionSnapshot();
+
+	FBYGSearchSnapshotRef SearchSnapshot = MakeShared<FBYGSearchSnapshot, ESPMode::ThreadSafe>();
+	TBYGDoubleBuffer<FBYGSearchSnapshotRef> SearchSnapshotBuffer{ SearchSnapshot };
+	// Call after SessionSearch changes
+	void RefreshSearchSnapshot();
+	void PublishSearchSnapshot(const TSharedRef<FBYGSearchSnapshot, ESPMode::ThreadSafe>& Snapshot, uint32 Serial);
+	FBYGSearchFilter SearchFilter;
+	SIZE_T SearchMemoryBytes = 0;
+	// Bumped per refresh so results from a superseded background task are dropped
+	uint32 SearchProcessingSerial = 0;
+	struct FSearchProcessingTask
+	{
+		FGraphEventRef Task;
+		// Keeps the results alive while the task reads them. Searches are replaced rather than modified once complete,
+		// apart from probed pings, which wait for the tasks first.
+		TSharedPtr<class FOnlineSessionSearch> Search;
+	};
+	TArray<FSearchProcessingTask> SearchProcessingTasks;
+	void WaitForSearchProcessing();
 
 	// See Engine.h for these originally
 	virtual void HandleNetworkFailure(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString);
@@ -175,4 +671,12 @@ protected:
 
 	/** @return the current game world */
 	virtual UWorld* GetWorld() const override;
+
+	// Game instance subsystems don't tick, so we hook into the core ticker instead
+	bool Tick(float DeltaTime);
+#if ENGINE_MAJOR_VERSION >= 5
+	FTSTicker::FDelegateHandle TickerHandle;
+#else
+	FDelegateHandle TickerHandle;
+#endif
 };
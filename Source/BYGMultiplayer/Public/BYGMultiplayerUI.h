@@ -33,9 +33,9 @@ public:
 	int32 FindMaxResults = 10;
 	int32 FindTimeout = 10;
 	int32 FindCurrentItem = 0;
-
-	bool bIsLoggedIn = false;
-	FString PlayerNickname = "(Unknown)";
+	char FilterServerName[64] = "";
+	char FilterMapName[64] = "";
+	int32 FilterSortKey = 1;
 
 	int32 OnlineSubsystemIndex = 0;
 	const uint32 STEAM_INDEX = 1;
@@ -44,8 +44,24 @@ public:
 		"STEAM"
 	};
 
+	FString LastNetStatsExport;
+
+	char ReplayFilename[256] = "";
+	float ReplaySpeed = 1.0f;
+	FString LastRecordingFilename;
+
+	// While set, the tab with this label is selected on every draw, e.g. by BYG.Benchmark.Run
+	const char* ForcedTab = nullptr;
+	int GetTabFlags(const char* Label) const;
+
 	void ShowSessionInfo(FName SessionName);
 	void ShowRegisterButton();
+	void ShowNetStats();
+	void ShowRecording();
+	void ShowTravelProfiles();
+	void ShowServerHistory();
+	void ShowSearchFilter();
+	void ShowSearchResultTooltip(const struct FBYGSearchResultRow& Row);
 #endif
 	
 protected:
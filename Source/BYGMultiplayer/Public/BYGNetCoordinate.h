@@ -0,0 +1,97 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Estimated latency to hosts we've never pinged.
+//
+// Every machine gets a position in a small "latency space", measured in milliseconds, where the distance between
+// two positions approximates the round trip time between the two machines (Vivaldi network coordinates, with a
+// height for the access link). Hosts advertise theirs as one int32 along with how sure they are of it, and clients
+// estimate their ping to every result from it without sending a single packet, so sorting, filtering and quick
+// match can use latency as soon as results arrive, including from backends that report no ping at all.
+//
+// Positions start out at the one configured for our region, if any, and are refined from every real round trip
+// we see to a host that advertises one: backend or LAN discovery pings, pings to the best few results the backend
+// didn't ping (see UBYGMultiplayerSubsystem::NetProbeCount), and the connection while we're playing. Each sample
+// counts for more the surer the host is compared to us, so everyone can start from nothing and still converge.
+// What we've learned is saved, and picked up again on the next launch if it's better than the region's.
+// Coordinates are advertised however unsure they are, but only estimated from once both ends are valid.
+// Real pings always win over estimates.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineSessionSettings.h"
+#include "GameFramework/SaveGame.h"
+#include "BYGNetCoordinate.generated.h"
+
+// Where a region sits in latency space. Regions should be laid out so the distance between two of them is the
+// typical round trip between them, e.g. from the RTTs between your server regions.
+USTRUCT()
+struct BYGMULTIPLAYER_API FBYGNetRegion
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FString Name;
+
+	// Milliseconds
+	UPROPERTY(Config)
+	float X = 0.0f;
+	UPROPERTY(Config)
+	float Y = 0.0f;
+	// Typical last mile latency in the region, added to every estimate from or to it
+	UPROPERTY(Config)
+	float Height = 10.0f;
+};
+
+struct BYGMULTIPLAYER_API FBYGNetCoordinate
+{
+	// All in milliseconds
+	float X = 0.0f;
+	float Y = 0.0f;
+	float Height = 0.0f;
+	// How far off our estimates have been lately, relative to the RTT. 1 knows nothing. Advertised alongside the
+	// packed coordinate.
+	float Error = 1.0f;
+
+	// Whether estimates from it are worth anything
+	bool IsValid(float MaxError = 0.6f) const { return Error <= MaxError; }
+
+	// Round trip time in milliseconds
+	float EstimateRTT(const FBYGNetCoordinate& Other) const;
+
+	// Moves us towards where Remote and a measured RTT to it say we should be
+	void Observe(const FBYGNetCoordinate& Remote, float RttMs);
+
+	// Whole milliseconds, X and Y within +-2047 and height up to 255. The error isn't packed, Unpack leaves it at 1.
+	int32 Pack() const;
+	static FBYGNetCoordinate Unpack(int32 Packed);
+	static FBYGNetCoordinate FromRegion(const FBYGNetRegion& Region);
+
+	// Sets BYGSessionKeys::NetCoordinate and NetCoordinateError
+	void Advertise(FOnlineSessionSettings& Settings) const;
+	// What a host advertises. Hosts from before the error was advertised count as sure as a region.
+	static FBYGNetCoordinate FromSettings(const FSessionSettings& Settings);
+
+	// Real ping to a result if the backend gave one, otherwise an estimate from the coordinate the host advertises.
+	// bOutEstimated is set if it's an estimate. Thread-safe.
+	static int32 GetPing(const FOnlineSessionSearchResult& Result, const FBYGNetCoordinate& Local, bool* bOutEstimated = nullptr);
+	// Backends put 0 or MAX_QUERY_PING in results they couldn't ping
+	static bool HasMeasuredPing(const FOnlineSessionSearchResult& Result);
+};
+
+// Our learned coordinate, see UBYGMultiplayerSubsystem::NetCoordinateSlot
+UCLASS()
+class BYGMULTIPLAYER_API UBYGNetCoordinateSave : public USaveGame
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	float X = 0.0f;
+	UPROPERTY()
+	float Y = 0.0f;
+	UPROPERTY()
+	float Height = 0.0f;
+	UPROPERTY()
+	float Error = 1.0f;
+};
@@ -0,0 +1,72 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Net driver and replication settings picked by session size and server type when hosting.
+// A 4 player listen server and a 64 player dedicated server want very different bandwidth and tick budgets.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BYGNetProfile.generated.h"
+
+class AActor;
+class UNetDriver;
+
+UENUM()
+enum class EBYGNetProfileServerType : uint8
+{
+	Any,
+	Listen,
+	Dedicated
+};
+
+USTRUCT()
+struct BYGMULTIPLAYER_API FBYGNetProfile
+{
+	GENERATED_BODY()
+
+	// Advertised with the session so it shows up in search results and logs
+	UPROPERTY(Config)
+	FString Name;
+
+	UPROPERTY(Config)
+	EBYGNetProfileServerType ServerType = EBYGNetProfileServerType::Any;
+
+	// Used for sessions with up to this many public connections, 0 for any size
+	UPROPERTY(Config)
+	int32 MaxPlayers = 0;
+
+	// Bytes per second, per client
+	UPROPERTY(Config)
+	int32 MaxClientRate = 15000;
+	UPROPERTY(Config)
+	int32 MaxInternetClientRate = 10000;
+
+	UPROPERTY(Config)
+	int32 NetServerMaxTickRate = 30;
+
+	// Multiplies every replicated actor's NetUpdateFrequency and MinNetUpdateFrequency
+	UPROPERTY(Config)
+	float NetUpdateFrequencyScale = 1.0f;
+
+	// Seconds
+	UPROPERTY(Config)
+	float ConnectionTimeout = 60.0f;
+	UPROPERTY(Config)
+	float InitialConnectTimeout = 60.0f;
+
+	bool Matches(int32 NumPlayers, bool bDedicated) const;
+	void ApplyToNetDriver(UNetDriver* NetDriver) const;
+	// Scales the frequencies the actor had before any profile was applied, so applying another profile replaces
+	// this one instead of compounding it
+	void ApplyToActor(AActor* Actor, float NetUpdateFrequency, float MinNetUpdateFrequency) const;
+
+	// A net driver's current settings, ApplyToNetDriver puts them back
+	static FBYGNetProfile FromNetDriver(const UNetDriver* NetDriver);
+	static void GetActorFrequencies(const AActor* Actor, float& OutNetUpdateFrequency, float& OutMinNetUpdateFrequency);
+	static void SetActorFrequencies(AActor* Actor, float NetUpdateFrequency, float MinNetUpdateFrequency);
+
+	// First profile that matches, or nullptr
+	static const FBYGNetProfile* Select(const TArray<FBYGNetProfile>& Profiles, int32 NumPlayers, bool bDedicated);
+	// Used when nothing is configured
+	static const TArray<FBYGNetProfile>& GetDefaults();
+};
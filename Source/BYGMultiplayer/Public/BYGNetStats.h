@@ -0,0 +1,128 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Samples every UNetConnection of a world's net driver at a fixed rate and keeps a short history of each stat.
+// Used by the "Net Stats" tab of the debug UI, and can be dumped to CSV when players report lag.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class UNetConnection;
+class UNetDriver;
+class UWorld;
+
+// Fixed-size ring buffer. Storage is a flat array so it can be handed to ImGui::PlotLines with GetOffset()
+template<typename T, int32 Capacity>
+struct TBYGRingBuffer
+{
+	static_assert(Capacity > 0, "Ring buffer needs at least one element");
+
+	void Push(T Value)
+	{
+		Values[Head] = Value;
+		Head = (Head + 1) % Capacity;
+		Count = FMath::Min(Count + 1, Capacity);
+	}
+
+	void Reset()
+	{
+		Head = 0;
+		Count = 0;
+	}
+
+	int32 Num() const { return Count; }
+	bool IsEmpty() const { return Count == 0; }
+	static constexpr int32 GetCapacity() { return Capacity; }
+
+	// Index of the oldest element in GetData()
+	int32 GetOffset() const { return Count < Capacity ? 0 : Head; }
+	const T* GetData() const { return Values; }
+
+	// 0 is the oldest element, Num() - 1 the newest
+	T Get(int32 Index) const
+	{
+		check(Index >= 0 && Index < Count);
+		return Values[(GetOffset() + Index) % Capacity];
+	}
+
+	T GetLatest() const
+	{
+		return Count > 0 ? Values[(Head + Capacity - 1) % Capacity] : T();
+	}
+
+	T GetMax() const
+	{
+		T Max = T();
+		for (int32 i = 0; i < Count; ++i)
+		{
+			Max = FMath::Max(Max, Values[i]);
+		}
+		return Max;
+	}
+
+private:
+	T Values[Capacity] = {};
+	int32 Head = 0;
+	int32 Count = 0;
+};
+
+enum class EBYGNetStat : uint8
+{
+	RTT,				// Milliseconds
+	InPacketLoss,		// Percent
+	OutPacketLoss,		// Percent
+	InBytesPerSecond,
+	OutBytesPerSecond,
+	Saturation,			// Outgoing bytes per second as a percentage of the connection's net speed
+	QueuedBits,
+
+	Num
+};
+
+struct BYGMULTIPLAYER_API FBYGConnectionNetStats
+{
+	static constexpr int32 HistorySize = 256;
+
+	TWeakObjectPtr<UNetConnection> Connection;
+	FString RemoteAddress;
+	bool bIsServerConnection = false;
+	bool bIsConnected = true;
+
+	// Seconds since the sampler was started
+	TBYGRingBuffer<float, HistorySize> Timestamps;
+	TBYGRingBuffer<float, HistorySize> Stats[(int32)EBYGNetStat::Num];
+
+	const TBYGRingBuffer<float, HistorySize>& GetStat(EBYGNetStat Stat) const { return Stats[(int32)Stat]; }
+};
+
+class BYGMULTIPLAYER_API FBYGNetStatsSampler
+{
+public:
+	// Samples per second
+	float SampleRate = 10.0f;
+	// Disconnected connections are kept around for inspection until we run out of room
+	int32 MaxTrackedConnections = 16;
+
+	void Tick(UWorld* World, float DeltaTime);
+	void Reset();
+
+	// Writes every retained sample of every connection. Returns false if the file could not be written.
+	bool ExportCSV(const FString& Filename) const;
+	FString GetDefaultExportFilename() const;
+
+	const TArray<FBYGConnectionNetStats>& GetConnections() const { return Connections; }
+	int32 GetNumSamples() const { return NumSamples; }
+
+	static const TCHAR* GetStatName(EBYGNetStat Stat);
+
+protected:
+	void SampleNetDriver(UNetDriver* NetDriver);
+	void SampleConnection(UNetConnection* Connection, bool bIsServerConnection);
+	FBYGConnectionNetStats* FindOrAddConnection(UNetConnection* Connection, bool bIsServerConnection);
+
+	TArray<FBYGConnectionNetStats> Connections;
+	double StartTime = 0.0;
+	float TimeSinceSample = 0.0f;
+	int32 NumSamples = 0;
+};
@@ -0,0 +1,37 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Compares replication cost with and without the replication graph, on any map:
+//
+//   BYG.RepBenchmark.Spawn 2000 50000   Spawn 2000 moving replicated actors within 50000 units of the origin
+//   BYG.RepBenchmark.Measure 10         Capture a CSV profile of the net driver's flush over 10 seconds
+//   BYG.RepBenchmark.Clear              Destroy them again
+//
+// Run on a server with clients connected, then host again with the graph turned off
+// (bUseReplicationGraph=false, or a ReplicationGraphMinPlayers above the session size) and compare.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "BYGReplicationBenchmark.generated.h"
+
+UCLASS(NotBlueprintable, NotPlaceable)
+class BYGMULTIPLAYER_API ABYGReplicationBenchmarkActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ABYGReplicationBenchmarkActor();
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	// Circles around where it was spawned, so movement replicates every frame
+	float Radius = 500.0f;
+	float Speed = 1.0f;
+
+protected:
+	FVector Center = FVector::ZeroVector;
+	float Angle = 0.0f;
+
+	virtual void BeginPlay() override;
+};
@@ -0,0 +1,69 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Replication graph for large sessions. Actors are bucketed into a 2D spatial grid, so each connection only
+// considers the cells around its viewer instead of every actor in the world, and always-relevant actors are
+// gathered once per frame rather than checked per connection. The subsystem swaps it in when hosting a session
+// with at least ReplicationGraphMinPlayers public connections, see UBYGMultiplayerSubsystem.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "BYGReplicationGraph.generated.h"
+
+class UReplicationGraphNode_GridSpatialization2D;
+class UReplicationGraphNode_ActorList;
+class UReplicationGraphNode_AlwaysRelevant_ForConnection;
+
+UCLASS(Transient, Config = Game)
+class BYGMULTIPLAYER_API UBYGReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	// Begin UReplicationGraph
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RemoveClientConnection(UNetConnection* NetConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
+	// End UReplicationGraph
+
+	// Should be around the net cull distance of most actors
+	UPROPERTY(Config)
+	float CellSize = 10000.0f;
+
+	// Lowest X and Y the grid expects to see. Actors outside it still work, but cause the grid to be rebuilt.
+	UPROPERTY(Config)
+	FVector2D SpatialBias = FVector2D(-200000.0f, -200000.0f);
+
+protected:
+	UPROPERTY()
+	UReplicationGraphNode_GridSpatialization2D* GridNode = nullptr;
+
+	// bAlwaysRelevant actors, shared by every connection
+	UPROPERTY()
+	UReplicationGraphNode_ActorList* AlwaysRelevantNode = nullptr;
+
+	struct FConnectionAlwaysRelevantNode
+	{
+		UNetConnection* NetConnection = nullptr;
+		UReplicationGraphNode_AlwaysRelevant_ForConnection* Node = nullptr;
+
+		bool operator==(const UNetConnection* Other) const { return NetConnection == Other; }
+	};
+	// bOnlyRelevantToOwner actors go in their owner's node
+	TArray<FConnectionAlwaysRelevantNode> AlwaysRelevantForConnection;
+
+	// Owner-only actors whose owner doesn't have a connection yet, e.g. a player controller mid-login
+	UPROPERTY()
+	TArray<AActor*> ActorsWithoutNetConnection;
+
+	// The connection each owner-only actor was added for. ServerReplicateActors moves actors whose owner changed to
+	// the new owner's node, and removing one has to go by this rather than the actor's current connection.
+	TMap<AActor*, UNetConnection*> OwnerOnlyActorConnections;
+
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* GetAlwaysRelevantNodeForConnection(const UNetConnection* NetConnection) const;
+};
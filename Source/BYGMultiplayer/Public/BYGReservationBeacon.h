@@ -0,0 +1,118 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Slot reservations, so a client finds out whether there's room before it joins and travels.
+//
+// Hosts run an online beacon next to the game and advertise its port with the session. Before joining, the client
+// connects to the beacon and asks for a slot. The host grants it if players plus outstanding reservations leave room,
+// and holds it for ReservationLifetime seconds. Players logging in without a reservation are turned away while every
+// free slot is reserved. Clients that are refused move on to the next search result straight away.
+//
+// A party leader can reserve for the whole party in one request, in public or private slots. It's all or nothing, so
+// the party is never split across servers. Each member's slot is held until that member logs in.
+//
+// Only the player the beacon connection belongs to can lead a reservation, so asking again always replaces the
+// previous one, and each remote address holds at most MaxReservationsPerAddress at a time. A client can't lock
+// everyone out by reserving under made up ids.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineBeaconClient.h"
+#include "OnlineBeaconHostObject.h"
+#include "GameFramework/OnlineReplStructs.h"
+#include "BYGReservationBeacon.generated.h"
+
+UENUM()
+enum class EBYGReservationResult : uint8
+{
+	Granted,
+	Full,
+	// Bad request, e.g. no player id
+	Denied,
+	// Couldn't reach the beacon, or it went away before answering
+	ConnectionFailed
+};
+
+DECLARE_DELEGATE_OneParam(FOnBYGReservationResponse, EBYGReservationResult /*Result*/);
+// ConnectInfo is only set when the reservation was granted, it's what party members pass to JoinDirect()
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnBYGPartyReservationComplete, EBYGReservationResult /*Result*/, const FString& /*ConnectInfo*/);
+
+UCLASS(Transient, NotPlaceable)
+class BYGMULTIPLAYER_API ABYGReservationBeaconClient : public AOnlineBeaconClient
+{
+	GENERATED_BODY()
+
+public:
+	// Connects to the beacon at ConnectInfo and asks for a slot for each of Members, the first being whoever is
+	// asking. OnResponse fires exactly once.
+	bool RequestReservation(const FString& ConnectInfo, const TArray<FUniqueNetIdRepl>& InMembers, bool bInPrivateSlots);
+	FOnBYGReservationResponse OnResponse;
+
+	static const TCHAR* GetResultName(EBYGReservationResult Result);
+
+	virtual void OnConnected() override;
+	virtual void OnFailure() override;
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerRequestReservation(const TArray<FUniqueNetIdRepl>& RequestMembers, bool bRequestPrivateSlots);
+
+	UFUNCTION(Client, Reliable)
+	void ClientReservationResponse(EBYGReservationResult Result);
+
+protected:
+	TArray<FUniqueNetIdRepl> Members;
+	bool bPrivateSlots = false;
+	bool bResponded = false;
+	void Respond(EBYGReservationResult Result);
+};
+
+UCLASS(Transient, NotPlaceable, Config = Game)
+class BYGMULTIPLAYER_API ABYGReservationBeaconHostObject : public AOnlineBeaconHostObject
+{
+	GENERATED_BODY()
+
+public:
+	ABYGReservationBeaconHostObject();
+
+	// Seconds a granted slot is held for the player to show up
+	UPROPERTY(Config)
+	float ReservationLifetime = 30.0f;
+	// Outstanding reservations per remote address, more than one only for players behind the same NAT
+	UPROPERTY(Config)
+	int32 MaxReservationsPerAddress = 4;
+
+	// Total slots in the session, including ones already taken by players
+	int32 MaxPublicSlots = 0;
+	int32 MaxPrivateSlots = 0;
+
+	// Members[0] is the party leader and must be RequesterId, the player the beacon connection belongs to. Asking again
+	// replaces their previous reservation.
+	EBYGReservationResult ProcessReservationRequest(const TArray<FUniqueNetIdRepl>& Members, bool bPrivateSlots, const FUniqueNetIdRepl& RequesterId, const FString& RequesterAddress);
+	// Whether a player logging in now should be let in
+	bool CanLogin(const FUniqueNetIdRepl& PlayerId);
+	// The player made it in, their slot is now counted as a player instead
+	void ConsumeReservation(const FUniqueNetIdRepl& PlayerId);
+	void OnPlayerLeft(const FUniqueNetIdRepl& PlayerId);
+
+	int32 GetNumReservations() const { return Reservations.Num(); }
+	int32 GetNumReservedSlots(bool bPrivateSlots) const;
+	int32 GetNumFreeSlots(bool bPrivateSlots) const;
+
+protected:
+	struct FReservation
+	{
+		FUniqueNetIdRepl Leader;
+		// Without the port, see MaxReservationsPerAddress
+		FString Address;
+		// Members that haven't logged in yet
+		TArray<FUniqueNetIdRepl> Members;
+		bool bPrivateSlots = false;
+		double ExpireTime = 0.0;
+	};
+	TArray<FReservation> Reservations;
+	// Players who came in through a private reservation and so don't count against the public slots
+	TArray<FUniqueNetIdRepl> PrivateSlotPlayers;
+	void PruneExpired();
+	FReservation* FindReservation(const FUniqueNetIdRepl& PlayerId);
+	int32 GetNumPlayers() const;
+};
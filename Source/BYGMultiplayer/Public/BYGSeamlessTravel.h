@@ -0,0 +1,100 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Seamless travel between a session's lobby and match maps.
+//
+// Clients stay connected through a transition map instead of disconnecting and reconnecting, so slow loaders don't
+// time out and get dropped. While on one map, the other is loaded in the background and held in memory, so the travel
+// itself only has to initialize it. Each travel produces an FBYGTravelReport: on the server, how long every client
+// took to arrive, on a client, how long it took itself.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/StrongObjectPtr.h"
+
+class UBYGMultiplayerSubsystem;
+class UPackage;
+class UWorld;
+
+struct BYGMULTIPLAYER_API FBYGClientTravelTime
+{
+	FString PlayerName;
+	// Seconds from the server starting the travel until the client had loaded the map, negative if it never did
+	double Seconds = -1.0;
+};
+
+struct BYGMULTIPLAYER_API FBYGTravelReport
+{
+	FString MapName;
+	bool bWasServer = false;
+	// Whether the map was already in memory from preloading
+	bool bWasPreloaded = false;
+	// Until we were on the new map
+	double LocalSeconds = 0.0;
+	// Until the last client arrived or we stopped waiting for them. Same as LocalSeconds on clients.
+	double TotalSeconds = 0.0;
+	// Server only
+	TArray<FBYGClientTravelTime> Clients;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnBYGTravelComplete, const FBYGTravelReport& /*Report*/);
+
+class BYGMULTIPLAYER_API FBYGSeamlessTravel
+{
+public:
+	void Init(UBYGMultiplayerSubsystem* InSubsystem);
+	void Deinit();
+
+	// Server only. MapName can be a short or long package name.
+	bool Travel(UWorld* World, const FString& MapName, const FString& Options, bool bAbsolute);
+	bool IsTravelling() const { return bIsTravelling; }
+
+	// Starts loading a map in the background and keeps it loaded. Replaces any previous preload.
+	void Preload(const FString& MapName);
+	void ReleasePreload();
+	bool IsPreloaded(const FString& MapName) const;
+
+	void Tick();
+	void OnPostLoadMap(UWorld* World);
+
+	const FBYGTravelReport& GetLastReport() const { return LastReport; }
+	FOnBYGTravelComplete OnTravelComplete;
+
+	// Clients that haven't loaded the map after this many seconds are reported as missing
+	float ClientTimeout = 60.0f;
+
+	static FString GetLongPackageName(const FString& MapName);
+
+protected:
+	UBYGMultiplayerSubsystem* Subsystem = nullptr;
+	FDelegateHandle SeamlessTravelStartHandle;
+	void OnSeamlessTravelStart(UWorld* World, const FString& MapName);
+
+	bool bIsTravelling = false;
+	// Arrived locally, server waiting on clients
+	bool bWaitingForClients = false;
+	double TravelStartTime = 0.0;
+	double ArrivalTime = 0.0;
+	FBYGTravelReport PendingReport;
+	FBYGTravelReport LastReport;
+	FString DestinationShortName;
+	struct FPendingClient
+	{
+		// Not the controller, game modes with a different PlayerController class replace it during the travel. The
+		// connection's controller is looked up again on every tick.
+		TWeakObjectPtr<class UNetConnection> Connection;
+		// Copied up front, the connection may be gone by the time we report on it
+		FString PlayerName;
+	};
+	TArray<FPendingClient> PendingClients;
+	void Start(const FString& MapName, bool bIsServer);
+	void Arrive(UWorld* World);
+	void TickClients();
+	void Finish();
+	UWorld* GetWorld() const;
+
+	FString PreloadMapName;
+	TStrongObjectPtr<UPackage> PreloadedPackage;
+	// Bumped per preload, so a superseded load doesn't replace the current one
+	int32 PreloadSerial = 0;
+};
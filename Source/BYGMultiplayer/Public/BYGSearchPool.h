@@ -0,0 +1,39 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Bounded storage for session search results.
+//
+// Every search used to allocate a fresh FOnlineSessionSearch and grow its results array from nothing, then keep it
+// until the next one. The pool hands out searches that are recycled once nothing else references them, keeping the
+// results array and query settings allocations from one search to the next. The results themselves are still
+// written by the online subsystem, so their settings maps are its allocations; what the pool bounds is how many
+// there are and how large their advertised strings can get, see TrimResult.
+//
+// Memory is tracked under the BYGMultiplayer LLM tag, and "stat BYGMultiplayer" shows the retained results.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FOnlineSessionSearch;
+class FOnlineSessionSearchResult;
+
+class BYGMULTIPLAYER_API FBYGSearchPool
+{
+public:
+	// A search with no results and default settings. Recycled if the pool has one nobody else holds on to.
+	TSharedRef<FOnlineSessionSearch> Acquire();
+	void Empty();
+
+	// Searches kept for reuse. Enough for the current one, one a background task is still reading, and the
+	// per-backend searches of a multi-search; past that they're allocated as before.
+	int32 MaxPooled = 4;
+
+	// Drops advertised string settings longer than MaxSettingLength, which is 0 for no limit.
+	// Returns how many were dropped.
+	static int32 TrimResult(FOnlineSessionSearchResult& Result, int32 MaxSettingLength);
+	// Roughly how much memory a search and its results hold on to
+	static SIZE_T GetAllocatedSize(const FOnlineSessionSearch& Search);
+
+protected:
+	TArray<TSharedRef<FOnlineSessionSearch>> Searches;
+};
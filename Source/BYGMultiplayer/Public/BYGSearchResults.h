@@ -0,0 +1,129 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Plain-data copies of session search results. Unlike FOnlineSessionSearchResult these hold no net ids or other
+// game-thread-only shared pointers, so they can be built on background tasks and read from any thread.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineSessionSettings.h"
+#include "BYGSessionSnapshot.h"
+#include "BYGCompatibility.h"
+#include "BYGNetCoordinate.h"
+
+struct BYGMULTIPLAYER_API FBYGSearchResultRow
+{
+	// Index into SessionSearch->SearchResults, which is what JoinSession takes
+	int32 SearchIndex = INDEX_NONE;
+
+	FBYGDisplayString SessionId;
+	FBYGDisplayString ServerName;
+	FBYGDisplayString MapName;
+	FBYGDisplayString OwningUserName;
+	int32 PingInMs = 0;
+	// PingInMs is estimated from the host's advertised coordinate, the backend didn't give one
+	bool bPingEstimated = false;
+	int32 NumPlayers = 0;
+	int32 MaxPlayers = 0;
+	int32 NumOpenPublicConnections = 0;
+	int32 BuildUniqueId = 0;
+	bool bIsLANMatch = false;
+	bool bIsDedicated = false;
+	// Whether we could play there, see BYGCompatibility.h
+	EBYGCompatibility Compatibility = EBYGCompatibility::Compatible;
+	// Which search found it, empty unless searching several sources at once
+	FBYGDisplayString Source;
+
+	// LocalCoordinate fills in pings the backend didn't give us, see BYGNetCoordinate.h
+	static FBYGSearchResultRow FromSearchResult(int32 SearchIndex, const FOnlineSessionSearchResult& Result, const FBYGNetCoordinate& LocalCoordinate = FBYGNetCoordinate());
+	SIZE_T GetAllocatedSize() const;
+};
+
+enum class EBYGSearchSortKey : uint8
+{
+	None,
+	Ping,
+	Players,
+	ServerName,
+	// See FBYGSearchFilter::PingWeight and FillWeight
+	Score
+};
+
+struct BYGMULTIPLAYER_API FBYGSearchFilter
+{
+	bool bHideFull = false;
+	bool bHideEmpty = false;
+	// 0 for no limit
+	int32 MaxPing = 0;
+	// 0 for any build
+	int32 BuildUniqueId = 0;
+	// Empty for any map
+	FString MapName;
+	// Case-insensitive
+	FString ServerNameContains;
+	// Match ServerNameContains against the whole name, which can be done on hashes
+	bool bExactServerName = false;
+	// Hosts with a different build or content version, or a lobby or match map we don't have, see FBYGCompatibility.
+	// JoinSession refuses them anyway unless bRefuseIncompatibleSessions is off.
+	bool bHideIncompatible = false;
+	EBYGSearchSortKey SortKey = EBYGSearchSortKey::Ping;
+	bool bSortDescending = false;
+
+	// Lower scores sort first. Score = Ping * PingWeight - (players / max players) * FillWeight
+	float PingWeight = 1.0f;
+	float FillWeight = 100.0f;
+};
+
+// Structure-of-arrays copy of the numeric columns of a result set, one entry per row. Filtering and scoring run
+// straight down these arrays so they stay in cache and the compiler can vectorize them; rows are only touched for
+// the survivors of string filters and when drawing.
+struct BYGMULTIPLAYER_API FBYGSearchIndex
+{
+	TArray<int32> Ping;
+	TArray<int32> OpenSlots;
+	TArray<int32> MaxSlots;
+	TArray<int32> BuildId;
+	// Index into MapNames
+	TArray<int32> MapId;
+	// Case-insensitive hash of the server name
+	TArray<uint32> NameHash;
+	// 1 if EBYGCompatibility::Compatible
+	TArray<uint8> Compatible;
+	TArray<FString> MapNames;
+
+	void Build(const TArray<FBYGSearchResultRow>& Rows);
+	int32 Num() const { return Ping.Num(); }
+	int32 FindMapId(const FString& MapName) const;
+
+	// Writes 1 to OutMask for every row that passes the numeric part of Filter, 0 otherwise
+	void Filter(const FBYGSearchFilter& InFilter, TArray<uint8>& OutMask) const;
+	// Writes a sort key per row for Ping, Players and Score sorts, lowest first
+	void Score(const FBYGSearchFilter& InFilter, TArray<float>& OutKeys) const;
+
+	static uint32 HashServerName(const FString& ServerName);
+	SIZE_T GetAllocatedSize() const;
+};
+
+struct BYGMULTIPLAYER_API FBYGSearchSnapshot
+{
+	// Bumped every time the subsystem publishes a new snapshot
+	uint32 Version = 0;
+	EOnlineAsyncTaskState::Type State = EOnlineAsyncTaskState::NotStarted;
+	// One per search result, in the same order as SessionSearch->SearchResults
+	TArray<FBYGSearchResultRow> Rows;
+	FBYGSearchIndex Index;
+	// Indices into Rows that passed the filter, in display order
+	TArray<int32> VisibleRows;
+	// How long the last ApplyFilter took
+	double FilterSeconds = 0.0;
+
+	// Decodes every result, then filters and sorts. Only reads from Results, so it's safe to run on a worker
+	// as long as nothing modifies them in the meantime.
+	static TSharedRef<FBYGSearchSnapshot, ESPMode::ThreadSafe> Build(const TArray<FOnlineSessionSearchResult>& Results, EOnlineAsyncTaskState::Type State, const FBYGSearchFilter& Filter, const FBYGNetCoordinate& LocalCoordinate = FBYGNetCoordinate());
+	void ApplyFilter(const FBYGSearchFilter& Filter);
+	SIZE_T GetAllocatedSize() const;
+};
+
+typedef TSharedRef<const FBYGSearchSnapshot, ESPMode::ThreadSafe> FBYGSearchSnapshotRef;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnBYGSearchResultsReady, const FBYGSearchSnapshotRef& /*Snapshot*/);
@@ -0,0 +1,137 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Servers we've played on, and getting back onto them without a search.
+//
+// Every session we join is remembered with its session id and the address we connected to, and kept in a save game
+// so it survives restarts. Favorites are kept for good, the rest only until MaxRecentServers newer ones push them out.
+//
+// Rejoin() travels to the remembered address straight away. In parallel it looks the session up by id. If the host
+// is still there, we join its session alongside the connect without travelling again, so we end up in the session
+// like after any other join. If the host has moved, we switch to the session's new address and join it properly. If
+// the session is gone, a search is started in case the direct connect doesn't work out. Only if the connection fails
+// do we join whatever that search found under the same session id, or under the same server name at the same
+// address. Results that only share the name are left in the search results for the player to pick. A server that's
+// still where we left it therefore takes a single connect, rather than a search timeout followed by a join. Hosts
+// without a session id, e.g. found by LAN discovery, are only ever connected to directly.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/SaveGame.h"
+#include "Engine/EngineBaseTypes.h"
+#include "BYGSearchResults.h"
+#include "BYGServerHistory.generated.h"
+
+class UBYGMultiplayerSubsystem;
+class UNetDriver;
+
+USTRUCT()
+struct BYGMULTIPLAYER_API FBYGKnownServer
+{
+	GENERATED_BODY()
+
+	// Empty for hosts found without an online session, e.g. through LAN discovery
+	UPROPERTY()
+	FString SessionId;
+	// Without our join options, JoinDirect adds those
+	UPROPERTY()
+	FString ConnectInfo;
+	// Online subsystem we found it through, sessions can only be looked up by id on that one
+	UPROPERTY()
+	FName Subsystem;
+	UPROPERTY()
+	FString ServerName;
+	UPROPERTY()
+	FString MapName;
+	UPROPERTY()
+	FDateTime LastJoined;
+	UPROPERTY()
+	int32 NumJoins = 0;
+	UPROPERTY()
+	bool bFavorite = false;
+
+	// SessionId, or ConnectInfo for servers without one
+	const FString& GetKey() const { return SessionId.IsEmpty() ? ConnectInfo : SessionId; }
+};
+
+UCLASS()
+class BYGMULTIPLAYER_API UBYGServerHistorySave : public USaveGame
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	TArray<FBYGKnownServer> Servers;
+};
+
+class BYGMULTIPLAYER_API FBYGServerHistory
+{
+public:
+	void Init(UBYGMultiplayerSubsystem* InSubsystem);
+	void Deinit();
+
+	// Most recently joined first. Loaded from the save game on first use.
+	const TArray<FBYGKnownServer>& GetServers();
+	// By FBYGKnownServer::GetKey()
+	const FBYGKnownServer* Find(const FString& Key);
+	// Call when we start connecting. Only recorded once the host's map has loaded, so hosts that turn us away aren't.
+	// SessionId may be empty if the host has no online session.
+	void Remember(const FString& SessionId, const FString& ConnectInfo, FName SubsystemName, const FOnlineSessionSettings& Settings);
+	void SetFavorite(const FString& Key, bool bFavorite);
+	void Forget(const FString& Key);
+	// Empty if the session has no session info, e.g. one found by LAN discovery
+	static FString GetSessionId(const FOnlineSession& Session);
+
+	// See the top of this file. Returns false if we don't know the server.
+	bool Rejoin(const FString& Key);
+	bool IsRejoining() const { return bRejoining; }
+	void CancelRejoin();
+
+protected:
+	UBYGMultiplayerSubsystem* Subsystem = nullptr;
+	bool bLoaded = false;
+	TArray<FBYGKnownServer> Servers;
+	FBYGKnownServer* FindMutable(const FString& Key);
+	void Load();
+	void Save();
+	// Moves Server to the front as just joined, keeping whether it's a favorite
+	void Touch(FBYGKnownServer Server);
+	// Remembered but not connected yet
+	TOptional<FBYGKnownServer> PendingServer;
+
+	// Rejoin state. Serial tells stale lookups from the current one.
+	bool bRejoining = false;
+	bool bTravelling = false;
+	bool bLookingUp = false;
+	bool bSearching = false;
+	bool bSearchComplete = false;
+	// The direct connect got us onto the host's map
+	bool bConnected = false;
+	// Joined the looked up session alongside the direct connect
+	bool bJoinedSession = false;
+	uint32 RejoinSerial = 0;
+	FBYGKnownServer Target;
+	// The session as found by id, if the lookup found it
+	TOptional<FOnlineSessionSearchResult> FoundResult;
+	bool StartLookup();
+	void OnLookupComplete(bool bWasSuccessful, const FOnlineSessionSearchResult& Result);
+	void StartSearch();
+	void OnSearchResultsReady(const FBYGSearchSnapshotRef& Snapshot);
+	// Joins the best match in the search results. False if there isn't one.
+	bool JoinFromSearch();
+	void JoinFoundResult();
+	void OnTravelFailed();
+	void CancelTravel();
+	void FinishRejoin();
+
+	FDelegateHandle SearchResultsHandle;
+	FDelegateHandle PostLoadMapHandle;
+	FDelegateHandle TravelFailureHandle;
+	FDelegateHandle NetworkFailureHandle;
+	void OnPostLoadMap(UWorld* World);
+	void HandleTravelFailure(UWorld* World, ETravelFailure::Type FailureType, const FString& ErrorString);
+	void HandleNetworkFailure(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString);
+	// Whether a failure is about the connection we're making or on, rather than e.g. a beacon
+	bool IsOurConnection(UWorld* World, UNetDriver* NetDriver) const;
+	UWorld* GetWorld() const;
+};
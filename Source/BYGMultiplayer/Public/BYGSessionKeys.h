@@ -0,0 +1,113 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Typed session setting keys. Declare a key once with its value type, how it's advertised and what to return when
+// a session doesn't have it, then Set and Get it without picking FVariantData overloads by hand:
+//
+//   FString Name = BYGSessionKeys::ServerName.Get(SearchResult);
+//   BYGSessionKeys::ServerName.Set(Settings, TEXT("My Server"));
+//
+// Get never fails. A missing key, or one holding a different type, gives back the default.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineSessionSettings.h"
+#include "Templates/Identity.h"
+
+// Kept for code that still uses the raw name, prefer BYGSessionKeys::ServerName
+#define SETTING_SERVER_NAME FName(TEXT("SERVER_NAME"))
+
+// Maps a C++ type onto the FVariantData type it's stored as. Only the types FVariantData supports are specialized,
+// so declaring a key of any other type fails to compile.
+template<typename T> struct TBYGSessionKeyType;
+template<> struct TBYGSessionKeyType<int32> { static constexpr EOnlineKeyValuePairDataType::Type Value = EOnlineKeyValuePairDataType::Int32; };
+template<> struct TBYGSessionKeyType<uint32> { static constexpr EOnlineKeyValuePairDataType::Type Value = EOnlineKeyValuePairDataType::UInt32; };
+template<> struct TBYGSessionKeyType<int64> { static constexpr EOnlineKeyValuePairDataType::Type Value = EOnlineKeyValuePairDataType::Int64; };
+template<> struct TBYGSessionKeyType<uint64> { static constexpr EOnlineKeyValuePairDataType::Type Value = EOnlineKeyValuePairDataType::UInt64; };
+template<> struct TBYGSessionKeyType<float> { static constexpr EOnlineKeyValuePairDataType::Type Value = EOnlineKeyValuePairDataType::Float; };
+template<> struct TBYGSessionKeyType<double> { static constexpr EOnlineKeyValuePairDataType::Type Value = EOnlineKeyValuePairDataType::Double; };
+template<> struct TBYGSessionKeyType<bool> { static constexpr EOnlineKeyValuePairDataType::Type Value = EOnlineKeyValuePairDataType::Bool; };
+template<> struct TBYGSessionKeyType<FString> { static constexpr EOnlineKeyValuePairDataType::Type Value = EOnlineKeyValuePairDataType::String; };
+
+template<typename T>
+struct TBYGSessionKey
+{
+	static constexpr EOnlineKeyValuePairDataType::Type DataType = TBYGSessionKeyType<T>::Value;
+
+	TBYGSessionKey(const TCHAR* InName, EOnlineDataAdvertisementType::Type InAdvertisement, const T& InDefault)
+		: Name(InName)
+		, Advertisement(InAdvertisement)
+		, Default(InDefault)
+	{
+	}
+
+	// Built once, unlike constructing an FName from a string at every lookup
+	const FName Name;
+	const EOnlineDataAdvertisementType::Type Advertisement;
+	const T Default;
+
+	void Set(FOnlineSessionSettings& Settings, const T& Value) const
+	{
+		Settings.Set(Name, Value, Advertisement);
+	}
+
+	T Get(const FOnlineSessionSettings& Settings) const
+	{
+		return Get(Settings.Settings);
+	}
+
+	// Just the custom settings, e.g. from FBYGSessionSnapshot
+	T Get(const FSessionSettings& Settings) const
+	{
+		const FOnlineSessionSetting* Setting = Settings.Find(Name);
+		if (!Setting || Setting->Data.GetType() != DataType)
+		{
+			return Default;
+		}
+		T Value = Default;
+		Setting->Data.GetValue(Value);
+		return Value;
+	}
+
+	T Get(const FOnlineSessionSearchResult& Result) const
+	{
+		return Get(Result.Session.SessionSettings);
+	}
+
+	bool IsSet(const FOnlineSessionSettings& Settings) const
+	{
+		return IsSet(Settings.Settings);
+	}
+
+	bool IsSet(const FSessionSettings& Settings) const
+	{
+		const FOnlineSessionSetting* Setting = Settings.Find(Name);
+		return Setting && Setting->Data.GetType() == DataType;
+	}
+};
+
+namespace BYGSessionKeys
+{
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<FString> ServerName;
+	// Public facing map name, stored under the engine's SETTING_MAPNAME
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<FString> MapName;
+	// Name of the FBYGNetProfile the host picked
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<FString> NetProfile;
+	// Port of the host's reservation beacon, stored under the engine's SETTING_BEACONPORT. 0 if it has none.
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<int32> BeaconPort;
+	// Maps TravelToLobby() and TravelToMatch() go to, so clients know what to preload
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<FString> LobbyMap;
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<FString> MatchMap;
+	// Set locally on multi-search results, never advertised. See BYGMultiSearch.h.
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<FString> SearchSource;
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<FString> SearchSubsystem;
+	// Set locally on results found by LAN discovery, which have no session info to resolve an address from
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<FString> HostAddress;
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<int32> GamePort;
+	// What the host was built from, see BYGCompatibility.h. ContentVersion is missing if the host doesn't advertise one.
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<int32> BuildId;
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<FString> ContentVersion;
+	// Where the host is in latency space and how sure it is of that, see BYGNetCoordinate.h
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<int32> NetCoordinate;
+	extern BYGMULTIPLAYER_API const TBYGSessionKey<float> NetCoordinateError;
+}
@@ -0,0 +1,133 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Records the calls made into UBYGMultiplayerSubsystem and the online subsystem callbacks that come back out,
+// with timestamps and payloads, so a bad session can be replayed offline at recorded or accelerated speed.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineKeyValuePair.h"
+
+class FUniqueNetId;
+
+class FOnlineSessionSearchResult;
+
+enum class EBYGSessionEventType : uint8
+{
+	// Calls into the subsystem
+	HostGame,
+	CancelHosting,
+	FindSessions,
+	JoinSession,
+
+	// Callbacks from the online subsystem and engine
+	LoginComplete,
+	CreateSessionComplete,
+	StartSessionComplete,
+	FindSessionsComplete,
+	JoinSessionComplete,
+	EndSessionComplete,
+	NetworkFailure,
+	TravelFailure,
+
+	Num
+};
+
+struct BYGMULTIPLAYER_API FBYGRecordedSessionSetting
+{
+	FName Key;
+	// Saved with its type and raw value, so blobs and floats come back exactly
+	FVariantData Data;
+	uint8 AdvertisementType = 0;
+};
+
+// Just enough of an FOnlineSessionSearchResult to rebuild one for replay
+struct BYGMULTIPLAYER_API FBYGRecordedSearchResult
+{
+	FString SessionId;
+	FString OwningUserId;
+	FString OwningUserName;
+	int32 PingInMs = 0;
+	int32 NumOpenPublicConnections = 0;
+	int32 NumOpenPrivateConnections = 0;
+	int32 NumPublicConnections = 0;
+	int32 NumPrivateConnections = 0;
+	int32 BuildUniqueId = 0;
+	bool bIsLANMatch = false;
+	bool bIsDedicated = false;
+	bool bUsesPresence = false;
+	bool bAllowJoinInProgress = false;
+	TArray<FBYGRecordedSessionSetting> Settings;
+
+	static FBYGRecordedSearchResult FromSearchResult(const FOnlineSessionSearchResult& Result);
+	// Only the session ID of the session info is restored, there is no connect address so the result can't actually
+	// be joined
+	FOnlineSessionSearchResult ToSearchResult() const;
+};
+
+struct BYGMULTIPLAYER_API FBYGSessionEvent
+{
+	// Seconds since recording started
+	double Time = 0.0;
+	EBYGSessionEventType Type = EBYGSessionEventType::Num;
+	FName SessionName;
+	bool bWasSuccessful = false;
+	// Meaning depends on Type: join result, failure type or search result index
+	int32 Value = 0;
+	FString Message;
+	TArray<FBYGRecordedSearchResult> SearchResults;
+
+	static const TCHAR* GetTypeName(EBYGSessionEventType Type);
+};
+
+class BYGMULTIPLAYER_API FBYGSessionRecorder
+{
+public:
+	void Start();
+	void Stop();
+	bool IsRecording() const { return bIsRecording; }
+
+	// Does nothing when not recording
+	FBYGSessionEvent* Record(EBYGSessionEventType Type, FName SessionName = NAME_None, bool bWasSuccessful = true, int32 Value = 0, const FString& Message = FString());
+
+	const TArray<FBYGSessionEvent>& GetEvents() const { return Events; }
+	double GetDuration() const { return Events.Num() > 0 ? Events.Last().Time : 0.0; }
+
+	bool SaveToFile(const FString& Filename) const;
+	static bool LoadFromFile(const FString& Filename, TArray<FBYGSessionEvent>& OutEvents);
+	static FString GetDefaultFilename();
+
+protected:
+	TArray<FBYGSessionEvent> Events;
+	double StartTime = 0.0;
+	bool bIsRecording = false;
+};
+
+class BYGMULTIPLAYER_API FBYGSessionReplayer
+{
+public:
+	// Speed of 1 replays at the recorded timing, 0 or less dispatches everything as fast as possible
+	void Start(TArray<FBYGSessionEvent>&& InEvents, float InSpeed);
+	void Stop();
+	bool IsReplaying() const { return bIsReplaying; }
+
+	// Dispatches every event that is due. Returns true when the replay finished this tick.
+	bool Tick(float DeltaTime, TFunctionRef<void(const FBYGSessionEvent&)> Dispatch);
+
+	// Stands in for the IDs of the online subsystem that made the recording
+	static TSharedRef<const FUniqueNetId> MakeUniqueNetId(const FString& Id);
+
+	int32 GetNumEvents() const { return Events.Num(); }
+	int32 GetNextEventIndex() const { return NextEvent; }
+	// Wall-clock seconds from Start() until the last event was dispatched
+	double GetLastReplayDuration() const { return LastReplayDuration; }
+
+protected:
+	TArray<FBYGSessionEvent> Events;
+	int32 NextEvent = 0;
+	float Speed = 1.0f;
+	double ReplayTime = 0.0;
+	double StartWallTime = 0.0;
+	double LastReplayDuration = 0.0;
+	bool bIsReplaying = false;
+};
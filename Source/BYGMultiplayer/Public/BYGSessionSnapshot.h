@@ -0,0 +1,68 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Immutable copy of the current game session's state. The subsystem rebuilds it only when a session event fires,
+// so UI and gameplay code can read it every frame without going through the online subsystem.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineSessionSettings.h"
+
+// FString plus a null-terminated ANSI copy, converted once so ImGui can draw it every frame for free
+struct BYGMULTIPLAYER_API FBYGDisplayString
+{
+	FBYGDisplayString() = default;
+	explicit FBYGDisplayString(const FString& InText) { Set(InText); }
+
+	void Set(const FString& InText)
+	{
+		Text = InText;
+		Ansi.SetNumUninitialized(Text.Len() + 1);
+		FCStringAnsi::Strncpy(Ansi.GetData(), TCHAR_TO_ANSI(*Text), Ansi.Num());
+	}
+
+	const FString& ToString() const { return Text; }
+	const ANSICHAR* GetAnsi() const { return Ansi.Num() > 0 ? Ansi.GetData() : ""; }
+	bool IsEmpty() const { return Text.IsEmpty(); }
+	SIZE_T GetAllocatedSize() const { return Text.GetAllocatedSize() + Ansi.GetAllocatedSize(); }
+
+private:
+	FString Text;
+	TArray<ANSICHAR> Ansi;
+};
+
+struct BYGMULTIPLAYER_API FBYGSessionSnapshot
+{
+	// Bumped every time the subsystem publishes a new snapshot
+	uint32 Version = 0;
+
+	int32 NumSessions = 0;
+	// False if there is no session called SessionName, in which case everything below is defaulted
+	bool bHasSession = false;
+	FName SessionName;
+	FBYGDisplayString SessionId;
+	bool bHosting = false;
+	EOnlineSessionState::Type State = EOnlineSessionState::NoSession;
+	FBYGDisplayString StateName;
+	int32 NumOpenPublicConnections = 0;
+	int32 NumOpenPrivateConnections = 0;
+	int32 HostingPlayerNum = 0;
+	FBYGDisplayString LocalOwnerId;
+	TArray<FBYGDisplayString> RegisteredPlayers;
+	bool bLocalPlayerRegistered = false;
+	// From the session's FOnlineSessionSettings. Not the whole thing, its MemberSettings are keyed by net ids, whose
+	// reference counts aren't thread-safe.
+	int32 NumPublicConnections = 0;
+	int32 NumPrivateConnections = 0;
+	bool bIsLANMatch = false;
+	bool bIsDedicated = false;
+	// Custom settings, read them with BYGSessionKeys
+	FSessionSettings Settings;
+
+	static const TCHAR* GetStateName(EOnlineSessionState::Type State);
+};
+
+// Thread-safe so snapshots can be handed to worker threads, see UBYGMultiplayerSubsystem::GetSessionSnapshot_AnyThread
+typedef TSharedRef<const FBYGSessionSnapshot, ESPMode::ThreadSafe> FBYGSessionSnapshotRef;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnBYGSessionSnapshotChanged, const FBYGSessionSnapshotRef& /*Snapshot*/);
@@ -0,0 +1,94 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Optional lobby that lives in the same persistent world as the match.
+//
+// The lobby and match content are streaming sublevels of one persistent map, which is what the session hosts on.
+// Moving between them streams one in and the other out on the server and every client, so nobody tears down their
+// world or reconnects. The server waits until every client has made the incoming level visible (or the timeout hits)
+// before streaming the outgoing one out, and replicates the stage and how many clients are ready through an
+// ABYGStreamingLobbyState. Players joining mid-way get the current streaming state from the engine on login.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "BYGStreamingLobby.generated.h"
+
+class UBYGMultiplayerSubsystem;
+class ULevelStreaming;
+
+UENUM()
+enum class EBYGLobbyStage : uint8
+{
+	Lobby,
+	LoadingMatch,
+	Match,
+	LoadingLobby
+};
+
+UCLASS(NotPlaceable, NotBlueprintable)
+class BYGMULTIPLAYER_API ABYGStreamingLobbyState : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ABYGStreamingLobbyState();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	UPROPERTY(Replicated)
+	EBYGLobbyStage Stage = EBYGLobbyStage::Lobby;
+	// Clients that have the incoming level visible, while loading
+	UPROPERTY(Replicated)
+	int32 NumReady = 0;
+	UPROPERTY(Replicated)
+	int32 NumClients = 0;
+};
+
+// bToMatch, and how long the server took from starting the transition until every client was ready
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnBYGStreamingTransitionComplete, bool /*bToMatch*/, double /*Seconds*/);
+
+class BYGMULTIPLAYER_API FBYGStreamingLobby
+{
+public:
+	void Init(UBYGMultiplayerSubsystem* InSubsystem);
+	bool IsEnabled() const;
+
+	// Server only
+	bool StreamTo(bool bToMatch);
+	bool IsTransitioning() const { return bTransitioning; }
+	double GetLastTransitionSeconds() const { return LastTransitionSeconds; }
+
+	// Replicated, so these work on clients too. Lobby if there's no state yet.
+	EBYGLobbyStage GetStage() const;
+	int32 GetNumReady() const;
+	int32 GetNumClients() const;
+	static const TCHAR* GetStageName(EBYGLobbyStage Stage);
+
+	void Tick();
+	FOnBYGStreamingTransitionComplete OnTransitionComplete;
+
+	// Stream the outgoing level out anyway once clients have had this long
+	float ReadyTimeout = 30.0f;
+
+protected:
+	UBYGMultiplayerSubsystem* Subsystem = nullptr;
+	// Found lazily on clients
+	mutable TWeakObjectPtr<ABYGStreamingLobbyState> State;
+	// The world we set up the state and initial streaming for
+	TWeakObjectPtr<UWorld> HostWorld;
+
+	bool bTransitioning = false;
+	bool bTransitionToMatch = false;
+	double TransitionStartTime = 0.0;
+	double LastTransitionSeconds = 0.0;
+
+	void StartHosting(UWorld* World);
+	void TickTransition(UWorld* World);
+	ULevelStreaming* FindLevel(UWorld* World, bool bMatch) const;
+	// Applies to the server and tells every client to do the same
+	void SetLevelStreaming(UWorld* World, ULevelStreaming* Level, bool bShouldBeLoaded, bool bShouldBeVisible) const;
+	int32 CountReadyClients(UWorld* World, ULevelStreaming* Level, int32& OutNumClients) const;
+	ABYGStreamingLobbyState* FindState() const;
+	UWorld* GetWorld() const;
+};
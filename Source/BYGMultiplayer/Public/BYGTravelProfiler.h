@@ -0,0 +1,111 @@
+// Copyright Brace Yourself Games. All Rights Reserved.
+
+// Where the time goes between starting a travel and actually being in the new world.
+//
+// A travel is followed from the OpenLevel or ClientTravel that started it, or from the engine's own map load or
+// seamless travel notifications if we didn't start it, until the first frame in the new world. Its time is split by
+// phase, and the longest game-thread stall in each phase is kept, so a slow join can be pinned on e.g. a hitch in
+// world init rather than just "loading took 9 seconds".
+//
+// Each finished travel is broadcast, kept in memory, and appended to Saved/BYGMultiplayer/TravelHistory.csv along
+// with the build it was made on, so travel times can be compared across builds.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/World.h"
+
+class UBYGMultiplayerSubsystem;
+
+enum class EBYGTravelPhase : uint8
+{
+	// Leaving the old world, from the travel starting to the old world being cleaned up and collected
+	Teardown,
+	// Loading the new map's package
+	Load,
+	// Initializing the new world and its actors, until the map has loaded
+	WorldInit,
+	// Clients only. Connecting to the host before the load, and being handed a player controller and player
+	// state after it.
+	Handshake,
+	// The first frame in the new world
+	FirstFrame,
+	Num
+};
+
+struct BYGMULTIPLAYER_API FBYGTravelProfile
+{
+	FDateTime Timestamp;
+	FString BuildVersion;
+	int32 BuildId = 0;
+	FString MapName;
+	// Host, Join, Seamless or Travel for ones we didn't start
+	FString Reason;
+	// False if it failed or timed out
+	bool bCompleted = false;
+	double TotalSeconds = 0.0;
+	double PhaseSeconds[(int32)EBYGTravelPhase::Num] = {};
+	// Longest gap between two game thread ticks, or engine notifications, during the phase
+	double PhaseHitchSeconds[(int32)EBYGTravelPhase::Num] = {};
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnBYGTravelProfiled, const FBYGTravelProfile& /*Profile*/);
+
+class BYGMULTIPLAYER_API FBYGTravelProfiler
+{
+public:
+	void Init(UBYGMultiplayerSubsystem* InSubsystem);
+	void Deinit();
+
+	// Call just before starting a travel. MapName may be empty if we don't know it yet, e.g. joining a host.
+	void Begin(const FString& Reason, const FString& MapName);
+	// The travel failed, reports what we have so far
+	void Abort();
+	bool IsProfiling() const { return bIsProfiling; }
+	EBYGTravelPhase GetPhase() const { return Phase; }
+
+	void Tick();
+
+	// Oldest first
+	const TArray<FBYGTravelProfile>& GetHistory() const { return History; }
+	FOnBYGTravelProfiled OnTravelProfiled;
+
+	static const TCHAR* GetPhaseName(EBYGTravelPhase InPhase);
+	static FString GetHistoryFilename();
+
+protected:
+	UBYGMultiplayerSubsystem* Subsystem = nullptr;
+	FDelegateHandle PreLoadMapHandle;
+	FDelegateHandle PostLoadMapHandle;
+	FDelegateHandle PreWorldInitHandle;
+	FDelegateHandle PostGarbageCollectHandle;
+	FDelegateHandle SeamlessTravelStartHandle;
+	void OnPreLoadMap(const FString& MapName);
+	void OnPostGarbageCollect();
+	void OnPreWorldInit(UWorld* World, const UWorld::InitializationValues IVS);
+	void OnPostLoadMap(UWorld* World);
+	void OnSeamlessTravelStart(UWorld* World, const FString& MapName);
+
+	bool bIsProfiling = false;
+	// The old world is on its way out, before this we may still be connecting to the host
+	bool bLoadStarted = false;
+	EBYGTravelPhase Phase = EBYGTravelPhase::Teardown;
+	// GFrameCounter when we entered the current phase
+	uint64 PhaseStartFrame = 0;
+	double StartTime = 0.0;
+	double LastHeartbeat = 0.0;
+	// Empty if we don't know yet
+	FString DestinationShortName;
+	FBYGTravelProfile Pending;
+	TArray<FBYGTravelProfile> History;
+
+	// Charges the time since the last heartbeat to the current phase
+	void Heartbeat();
+	void Enter(EBYGTravelPhase NewPhase);
+	void Finish(bool bCompleted);
+	bool IsDestination(const UWorld* World) const;
+	bool HasPendingNetGame() const;
+	bool HasReplicatedPlayer() const;
+	void AppendToHistoryFile(const FBYGTravelProfile& Profile) const;
+	UWorld* GetWorld() const;
+};